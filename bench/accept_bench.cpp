@@ -0,0 +1,114 @@
+#include <wasl/Acceptor.h>
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bench_helpers.h"
+
+using namespace wasl::ip;
+
+namespace {
+
+using mux_type = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+using acceptor_type = acceptor<socket_stream_tcp, mux_type>;
+
+constexpr std::size_t connections = 20000;
+constexpr std::size_t client_threads = 4;
+
+/// A reactor thread accepting on one listener and closing every connection
+/// right away.
+struct shard {
+  shard(SOCKET listener, std::size_t batch, std::atomic<std::size_t> &total)
+      : acc{mux, listener, SOCK_NONBLOCK | SOCK_CLOEXEC, batch} {
+    acc.start([this, &total](socket_stream_tcp &conn) {
+      acc.close(sockno(conn));
+      ++total;
+    });
+    thread = std::thread([this] {
+      while (running)
+        mux.listen();
+    });
+  }
+
+  ~shard() {
+    mux.post([this] { running = false; });
+    thread.join();
+  }
+
+  mux_type mux;
+  acceptor_type acc;
+  bool running{true}; // of the reactor thread only
+  std::thread thread;
+};
+
+/// Connect and reset connections to path, from client_threads threads.
+void storm(const std::string &path) {
+  std::vector<std::thread> clients;
+  for (std::size_t t = 0; t < client_threads; ++t)
+    clients.emplace_back([&path] {
+      struct linger reset {1, 0}; // no TIME_WAIT to run out of ports
+      for (std::size_t i = 0; i < connections / client_threads; ++i) {
+        auto conn{make_connection<sockaddr_in, SOCK_STREAM>(path.c_str())};
+        if (!conn) {
+          perror("connect");
+          return;
+        }
+        setsockopt(sockno(*conn), SOL_SOCKET, SO_LINGER, &reset,
+                   sizeof(reset));
+      }
+    });
+  for (auto &c : clients)
+    c.join();
+}
+
+/// Connections per second accepted by shards reactors, each on its own
+/// SO_REUSEPORT listener, accepting up to batch per wakeup.
+void bench_storm(const char *name, std::size_t shards, std::size_t batch) {
+  auto listeners{make_reuseport_listeners<sockaddr_in>("127.0.0.1:0", shards)};
+  if (listeners.empty()) {
+    perror("listen");
+    return;
+  }
+  auto path = address_path(get_address<sockaddr_in>(sockno(*listeners[0])));
+
+  std::atomic<std::size_t> total{0};
+  std::vector<std::unique_ptr<shard>> reactors;
+  for (auto &l : listeners)
+    reactors.emplace_back(new shard{sockno(*l), batch, total});
+
+  auto start = std::chrono::steady_clock::now();
+  storm(path);
+  while (total < connections)
+    std::this_thread::yield();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  uint64_t wakeups = 0;
+  for (auto &r : reactors)
+    wakeups += r->acc.wakeups();
+  reactors.clear();
+
+  report(name,
+         std::chrono::duration<double, std::nano>(elapsed).count() / connections);
+  std::printf("  %.1f connections per wakeup\n",
+              static_cast<double>(connections) / wakeups);
+}
+
+} // namespace
+
+int main() {
+  std::printf("%zu TCP connections over loopback, %zu client threads\n",
+              connections, client_threads);
+  bench_storm("accept: 1 listener, 1 per wakeup", 1, 1);
+  bench_storm("accept: 1 listener, batch 64", 1, 64);
+  bench_storm("accept: 2 reuseport shards, batch 64", 2, 64);
+  bench_storm("accept: 4 reuseport shards, batch 64", 4, 64);
+}
@@ -0,0 +1,33 @@
+#ifndef WASL_BENCH_BENCH_HELPERS_H
+#define WASL_BENCH_BENCH_HELPERS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+
+/// Keep the compiler from optimizing value (and its computation) away.
+template <typename T> inline void do_not_optimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// Average wall time of one call to f over iterations calls, after a short
+/// warm-up.
+template <typename F> double ns_per_op(std::size_t iterations, F &&f) {
+  for (std::size_t i = 0; i < iterations / 10; ++i)
+    f();
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < iterations; ++i)
+    f();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  return std::chrono::duration<double, std::nano>(elapsed).count() /
+         iterations;
+}
+
+inline void report(const char *name, double ns_op) {
+  std::printf("%-44s %12.1f ns/op %14.0f ops/s\n", name, ns_op,
+              ns_op > 0 ? 1e9 / ns_op : 0.0);
+}
+
+#endif /* WASL_BENCH_BENCH_HELPERS_H */
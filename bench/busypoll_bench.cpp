@@ -0,0 +1,84 @@
+#include <wasl/IOMultiplexer.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "bench_helpers.h"
+
+using namespace std::string_literals;
+using namespace wasl::ip;
+
+namespace {
+
+constexpr std::size_t round_trips = 50000;
+
+template <typename Mux> void report_spin(const Mux &) {}
+
+void report_spin(const io_mux_base<SOCKET, busy_poll_muxer<SOCKET>> &m) {
+  const auto &s = m.muxer().stats();
+  std::printf("  spin %.1f ms, useful %.1f ms, %llu spin hits, %llu blocks\n",
+              s.spin_ns.get() / 1e6, s.useful_ns.get() / 1e6,
+              static_cast<unsigned long long>(s.spin_hits.get()),
+              static_cast<unsigned long long>(s.blocks.get()));
+}
+
+/// Round trip through a reactor thread: the main thread writes a byte, the
+/// reactor echoes it back, the main thread blocks in read() for the echo.
+template <typename Mux, typename Configure>
+void bench_round_trip(const char *name, Configure configure) {
+  int fds[2];
+  if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) == -1) {
+    perror("socketpair");
+    return;
+  }
+
+  Mux muxer;
+  configure(muxer);
+  muxer.add(fds[0]);
+  muxer.bind_event(fds[0], labeled_handler<std::string>{
+                               "echo"s, [](SOCKET fd, std::string) {
+                                 char c;
+                                 if (read(fd, &c, 1) == 1)
+                                   do_not_optimize(write(fd, &c, 1));
+                               }});
+
+  std::atomic<bool> done{false};
+  std::thread reactor([&] {
+    while (!done.load(std::memory_order_relaxed))
+      muxer.listen();
+  });
+
+  report(name, ns_per_op(round_trips, [&] {
+           char c = 'x';
+           do_not_optimize(write(fds[1], &c, 1));
+           do_not_optimize(read(fds[1], &c, 1));
+         }));
+
+  done = true;
+  muxer.post([] {}); // wake a blocked listen()
+  reactor.join();
+  report_spin(muxer);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+} // namespace
+
+int main() {
+  using epoll_mux = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+  using spin_mux = io_mux_base<SOCKET, busy_poll_muxer<SOCKET>>;
+
+  bench_round_trip<epoll_mux>("round trip: epoll_muxer", [](epoll_mux &) {});
+  bench_round_trip<spin_mux>("round trip: busy_poll_muxer 50us",
+                             [](spin_mux &m) {
+                               m.muxer().configure(busy_poll_config{});
+                             });
+  bench_round_trip<spin_mux>("round trip: busy_poll_muxer 1ms",
+                             [](spin_mux &m) {
+                               busy_poll_config config;
+                               config.max_spin = std::chrono::milliseconds{1};
+                               m.muxer().configure(config);
+                             });
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <wasl/Handlers.h>
+#include <wasl/IOMultiplexer.h>
+
+#include <string>
+
+#include "bench_helpers.h"
+
+using namespace std::string_literals;
+using namespace wasl::ip;
+using wasl::inplace_function;
+using wasl::make_handler_set;
+
+namespace {
+
+constexpr std::size_t calls = 20000000;
+constexpr std::size_t listens = 200000;
+
+using sbo_handler = inplace_function<void(SOCKET, std::string)>;
+
+long sink = 0;
+
+/// Handler call cost alone: four handlers selected round-robin by index.
+void bench_call_overhead() {
+  const std::string msg = "iomux event triggered: bench";
+  std::size_t i = 0;
+
+  socket_handler_fun funs[4] = {[](SOCKET fd, std::string) { sink += fd; },
+                                [](SOCKET fd, std::string) { sink -= fd; },
+                                [](SOCKET fd, std::string) { sink ^= fd; },
+                                [](SOCKET fd, std::string) { sink |= fd; }};
+  report("call: socket_handler_fun",
+         ns_per_op(calls, [&] { funs[i++ & 3](3, msg); }));
+
+  sbo_handler sbos[4] = {[](SOCKET fd, std::string) { sink += fd; },
+                         [](SOCKET fd, std::string) { sink -= fd; },
+                         [](SOCKET fd, std::string) { sink ^= fd; },
+                         [](SOCKET fd, std::string) { sink |= fd; }};
+  report("call: inplace_function",
+         ns_per_op(calls, [&] { sbos[i++ & 3](3, msg); }));
+
+  auto set = make_handler_set(
+      [](SOCKET fd, const std::string &) { sink += fd; },
+      [](SOCKET fd, const std::string &) { sink -= fd; },
+      [](SOCKET fd, const std::string &) { sink ^= fd; },
+      [](SOCKET fd, const std::string &) { sink |= fd; });
+  SOCKET fd = 3;
+  report("call: handler_set",
+         ns_per_op(calls, [&] { set.dispatch(i++ & 3, fd, msg); }));
+}
+
+/// One ready byte per listen() on a socketpair, read by the handler.
+template <typename Mux, typename Bind>
+void bench_listen(const char *name, Mux &muxer, Bind bind) {
+  int fds[2];
+  if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) == -1) {
+    perror("socketpair");
+    return;
+  }
+
+  muxer.add(fds[0]);
+  bind(fds[0]);
+
+  report(name, ns_per_op(listens, [&] {
+           ssize_t rc = write(fds[1], "x", 1);
+           do_not_optimize(rc);
+           muxer.listen();
+         }));
+
+  muxer.remove(fds[0]);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+void read_byte(SOCKET fd) {
+  char c;
+  sink += read(fd, &c, 1);
+}
+
+void bench_dispatch_path() {
+  io_mux_base<SOCKET, epoll_muxer<SOCKET>> fun_mux;
+  bench_listen("listen: socket_handler_fun", fun_mux, [&](SOCKET fd) {
+    fun_mux.bind_event(fd, labeled_handler<std::string>{
+                               "bench"s, [](SOCKET fd, std::string) {
+                                 read_byte(fd);
+                               }});
+  });
+
+  io_mux_base<SOCKET, epoll_muxer<SOCKET>, null_trace, sbo_handler> sbo_mux;
+  bench_listen("listen: inplace_function", sbo_mux, [&](SOCKET fd) {
+    sbo_mux.bind_event(fd, labeled_handler<std::string, sbo_handler>{
+                               "bench"s, [](SOCKET fd, std::string) {
+                                 read_byte(fd);
+                               }});
+  });
+
+  auto static_mux{make_static_muxer<SOCKET>(
+      [](SOCKET fd, const std::string &) { read_byte(fd); },
+      [](SOCKET fd, const std::string &) { sink -= fd; })};
+  bench_listen("listen: static_io_mux", *static_mux,
+               [&](SOCKET fd) { static_mux->bind_handler<0>(fd, "bench"); });
+}
+
+} // namespace
+
+int main() {
+  bench_call_overhead();
+  bench_dispatch_path();
+  do_not_optimize(sink);
+  return 0;
+}
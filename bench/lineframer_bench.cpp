@@ -0,0 +1,107 @@
+#include <wasl/LineFramer.h>
+
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "bench_helpers.h"
+
+using namespace wasl::ip;
+
+namespace {
+
+constexpr std::size_t lines = 500000;
+constexpr std::size_t scans = 200000;
+
+/// lines newline-terminated records of about 60 bytes.
+std::string make_stream() {
+  std::string s;
+  for (std::size_t i = 0; i < lines; ++i)
+    s += "tick " + std::to_string(i) + " bid 101.25 ask 101.27 size 500\n";
+  return s;
+}
+
+/// Scanning a 4 KiB buffer with its one delimiter at the end.
+void bench_scan() {
+  std::string buf(4096, 'x');
+  buf.back() = '\n';
+  auto *first = buf.data();
+  auto *last = first + buf.size();
+
+  report("scan 4K: find_delimiter_portable", ns_per_op(scans, [&] {
+           do_not_optimize(find_delimiter_portable(first, last, '\n'));
+         }));
+  report("scan 4K: memchr", ns_per_op(scans, [&] {
+           do_not_optimize(memchr(first, '\n', buf.size()));
+         }));
+  char name[64];
+  snprintf(name, sizeof(name), "scan 4K: find_delimiter (%s)",
+           find_delimiter_isa());
+  report(name, ns_per_op(scans, [&] {
+           do_not_optimize(find_delimiter(first, last, '\n'));
+         }));
+}
+
+/// Per-line cost of reading the whole stream from a writer thread.
+template <typename Read> void bench_read(const char *name, Read read_all) {
+  int fds[2];
+  if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) == -1) {
+    perror("socketpair");
+    return;
+  }
+
+  static const std::string stream = make_stream();
+  std::thread writer([&] {
+    std::size_t sent = 0;
+    while (sent < stream.size()) {
+      auto n = write(fds[0], stream.data() + sent, stream.size() - sent);
+      if (n <= 0)
+        break;
+      sent += n;
+    }
+    shutdown(fds[0], SHUT_WR);
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  auto count = read_all(fds[1]);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  writer.join();
+
+  if (count != lines)
+    std::printf("  read %zu of %zu lines\n", count, lines);
+  report(name,
+         std::chrono::duration<double, std::nano>(elapsed).count() / lines);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+} // namespace
+
+int main() {
+  bench_scan();
+
+  bench_read("read line: std::getline on sockstream", [](SOCKET sd) {
+    sockstream in(sd);
+    std::string line;
+    std::size_t count = 0;
+    while (std::getline(in, line)) {
+      do_not_optimize(line.size());
+      ++count;
+    }
+    return count;
+  });
+
+  bench_read("read line: line_framer", [](SOCKET sd) {
+    line_framer<> in(sd);
+    gsl::cstring_span<> line;
+    std::size_t count = 0;
+    while (in.read(line)) {
+      do_not_optimize(line.size());
+      ++count;
+    }
+    return count;
+  });
+}
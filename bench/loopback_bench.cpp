@@ -0,0 +1,146 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Loopback.h>
+#include <wasl/Rpc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "bench_helpers.h"
+
+using namespace wasl::ip;
+
+namespace {
+
+constexpr std::size_t requests = 200000;
+constexpr std::size_t messages = 1000000;
+constexpr std::size_t message_size = 64;
+constexpr uint16_t echo_method = 1;
+
+/// The kernel's socketpair() and epoll.
+struct kernel_transport {
+  using mux_type = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+  using sockio = basic_sockio<wasl::platform_type>;
+
+  static int make_pair(int type, SOCKET sv[2]) {
+    return socketpair(AF_LOCAL, type, 0, sv);
+  }
+  static void close_sd(SOCKET sd) { close(sd); }
+};
+
+/// loopback_pair() and loopback_muxer.
+struct loopback_transport {
+  using mux_type = io_mux_base<SOCKET, loopback_muxer<SOCKET>>;
+  using sockio = loopback_sockio;
+
+  static int make_pair(int type, SOCKET sv[2]) {
+    return loopback_pair(type, sv);
+  }
+  static void close_sd(SOCKET sd) { loopback_close(sd); }
+};
+
+/// Per-request cost of echo calls with depth calls outstanding, client and
+/// server on one reactor, as in rpc_bench.
+template <typename Transport>
+void bench_rpc(const char *transport, std::size_t depth) {
+  using mux_type = typename Transport::mux_type;
+  using server_type = rpc_server<mux_type, typename Transport::sockio>;
+  using client_type = rpc_client<mux_type, typename Transport::sockio>;
+
+  SOCKET sv[2];
+  if (Transport::make_pair(SOCK_STREAM, sv) == -1) {
+    perror("pair");
+    return;
+  }
+
+  {
+    mux_type mux;
+    server_type server{mux};
+    server.handle(echo_method, [](const message_view &req,
+                                  typename server_type::responder r) {
+      r.reply({req.payload(), req.payload() + req.payload_size()});
+    });
+    server.serve(sv[1]);
+    client_type client{mux, sv[0]};
+
+    const std::string payload(32, 'p');
+    std::size_t issued = 0, completed = 0;
+    std::function<void()> issue = [&] {
+      ++issued;
+      client.call(echo_method,
+                  {payload.data(), payload.data() + payload.size()},
+                  std::chrono::seconds(10),
+                  [&](rpc_status status, const message_view &) {
+                    do_not_optimize(status);
+                    ++completed;
+                    if (issued < requests)
+                      issue();
+                  });
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < depth && issued < requests; ++i)
+      issue();
+    while (completed < requests && client)
+      mux.listen();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    char name[64];
+    std::snprintf(name, sizeof(name), "rpc echo, %s, depth %zu", transport,
+                  depth);
+    report(name, std::chrono::duration<double, std::nano>(elapsed).count() /
+                     requests);
+  }
+
+  Transport::close_sd(sv[0]);
+  Transport::close_sd(sv[1]);
+}
+
+/// Per-message cost of blocking sends of one thread to another.
+template <typename Transport> void bench_one_way(const char *name) {
+  using sockio = typename Transport::sockio;
+
+  SOCKET sv[2];
+  if (Transport::make_pair(SOCK_SEQPACKET, sv) == -1) {
+    perror("pair");
+    return;
+  }
+
+  std::thread writer([&] {
+    char msg[message_size] = {};
+    for (std::size_t i = 0; i < messages; ++i)
+      if (sockio::rv_send(sv[0], msg, sizeof(msg)) != sizeof(msg))
+        break;
+  });
+
+  char buf[message_size];
+  std::size_t count = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (count < messages && sockio::rv_recv_msg(sv[1], buf, sizeof(buf)) > 0)
+    ++count;
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  writer.join();
+
+  if (count != messages)
+    std::printf("  received %zu of %zu messages\n", count, messages);
+  report(name,
+         std::chrono::duration<double, std::nano>(elapsed).count() / messages);
+
+  Transport::close_sd(sv[0]);
+  Transport::close_sd(sv[1]);
+}
+
+} // namespace
+
+int main() {
+  for (std::size_t depth : {1, 16, 256}) {
+    bench_rpc<kernel_transport>("kernel", depth);
+    bench_rpc<loopback_transport>("loopback", depth);
+  }
+  bench_one_way<kernel_transport>("one way: unix seqpacket, threads");
+  bench_one_way<loopback_transport>("one way: loopback seqpacket, threads");
+}
@@ -0,0 +1,83 @@
+#include <wasl/Message.h>
+
+#include <sstream>
+#include <string>
+
+#include "bench_helpers.h"
+
+using namespace wasl::ip;
+
+struct quote {
+  uint64_t id;
+  double bid;
+  double ask;
+  uint32_t qty;
+  uint32_t venue;
+};
+
+WASL_MESSAGE_SCHEMA(quote, 1, 1)
+
+namespace {
+
+constexpr std::size_t iterations = 2000000;
+
+const quote sample{123456789, 101.25, 101.5, 300, 7};
+
+void bench_text() {
+  std::ostringstream os;
+  report("encode: iostream text", ns_per_op(iterations, [&] {
+           os.str(std::string());
+           os << sample.id << ' ' << sample.bid << ' ' << sample.ask << ' '
+              << sample.qty << ' ' << sample.venue << '\n';
+           do_not_optimize(os);
+         }));
+
+  std::istringstream is;
+  const auto text = os.str();
+  quote q;
+  report("decode: iostream text", ns_per_op(iterations, [&] {
+           is.clear();
+           is.str(text);
+           is >> q.id >> q.bid >> q.ask >> q.qty >> q.venue;
+           do_not_optimize(q);
+         }));
+}
+
+void bench_binary() {
+  alignas(8) char buf[encoded_size<quote>()];
+  report("encode: binary encode()", ns_per_op(iterations, [&] {
+           encode(sample, buf);
+           do_not_optimize(buf);
+         }));
+
+  report("decode: binary message_view::get() in place",
+         ns_per_op(iterations, [&] {
+           message_view view(buf, sizeof(buf));
+           const auto *q = view.get<quote>();
+           do_not_optimize(q->ask);
+         }));
+
+  quote q;
+  report("decode: binary message_view::read() copy",
+         ns_per_op(iterations, [&] {
+           message_view(buf, sizeof(buf)).read(q);
+           do_not_optimize(q);
+         }));
+
+  std::stringstream ss;
+  quote copy = sample;
+  report("encode+decode: binary wire() on iostream",
+         ns_per_op(iterations, [&] {
+           ss << wire(copy);
+           ss >> wire(q);
+           do_not_optimize(q);
+         }));
+}
+
+} // namespace
+
+int main() {
+  bench_text();
+  bench_binary();
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Rpc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+
+#include "bench_helpers.h"
+
+using namespace wasl::ip;
+
+namespace {
+
+constexpr std::size_t requests = 200000;
+constexpr uint16_t echo_method = 1;
+
+using mux_type = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+
+/// Requests/s of echo calls with depth calls kept outstanding: every reply
+/// issues the next call. Client and server share one reactor over a
+/// socketpair.
+void bench_depth(std::size_t depth) {
+  int fds[2];
+  if (socketpair(AF_LOCAL, SOCK_STREAM, 0, fds) == -1) {
+    perror("socketpair");
+    return;
+  }
+
+  mux_type mux;
+  rpc_server<mux_type> server{mux};
+  server.handle(echo_method, [](const message_view &req,
+                                rpc_server<mux_type>::responder r) {
+    r.reply({req.payload(), req.payload() + req.payload_size()});
+  });
+  server.serve(fds[1]);
+  rpc_client<mux_type> client{mux, fds[0]};
+
+  const std::string payload(32, 'p');
+  std::size_t issued = 0, completed = 0;
+  std::function<void()> issue = [&] {
+    ++issued;
+    client.call(echo_method, {payload.data(), payload.data() + payload.size()},
+                std::chrono::seconds(10),
+                [&](rpc_status status, const message_view &) {
+                  do_not_optimize(status);
+                  ++completed;
+                  if (issued < requests)
+                    issue();
+                });
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < depth && issued < requests; ++i)
+    issue();
+  while (completed < requests && client)
+    mux.listen();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  char name[64];
+  std::snprintf(name, sizeof(name), "rpc echo, depth %zu", depth);
+  report(name, std::chrono::duration<double, std::nano>(elapsed).count() /
+                   requests);
+  std::printf("  %llu client writes, %.1f requests per write\n",
+              static_cast<unsigned long long>(client.stats().writes),
+              static_cast<double>(requests) / client.stats().writes);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+} // namespace
+
+int main() {
+  for (std::size_t depth : {1, 4, 16, 64, 256})
+    bench_depth(depth);
+}
@@ -0,0 +1,102 @@
+#include <wasl/LineFramer.h>
+#include <wasl/Socket.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "bench_helpers.h"
+
+using namespace wasl::ip;
+
+namespace {
+
+constexpr std::size_t messages = 500000;
+constexpr std::size_t message_size = 64;
+constexpr gsl::czstring<> srv_path{"/tmp/wasl-seqpacket-bench"};
+
+/// Per-message cost of sending messages from a writer thread through tx
+/// and receiving them through rx with receive_all.
+template <typename ReceiveAll>
+void bench_one_way(const char *name, SOCKET tx, SOCKET rx,
+                   ReceiveAll receive_all) {
+  std::string msg(message_size - 1, 'm');
+  msg += '\n'; // the stream path frames on it
+
+  std::thread writer([&] {
+    for (std::size_t i = 0; i < messages; ++i)
+      if (send(tx, msg.data(), msg.size(), 0) != static_cast<ssize_t>(msg.size()))
+        break;
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  auto count = receive_all(rx);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  writer.join();
+
+  if (count != messages)
+    std::printf("  received %zu of %zu messages\n", count, messages);
+  report(name,
+         std::chrono::duration<double, std::nano>(elapsed).count() / messages);
+}
+
+/// One recv() per message, as boundaries are kept.
+std::size_t receive_messages(SOCKET sd) {
+  char buf[message_size];
+  std::size_t count = 0;
+  while (count < messages && recv(sd, buf, sizeof(buf), 0) > 0)
+    ++count;
+  return count;
+}
+
+/// Large reads, split into messages at their delimiter.
+std::size_t receive_stream(SOCKET sd) {
+  line_framer<> in(sd);
+  gsl::cstring_span<> record;
+  std::size_t count = 0;
+  while (count < messages && in.read(record))
+    ++count;
+  return count;
+}
+
+void bench_socketpair(const char *name, int type) {
+  int fds[2];
+  if (socketpair(AF_LOCAL, type, 0, fds) == -1) {
+    perror("socketpair");
+    return;
+  }
+  bench_one_way(name, fds[0], fds[1],
+                type == SOCK_STREAM ? receive_stream : receive_messages);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+/// seqpacket connection set up through the builder's listen and accept.
+void bench_seqpacket_connection() {
+  auto listener{make_listener<sockaddr_un, SOCK_SEQPACKET>(srv_path)};
+  std::unique_ptr<socket_seqpacket_local> client{
+      socket_seqpacket_local::create("")
+          ->socket()
+          ->connect(sockno(*listener))
+          ->build()};
+  auto conn{accept_socket<socket_seqpacket_local>(sockno(*listener))};
+  if (!listener || !is_open(*client) || !conn) {
+    perror("seqpacket");
+    return;
+  }
+
+  bench_one_way("one way: seqpacket, listen/accept", sockno(*client),
+                sockno(*conn), receive_messages);
+}
+
+} // namespace
+
+int main() {
+  bench_socketpair("one way: unix dgram", SOCK_DGRAM);
+  bench_socketpair("one way: unix stream, delimited", SOCK_STREAM);
+  bench_socketpair("one way: unix seqpacket", SOCK_SEQPACKET);
+  bench_seqpacket_connection();
+}
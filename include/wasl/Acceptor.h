@@ -0,0 +1,187 @@
+#ifndef WASL_ACCEPTOR_H
+#define WASL_ACCEPTOR_H
+
+#include <wasl/Common.h>
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Socket.h>
+#include <wasl/Types.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <fcntl.h>
+
+namespace wasl {
+namespace ip {
+
+/// Accepts connections on a listening socket as a reactor finds it
+/// readable, and adds each to the reactor.
+///
+/// Every wakeup drains the accept queue with accept4(), up to a batch
+/// limit, so that a connection storm costs one poll per batch rather than
+/// one per connection. When the process runs out of descriptors or memory
+/// the listener is paused for a backoff, leaving the queue to the kernel,
+/// rather than spinning on a readable listener that cannot be accepted.
+/// For several reactor threads, give each its own acceptor on one of
+/// make_reuseport_listeners().
+///
+/// The acceptor owns the accepted socket_nodes: a connection stays open
+/// until close(), e.g. from its handler on end of stream or from
+/// io_mux_base::on_hangup(), or until the acceptor goes away.
+///
+/// \tparam Node socket_node type of the connections, e.g.
+/// socket_seqpacket_local
+/// \tparam Mux io_mux_base instantiation
+/// \tparam Trace tracing policy of the accept step
+template <typename Node, typename Mux, typename Trace = null_trace>
+class acceptor {
+public:
+  /// Called once per connection, after it was added to the reactor; bind
+  /// its handler here.
+  using accept_fn = std::function<void(Node &connection)>;
+
+  /// Connections accepted per wakeup at most, by default.
+  static constexpr std::size_t default_batch = 64;
+
+  /// \param listener socket built with socket_builder::listen(), made
+  /// non-blocking by start()
+  /// \param flags accept4() flags of the connections
+  /// \param batch connections accepted per wakeup at most, the rest wait
+  /// for the next turn of the reactor
+  acceptor(Mux &mux, SOCKET listener, int flags = SOCK_NONBLOCK | SOCK_CLOEXEC,
+           std::size_t batch = default_batch)
+      : _mux{mux}, _listener{listener}, _flags{flags},
+        _batch{batch > 0 ? batch : 1} {}
+
+  /// Removes the listener and closes every connection.
+  ~acceptor() {
+    if (_backoff)
+      _mux.cancel_timer(_backoff);
+    if (_started)
+      _mux.remove(_listener);
+    for (auto &c : _connections)
+      _mux.remove(c.first);
+  }
+
+  WASL_NO_COPY(acceptor);
+
+  /// Add the listener to the reactor and accept from now on.
+  /// \return false if the listener could not be added
+  bool start(accept_fn on_accept) {
+    if (_started)
+      return false;
+
+    // an empty queue must end the batch rather than block the reactor
+    auto fl = fcntl(_listener, F_GETFL);
+    if (fl == -1 || fcntl(_listener, F_SETFL, fl | O_NONBLOCK) == -1 ||
+        !_mux.add(_listener))
+      return false;
+
+    _on_accept = std::move(on_accept);
+    _started = true;
+    _mux.bind_event(_listener,
+                    labeled_handler<std::string>{
+                        "accept", [this](SOCKET, std::string) { accept(); }});
+    return true;
+  }
+
+  /// Remove the connection sd from the reactor and close it.
+  /// \return false if sd is not a connection of this acceptor
+  bool close(SOCKET sd) {
+    auto it = _connections.find(sd);
+    if (it == _connections.end())
+      return false;
+
+    _mux.remove(sd);
+    _connections.erase(it);
+    return true;
+  }
+
+  /// The connection sd, nullptr if it is not one of this acceptor.
+  Node *find(SOCKET sd) {
+    auto it = _connections.find(sd);
+    return it != _connections.end() ? it->second.get() : nullptr;
+  }
+
+  std::size_t connections() const { return _connections.size(); }
+
+  /// Connections accepted so far.
+  uint64_t accepted() const { return _accepted; }
+
+  /// Failed accepts, other than for an empty queue.
+  uint64_t errors() const { return _errors; }
+
+  /// Wakeups of the listener, each accepting a batch.
+  uint64_t wakeups() const { return _wakeups; }
+
+  /// Times the listener was paused, out of descriptors or memory.
+  uint64_t backoffs() const { return _backoffs; }
+
+private:
+  /// Accept until the queue is empty or the batch is full.
+  void accept() {
+    ++_wakeups;
+    // failed attempts count against the batch too
+    for (std::size_t n = 0; n < _batch; ++n) {
+      auto conn = accept_socket<Node, Trace>(_listener, _flags);
+      if (!conn) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          return;
+        ++_errors;
+        if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS ||
+            errno == ENOMEM)
+          return back_off();
+        // the connection failed, not the listener
+        if (errno == ECONNABORTED || errno == EPROTO || errno == EPERM ||
+            errno == EINTR)
+          continue;
+        return; // e.g. EINVAL, the socket is not listening
+      }
+
+      auto sd = sockno(*conn);
+      if (!_mux.add(sd)) {
+        ++_errors;
+        continue;
+      }
+
+      auto &node = *conn;
+      _connections[sd] = std::move(conn);
+      ++_accepted;
+      if (_on_accept)
+        _on_accept(node);
+    }
+  }
+
+  /// Pause the listener for 10ms, out of descriptors or memory.
+  void back_off() {
+    ++_backoffs;
+    _mux.pause_input(_listener);
+    _backoff = _mux.run_after(std::chrono::milliseconds(10), [this] {
+      _backoff = 0;
+      _mux.resume_input(_listener);
+    });
+  }
+
+  Mux &_mux;
+  SOCKET _listener;
+  int _flags;
+  std::size_t _batch;
+  bool _started{false};
+  typename Mux::timer_id _backoff{0}; // resumes the paused listener
+  accept_fn _on_accept;
+  std::map<SOCKET, std::unique_ptr<Node>> _connections;
+  uint64_t _accepted{0};
+  uint64_t _errors{0};
+  uint64_t _wakeups{0};
+  uint64_t _backoffs{0};
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_ACCEPTOR_H */
@@ -0,0 +1,238 @@
+#ifndef WASL_CAPTURE_H
+#define WASL_CAPTURE_H
+
+#include <wasl/Common.h>
+#include <wasl/Metrics.h>
+#include <wasl/Peer.h>
+#include <wasl/Types.h>
+
+#include <gsl/span>
+#include <gsl/string_span> // czstring
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include <sys/uio.h>
+
+namespace wasl {
+namespace ip {
+
+/// Which way captured bytes crossed the socket.
+enum class capture_dir : uint8_t { IN, OUT };
+
+/// Header of one captured message, followed by length payload bytes and
+/// padding to the next 8-byte boundary. Host byte order.
+struct capture_record {
+  uint64_t time_ns; // wall clock, see realtime_ns()
+  int32_t fd;
+  uint32_t topic; // set with capture_file::set_topic(), 0 if none
+  uint32_t length;
+  uint8_t dir; // capture_dir
+  uint8_t reserved[3];
+};
+static_assert(sizeof(capture_record) == 24, "capture_record layout changed");
+
+/// Append-only capture of socket traffic in a memory-mapped file.
+///
+/// The file is sized to its capacity up front (sparse) and mapped once, so
+/// appending is an atomic reservation and a memcpy, without syscalls or
+/// locks; any number of threads may append. Messages not fitting the
+/// remaining capacity are counted as dropped. The file keeps its capacity
+/// when the capture_file is destroyed; the unused tail stays sparse.
+///
+/// A record becomes visible to readers once its length is published, so a
+/// capture can be read while it is still being written, and after.
+class capture_file {
+public:
+  static constexpr char magic[4] = {'W', 'C', 'A', 'P'};
+  static constexpr uint32_t version = 1;
+  static constexpr std::size_t header_size = 16;
+
+  /// Create the file at path, replacing any file there.
+  /// Check the result with operator bool and errno on failure.
+  explicit capture_file(gsl::czstring<> path,
+                        std::size_t capacity = std::size_t{64} << 20);
+  ~capture_file();
+
+  WASL_NO_COPY(capture_file);
+
+  explicit operator bool() const { return _base != nullptr; }
+
+  /// Record len bytes of fd.
+  /// \param time_ns capture time, 0 for now
+  /// \return false if the capture is full, or len is 0: readers take a zero
+  /// length for the end of the capture
+  bool append(SOCKET fd, capture_dir dir, const char *data, std::size_t len,
+              uint64_t time_ns = 0) noexcept;
+
+  /// Record the first len bytes gathered from iov as one message.
+  bool appendv(SOCKET fd, capture_dir dir, const struct iovec *iov,
+               int iovcnt, std::size_t len, uint64_t time_ns = 0) noexcept;
+
+  /// Tag the messages of fd with topic, e.g. topic_id() of its subscription.
+  /// fds at or above reactor_stats::max_tracked_fds are not tagged.
+  void set_topic(SOCKET fd, uint32_t topic) noexcept;
+  uint32_t topic(SOCKET fd) const noexcept;
+
+  /// Bytes captured so far, including the file header.
+  std::size_t size() const noexcept;
+  std::size_t capacity() const noexcept { return _capacity; }
+  uint64_t records() const noexcept {
+    return _records.load(std::memory_order_relaxed);
+  }
+  uint64_t dropped() const noexcept {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  /// Reserve room for a record of len payload bytes.
+  /// \return its header, or nullptr if full or len is 0
+  capture_record *reserve(SOCKET fd, capture_dir dir, std::size_t len,
+                          uint64_t time_ns) noexcept;
+  void publish(capture_record *rec, std::size_t len) noexcept;
+
+  int _fd{-1};
+  char *_base{nullptr};
+  std::size_t _capacity{0};
+  std::atomic<std::size_t> _tail{header_size};
+  std::atomic<uint32_t> _topics[reactor_stats::max_tracked_fds] = {};
+  // unlike stat_counter, appenders on several threads may count at once
+  std::atomic<uint64_t> _records{0};
+  std::atomic<uint64_t> _dropped{0};
+};
+
+/// The capture file tapped by \ref capture_sockio, nullptr when capturing is
+/// off. Swap it at any time; the file must outlive messages in flight.
+inline std::atomic<capture_file *> &active_capture() noexcept {
+  static std::atomic<capture_file *> capture{nullptr};
+  return capture;
+}
+
+/// SockIO policy decorator recording traffic into active_capture().
+/// Costs one relaxed load per call while capturing is off.
+template <typename SockIO> struct capture_sockio : SockIO {
+  static ssize_t rv_recv(SOCKET sfd, char *buf, int flags = 0) {
+    auto n = SockIO::rv_recv(sfd, buf, flags);
+    tap(sfd, capture_dir::IN, buf, n, flags);
+    return n;
+  }
+
+  static ssize_t rv_recv_from(SOCKET sfd, char *buf, std::size_t len,
+                              peer_address &from, int flags = 0) {
+    auto n = SockIO::rv_recv_from(sfd, buf, len, from, flags);
+    tap(sfd, capture_dir::IN, buf, n, flags);
+    return n;
+  }
+
+  static ssize_t rv_next_size(SOCKET sfd, int flags = 0) {
+    return SockIO::rv_next_size(sfd, flags);
+  }
+
+  static ssize_t rv_recv_stamped(SOCKET sfd, char *buf, std::size_t len,
+                                 uint64_t &arrival_ns,
+                                 peer_address *from = nullptr, int flags = 0) {
+    auto n = SockIO::rv_recv_stamped(sfd, buf, len, arrival_ns, from, flags);
+    tap(sfd, capture_dir::IN, buf, n, flags, arrival_ns);
+    return n;
+  }
+
+  static ssize_t rv_recv_msg(SOCKET sfd, char *buf, std::size_t len,
+                             int flags = 0) {
+    auto n = SockIO::rv_recv_msg(sfd, buf, len, flags);
+    tap(sfd, capture_dir::IN, buf, n, flags);
+    return n;
+  }
+
+  static ssize_t rv_send(SOCKET sfd, char *buf, socklen_t len, int flags = 0) {
+    auto n = SockIO::rv_send(sfd, buf, len, flags);
+    tap(sfd, capture_dir::OUT, buf, n, 0);
+    return n;
+  }
+
+  static ssize_t rv_send_to(SOCKET sfd, const char *buf, std::size_t len,
+                            const peer_address &to, int flags = 0) {
+    auto n = SockIO::rv_send_to(sfd, buf, len, to, flags);
+    tap(sfd, capture_dir::OUT, buf, n, 0);
+    return n;
+  }
+
+  static ssize_t rv_sendv(SOCKET sfd, const struct iovec *iov, int iovcnt,
+                          int flags = 0) {
+    auto n = SockIO::rv_sendv(sfd, iov, iovcnt, flags);
+    if (n > 0)
+      if (auto *capture = active_capture().load(std::memory_order_relaxed))
+        capture->appendv(sfd, capture_dir::OUT, iov, iovcnt, n);
+    return n;
+  }
+
+private:
+  static void tap(SOCKET sfd, capture_dir dir, const char *buf, ssize_t n,
+                  int flags, uint64_t time_ns = 0) {
+    // peeked bytes are captured when they are consumed
+    if (n <= 0 || (flags & MSG_PEEK))
+      return;
+    if (auto *capture = active_capture().load(std::memory_order_relaxed))
+      capture->append(sfd, dir, buf, n, time_ns);
+  }
+};
+
+/// Read-only view of a capture file, possibly still being written.
+class capture_reader {
+public:
+  /// Check the result with operator bool and errno on failure; EPROTO if
+  /// path is not a capture file.
+  explicit capture_reader(gsl::czstring<> path);
+  ~capture_reader();
+
+  WASL_NO_COPY(capture_reader);
+
+  explicit operator bool() const { return _base != nullptr; }
+
+  /// Call fn(const capture_record &, gsl::span<const char> payload) for each
+  /// complete record, in capture order.
+  /// \return number of records visited
+  template <typename Fn> std::size_t for_each(Fn fn) const {
+    std::size_t n = 0;
+    const capture_record *rec;
+    for (auto off = next(capture_file::header_size, &rec); rec;
+         off = next(off, &rec), ++n) {
+      auto *payload = reinterpret_cast<const char *>(rec + 1);
+      fn(*rec, gsl::span<const char>{payload, payload + rec->length});
+    }
+    return n;
+  }
+
+private:
+  /// \param[out] rec record at off, nullptr past the last complete one
+  /// \return offset of the record after it
+  std::size_t next(std::size_t off, const capture_record **rec) const;
+
+  const char *_base{nullptr};
+  std::size_t _size{0};
+};
+
+/// What and how fast to replay.
+struct replay_options {
+  /// Time scale relative to the capture: 1 real time, 10 ten times faster,
+  /// 0 as fast as possible.
+  double speed{1.0};
+  capture_dir dir{capture_dir::IN}; // typically what the service received
+  SOCKET fd{INVALID_SOCKET};        // only messages of this fd, or all
+  uint32_t topic{0};                // only messages of this topic, or all
+};
+
+/// Called for each replayed message; false stops the replay.
+using replay_fn =
+    std::function<bool(const capture_record &, gsl::span<const char>)>;
+
+/// Pass the selected messages of capture to send, spaced as captured
+/// divided by options.speed.
+/// \return messages passed to send
+std::size_t replay(const capture_reader &capture, const replay_options &options,
+                   const replay_fn &send);
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_CAPTURE_H */
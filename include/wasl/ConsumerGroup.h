@@ -0,0 +1,226 @@
+#ifndef WASL_CONSUMERGROUP_H
+#define WASL_CONSUMERGROUP_H
+
+#include <wasl/IOMultiplexer.h>
+#include <wasl/SubscriberQueue.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wasl {
+namespace ip {
+
+/// How a consumer_group picks the member receiving a message.
+enum class balance_strategy : uint8_t {
+  ROUND_ROBIN,       // members in turn
+  LEAST_OUTSTANDING, // member with the fewest unacknowledged messages
+  CONSISTENT_HASH,   // by message key; a key sticks to its member, and
+                     // membership changes only move the keys of that member
+};
+
+/// Distributes messages across member sockets, each message to exactly one
+/// member, e.g. to spread work over several local consumer processes.
+///
+/// Each member gets a bounded subscriber_queue, so a stalled member cannot
+/// hold up the others. Members acknowledge a processed message by writing
+/// one byte back; acknowledgements drive LEAST_OUTSTANDING. A member whose
+/// peer closes leaves the group.
+///
+/// \tparam Mux io_mux_base instantiation driving member sockets
+/// \tparam SockIO socket I/O policy, e.g. basic_sockio
+template <typename Mux, typename SockIO = basic_sockio<platform_type>>
+class consumer_group {
+public:
+  /// Member sockets left in the group, e.g. to close them.
+  using leave_fun = std::function<void(SOCKET)>;
+
+  /// \param capacity bound of each member's outbound queue
+  /// \param vnodes points per member on the hash ring (CONSISTENT_HASH)
+  consumer_group(Mux &mux, balance_strategy strategy,
+                 std::size_t capacity = 1024,
+                 overflow_policy policy = overflow_policy::DROP_NEWEST,
+                 unsigned vnodes = 64)
+      : _mux{mux}, _strategy{strategy}, _capacity{capacity}, _policy{policy},
+        _vnodes{vnodes ? vnodes : 1} {}
+
+  WASL_NO_COPY(consumer_group);
+
+  /// Add sd as a member and watch it through the muxer.
+  /// \return false if sd is already a member or cannot be watched
+  bool join(SOCKET sd) {
+    if (find(sd) != _members.end() || !_mux.add(sd))
+      return false;
+
+    auto m = std::make_unique<member>(sd, _capacity, _policy);
+    m->queue.attach(_mux);
+    _members.push_back(std::move(m));
+    for (unsigned v = 0; v < _vnodes; ++v)
+      _ring.emplace(ring_point(sd, v), sd);
+
+    _mux.bind_event(sd, labeled_handler<std::string>{
+                            "consumer_group",
+                            [this](SOCKET fd, std::string) { on_input(fd); }});
+    return true;
+  }
+
+  /// Remove sd from the group and the muxer. Messages still queued for it
+  /// are dropped. Safe to call from handlers of the muxer.
+  bool leave(SOCKET sd) {
+    auto it = find(sd);
+    if (it == _members.end())
+      return false;
+
+    _mux.remove(sd);
+    _members.erase(it);
+    for (unsigned v = 0; v < _vnodes; ++v)
+      _ring.erase(ring_point(sd, v));
+
+    if (_on_leave)
+      _on_leave(sd);
+    return true;
+  }
+
+  void on_leave(leave_fun f) { _on_leave = std::move(f); }
+
+  /// Send msg to one member chosen by the strategy.
+  /// \param key routing key for CONSISTENT_HASH, ignored otherwise
+  /// \return the member's socket, or INVALID_SOCKET if the group is empty or
+  /// the member's queue dropped msg
+  SOCKET publish(std::string msg, uint64_t key = 0) {
+    auto *m = pick(key);
+    if (!m)
+      return INVALID_SOCKET;
+    auto before = replaced(*m);
+    if (!m->queue.publish(std::move(msg), key))
+      return INVALID_SOCKET;
+
+    // a queued message evicted or conflated for msg is never sent
+    auto lost = replaced(*m) - before;
+    m->outstanding = m->outstanding + 1 > lost ? m->outstanding + 1 - lost : 0;
+    m->delivered += 1 - lost;
+    return sockno(m->queue);
+  }
+
+  std::size_t size() const { return _members.size(); }
+
+  /// Messages sent to sd and not acknowledged yet.
+  uint64_t outstanding(SOCKET sd) const {
+    auto it = find(sd);
+    return it == _members.end() ? 0 : (*it)->outstanding;
+  }
+
+  /// Messages sent, or queued to be sent, to sd since it joined.
+  uint64_t delivered(SOCKET sd) const {
+    auto it = find(sd);
+    return it == _members.end() ? 0 : (*it)->delivered;
+  }
+
+private:
+  struct member {
+    member(SOCKET sd, std::size_t capacity, overflow_policy policy)
+        : queue{sd, capacity, policy} {}
+
+    subscriber_queue<SockIO> queue;
+    uint64_t outstanding{0};
+    uint64_t delivered{0};
+  };
+
+  using member_list = std::vector<std::unique_ptr<member>>;
+
+  /// Messages dropped from m's queue to make room for newer ones.
+  static uint64_t replaced(const member &m) {
+    auto &stats = m.queue.stats();
+    return stats.dropped_oldest.get() + stats.conflated.get();
+  }
+
+  typename member_list::iterator find(SOCKET sd) {
+    return std::find_if(_members.begin(), _members.end(),
+                        [sd](const auto &m) { return sockno(m->queue) == sd; });
+  }
+
+  typename member_list::const_iterator find(SOCKET sd) const {
+    return std::find_if(_members.begin(), _members.end(),
+                        [sd](const auto &m) { return sockno(m->queue) == sd; });
+  }
+
+  static uint64_t mix(uint64_t x) {
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  static uint64_t ring_point(SOCKET sd, unsigned vnode) {
+    return mix(static_cast<uint64_t>(sd) << 32 | vnode);
+  }
+
+  member *pick(uint64_t key) {
+    if (_members.empty())
+      return nullptr;
+
+    switch (_strategy) {
+    case balance_strategy::ROUND_ROBIN:
+      return _members[_next++ % _members.size()].get();
+
+    case balance_strategy::LEAST_OUTSTANDING: {
+      // start after the last pick so ties rotate
+      auto n = _members.size();
+      auto start = _next++ % n;
+      member *best = nullptr;
+      for (std::size_t i = 0; i < n; ++i) {
+        auto *m = _members[(start + i) % n].get();
+        if (!best || m->outstanding < best->outstanding)
+          best = m;
+      }
+      return best;
+    }
+
+    case balance_strategy::CONSISTENT_HASH: {
+      auto it = _ring.lower_bound(mix(key));
+      if (it == _ring.end())
+        it = _ring.begin();
+      return find(it->second)->get();
+    }
+    }
+    return nullptr;
+  }
+
+  /// Acknowledgements from a member, or its hangup.
+  void on_input(SOCKET sd) {
+    char acks[256];
+    auto n = recv(sd, acks, sizeof(acks), MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      leave(sd);
+      return;
+    }
+
+    auto it = find(sd);
+    if (n > 0 && it != _members.end()) {
+      auto &m = **it;
+      m.outstanding = m.outstanding > static_cast<uint64_t>(n)
+                          ? m.outstanding - n
+                          : 0;
+    }
+  }
+
+  Mux &_mux;
+  balance_strategy _strategy;
+  std::size_t _capacity;
+  overflow_policy _policy;
+  unsigned _vnodes;
+  member_list _members;
+  std::map<uint64_t, SOCKET> _ring; // CONSISTENT_HASH points
+  std::size_t _next{0};
+  leave_fun _on_leave;
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_CONSUMERGROUP_H */
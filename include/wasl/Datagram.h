@@ -0,0 +1,213 @@
+#ifndef WASL_DATAGRAM_H
+#define WASL_DATAGRAM_H
+
+#include <wasl/SockStream.h>
+
+#include <gsl/span>
+
+#include <cerrno>
+#include <vector>
+
+namespace wasl {
+namespace ip {
+
+/// A streambuf over a datagram socket that preserves record boundaries.
+///
+/// Every datagram is received whole in one syscall: its size is peeked with
+/// MSG_PEEK|MSG_TRUNC and the receive buffer grows to fit, then keeps its
+/// capacity for later datagrams. Reads stop with eof at the end of a
+/// datagram until next() is called. On output, everything written between
+/// two flushes leaves as one datagram, whatever its size.
+///
+/// SOCK_SEQPACKET connections keep message boundaries the same way, so this
+/// serves them too: see seqpacket_sockstream.
+///
+/// \tparam SockIO socket I/O policy, e.g. basic_sockio
+/// \tparam Trace tracing policy, null_trace compiles away
+template <typename SockIO, typename Trace = null_trace>
+class dgram_sockbuf : public std::streambuf, private SockIO {
+public:
+  explicit dgram_sockbuf(SOCKET fd) : m_sockFD{fd} {
+    m_in.reserve(SockIO::BUFLEN);
+    m_out.resize(SockIO::BUFLEN);
+    setp(m_out.data(), m_out.data() + m_out.size());
+    setg(m_in.data(), m_in.data(), m_in.data());
+  }
+
+  template <typename> friend class basic_sockstream;
+
+  /// Receive the next datagram, dropping what is left of the current one.
+  /// \return its size, or -1 on error (see errno)
+  ssize_t next() {
+    m_open = false;
+    return receive();
+  }
+
+  /// The current datagram, whole, regardless of how much has been read.
+  gsl::span<const char> message() const {
+    return {m_in.data(), m_in.data() + m_in.size()};
+  }
+
+  /// Source address of the current datagram.
+  const peer_address &peer() const { return m_peer; }
+
+  /// Kernel arrival time of the current datagram in wall clock ns, 0 unless
+  /// the socket was built with socket_builder::timestamps().
+  uint64_t arrival_ns() const { return m_arrival_ns; }
+
+protected:
+  /**
+   * output
+   */
+
+  // grow the put area instead of sending, so a flush is one datagram
+  int_type overflow(int_type c) override {
+    auto used = pptr() - pbase();
+    m_out.resize(m_out.size() * 2);
+    setp(m_out.data(), m_out.data() + m_out.size());
+    pbump(static_cast<int>(used));
+
+    if (c != traits_type::eof()) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override {
+    auto num = pptr() - pbase();
+    if (num == 0)
+      return 0;
+
+    auto sent = SockIO::rv_send(m_sockFD, pbase(), num);
+    pbump(-static_cast<int>(num));
+    if (sent != num)
+      return -1;
+
+    Trace::record(trace_kind::bytes_sent, m_sockFD, num);
+    return 0;
+  }
+
+  /**
+   * input
+   */
+
+  /// Receives a datagram if none is open; at the end of an open datagram
+  /// returns eof, the record boundary.
+  int_type underflow() override {
+    if (gptr() < egptr())
+      return traits_type::to_int_type(*gptr());
+
+    if (m_open || receive() <= 0)
+      return traits_type::eof();
+
+    return traits_type::to_int_type(*gptr());
+  }
+
+private:
+  ssize_t receive() {
+    auto size = SockIO::rv_next_size(m_sockFD);
+    if (size < 0)
+      return -1;
+
+    m_in.resize(size);
+    auto num = SockIO::rv_recv_stamped(m_sockFD, m_in.data(), m_in.size(),
+                                       m_arrival_ns, &m_peer);
+    if (num < 0) {
+      m_in.clear();
+      setg(m_in.data(), m_in.data(), m_in.data());
+      return -1;
+    }
+    Trace::record(trace_kind::bytes_received, m_sockFD, num);
+
+    m_in.resize(num);
+    m_open = true;
+    setg(m_in.data(), m_in.data(), m_in.data() + num);
+    return num;
+  }
+
+  SOCKET m_sockFD;
+  std::vector<char> m_in;
+  std::vector<char> m_out;
+  peer_address m_peer;
+  uint64_t m_arrival_ns{0};
+  bool m_open{false};
+};
+
+/// A sockstream whose reads stop at datagram boundaries.
+///
+///   ss >> a >> b;       // fields of one datagram
+///   ss.next();          // move on to the following datagram
+template <typename SockBuf>
+class basic_dgram_sockstream : public basic_sockstream<SockBuf> {
+public:
+  using basic_sockstream<SockBuf>::basic_sockstream;
+
+  /// Clear eof and receive the next datagram.
+  /// Sets failbit if the receive fails.
+  basic_dgram_sockstream &next() {
+    this->clear();
+    if (this->rdbuf()->next() < 0)
+      this->setstate(std::ios::failbit);
+    return *this;
+  }
+
+  /// \see dgram_sockbuf::message()
+  gsl::span<const char> message() const { return this->rdbuf()->message(); }
+
+  /// \see dgram_sockbuf::peer()
+  const peer_address &peer() const { return this->rdbuf()->peer(); }
+
+  /// \see dgram_sockbuf::arrival_ns()
+  uint64_t arrival_ns() const { return this->rdbuf()->arrival_ns(); }
+};
+
+using dgram_sockstream =
+    basic_dgram_sockstream<dgram_sockbuf<basic_sockio<platform_type>>>;
+
+/// Stream over a connected SOCK_SEQPACKET socket, one message per flush.
+using seqpacket_sockstream = dgram_sockstream;
+
+/// One unconnected datagram socket serving many peers.
+///
+/// Every received datagram is tagged with the compact id of its source, and
+/// replies go out with send_to() on the same socket, so no connected socket
+/// per peer is needed. Does not own the socket.
+template <typename SockIO = basic_sockio<platform_type>> class dgram_endpoint {
+public:
+  explicit dgram_endpoint(SOCKET sd) : _sd{sd} {}
+
+  /// Receive one datagram into buf; datagrams longer than len are truncated.
+  /// \param[out] from id of the sender, invalid_peer if it has no address
+  /// \return bytes received, or -1 on error (see errno)
+  ssize_t recv(char *buf, std::size_t len, peer_id &from, int flags = 0) {
+    peer_address addr;
+    auto n = SockIO::rv_recv_from(_sd, buf, len, addr, flags);
+    from = n >= 0 && addr ? _peers.intern(addr) : invalid_peer;
+    return n;
+  }
+
+  /// Send buf as one datagram to a peer seen by recv().
+  /// \return bytes sent, or -1 on error; errno is EINVAL for unknown peers
+  ssize_t send_to(peer_id to, gsl::span<const char> buf, int flags = 0) {
+    auto *addr = _peers.find(to);
+    if (!addr) {
+      errno = EINVAL;
+      return -1;
+    }
+    return SockIO::rv_send_to(_sd, buf.data(), buf.size(), *addr, flags);
+  }
+
+  peer_table &peers() { return _peers; }
+
+  friend SOCKET sockno(const dgram_endpoint &ep) { return ep._sd; }
+
+private:
+  SOCKET _sd;
+  peer_table _peers;
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_DATAGRAM_H */
@@ -0,0 +1,163 @@
+#ifndef WASL_HANDLERS_H
+#define WASL_HANDLERS_H
+
+#include <wasl/Types.h>
+
+#include <cstddef>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace wasl {
+
+template <typename Sig, std::size_t Capacity = 32> class inplace_function;
+
+/// A std::function replacement that never allocates.
+///
+/// The callable is stored in a fixed buffer of Capacity bytes; callables
+/// that do not fit fail to compile instead of falling back to the heap.
+/// Calls still go through one indirect jump, see handler_set for fully
+/// static dispatch.
+template <typename R, typename... Args, std::size_t Capacity>
+class inplace_function<R(Args...), Capacity> {
+  using storage_type =
+      std::aligned_storage_t<Capacity, alignof(std::max_align_t)>;
+
+  struct vtable {
+    R (*invoke)(void *, Args &&...);
+    void (*copy)(void *dst, const void *src);
+    void (*move)(void *dst, void *src);
+    void (*destroy)(void *);
+  };
+
+  template <typename F> static const vtable *vtable_for() {
+    static const vtable vt{
+        [](void *f, Args &&... args) -> R {
+          return (*static_cast<F *>(f))(std::forward<Args>(args)...);
+        },
+        [](void *dst, const void *src) {
+          new (dst) F(*static_cast<const F *>(src));
+        },
+        [](void *dst, void *src) {
+          new (dst) F(std::move(*static_cast<F *>(src)));
+        },
+        [](void *f) { static_cast<F *>(f)->~F(); }};
+    return &vt;
+  }
+
+public:
+  static constexpr std::size_t capacity = Capacity;
+
+  inplace_function() noexcept = default;
+
+  template <typename F, typename D = std::decay_t<F>,
+            typename = std::enable_if_t<
+                !std::is_same<D, inplace_function>::value>>
+  inplace_function(F &&f) : _vt{vtable_for<D>()} {
+    static_assert(sizeof(D) <= Capacity,
+                  "callable too large for inplace_function capacity");
+    static_assert(alignof(D) <= alignof(storage_type),
+                  "callable over-aligned for inplace_function");
+    new (&_storage) D(std::forward<F>(f));
+  }
+
+  inplace_function(const inplace_function &other) : _vt{other._vt} {
+    if (_vt)
+      _vt->copy(&_storage, &other._storage);
+  }
+
+  inplace_function(inplace_function &&other) noexcept : _vt{other._vt} {
+    if (_vt)
+      _vt->move(&_storage, &other._storage);
+  }
+
+  inplace_function &operator=(inplace_function other) noexcept {
+    reset();
+    _vt = other._vt;
+    if (_vt)
+      _vt->move(&_storage, &other._storage);
+    return *this;
+  }
+
+  ~inplace_function() { reset(); }
+
+  R operator()(Args... args) const {
+    return _vt->invoke(const_cast<storage_type *>(&_storage),
+                       std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const noexcept { return _vt != nullptr; }
+
+private:
+  void reset() noexcept {
+    if (_vt)
+      _vt->destroy(&_storage);
+    _vt = nullptr;
+  }
+
+  const vtable *_vt{nullptr};
+  storage_type _storage;
+};
+
+/// A fixed, compile-time list of handlers.
+///
+/// dispatch() selects a handler by index through a chain of constant
+/// comparisons that the compiler folds into a switch or jump table, with
+/// each handler body inlined at its case. No type erasure is involved.
+template <typename... Handlers> class handler_set {
+public:
+  static constexpr std::size_t size = sizeof...(Handlers);
+
+  explicit handler_set(Handlers... handlers)
+      : _handlers{std::move(handlers)...} {}
+
+  template <std::size_t I> auto &get() { return std::get<I>(_handlers); }
+
+  /// Invoke handler index with args; out-of-range indices are ignored.
+  template <typename... Args> void dispatch(std::size_t index, Args &... args) {
+    dispatch_impl(std::integral_constant<std::size_t, 0>{}, index, args...);
+  }
+
+private:
+  template <std::size_t I, typename... Args>
+  void dispatch_impl(std::integral_constant<std::size_t, I>, std::size_t index,
+                     Args &... args) {
+    if (index == I) {
+      std::get<I>(_handlers)(args...);
+      return;
+    }
+    dispatch_impl(std::integral_constant<std::size_t, I + 1>{}, index,
+                  args...);
+  }
+
+  template <typename... Args>
+  void dispatch_impl(std::integral_constant<std::size_t, size>, std::size_t,
+                     Args &...) {}
+
+  std::tuple<Handlers...> _handlers;
+};
+
+template <typename... Handlers>
+handler_set<Handlers...> make_handler_set(Handlers... handlers) {
+  return handler_set<Handlers...>{std::move(handlers)...};
+}
+
+/// Handler stored per descriptor by a static_io_mux: an index into its
+/// handler_set. Trivially copyable, so binding and dispatching never
+/// allocate.
+template <typename Set> struct static_handler {
+  Set *set{nullptr};
+  std::size_t index{0};
+
+  template <typename... Args> void operator()(Args &&... args) const {
+    set->dispatch(index, args...);
+  }
+
+  explicit operator bool() const noexcept { return set != nullptr; }
+};
+
+} // namespace wasl
+
+#endif /* WASL_HANDLERS_H */
@@ -2,16 +2,28 @@
 #define WASL_IOMULTIPLEXER_H
 
 #include <wasl/Common.h>
+#include <wasl/Handlers.h>
+#include <wasl/Metrics.h>
+#include <wasl/RateLimit.h>
+#include <wasl/TaskQueue.h>
+#include <wasl/Trace.h>
 #include <wasl/Types.h>
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <iterator>
 #include <map>
-#include <set>
+#include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #ifdef SYS_API_LINUX
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
 #include <sys/unistd.h>
 #endif
 
@@ -29,50 +41,655 @@ using labeled_handler = std::pair<Label, Callable>;
 template <typename T, typename L>
 using event_map = std::map<T, labeled_handler<L>>;
 
-template <typename T, typename Muxer> class io_mux_base : Muxer {
+/// Readiness reported by a Muxer for one descriptor.
+enum class ready_flags : uint32_t {
+  NONE = 0x0,
+  READABLE = 0x1,
+  HANGUP = 0x2, // peer closed, or error on the descriptor
+  WRITABLE = 0x4,
+};
+WASL_MARK_AS_BITMASK_ENUM(ready_flags);
+
+template <typename T> struct ready_event {
+  T fd;
+  ready_flags flags;
+
+  bool is(ready_flags f) const { return local::toUType(flags & f) != 0; }
+};
+
+/// Dispatch order within a wakeup. Every ready HIGH fd is served before any
+/// NORMAL one, and every NORMAL before any LOW.
+enum class dispatch_priority : uint8_t { HIGH = 0, NORMAL = 1, LOW = 2 };
+
+/// Work a handler may do for one fd per listen() call.
+///
+/// The handler is re-invoked round-robin with the other ready fds of its
+/// priority class while its fd still has input, until either limit is hit.
+/// Input left over is picked up on the next listen(), since the muxer keeps
+/// reporting the fd as ready.
+struct dispatch_budget {
+  uint32_t messages{1}; // handler invocations per turn
+  uint64_t bytes{0};    // input bytes consumed per turn, 0 for no limit
+};
+
+/// Per-descriptor registration state indexed directly by descriptor.
+/// Descriptors are small dense integers, so lookup, replacement and removal
+/// are array accesses rather than tree walks, and a recycled descriptor
+/// always lands on a slot that was reset when its predecessor was removed.
+template <typename T, typename L, typename Callable = socket_handler_fun>
+class handler_table {
 public:
-  io_mux_base() { _listener_fd = this->init(); }
+  struct slot {
+    bool linked{false};      // added to the reactor
+    bool detached{false};    // out of the muxer while nothing is watched
+    bool bound{false};       // has a handler
+    bool dispatching{false}; // handler moved out while it runs
+    bool paused{false};      // input interest dropped by pause_input()
+    bool throttled{false};   // input interest dropped by the rate limit
+    dispatch_priority priority{dispatch_priority::NORMAL};
+    dispatch_budget budget;
+    std::shared_ptr<token_bucket> bucket; // rate limit, may be shared
+    uint64_t throttled_ns{0};             // when throttling started
+    uint64_t resume_timer{0};             // ends the throttling
+
+    bool input_held() const { return paused || throttled; }
+    std::function<void(T)> on_writable; // set while output is watched
+    labeled_handler<L, Callable> handler;
+    std::string message; // passed to the handler, built once at bind time
+  };
+
+  slot *find(T fd) {
+    auto i = static_cast<std::size_t>(fd);
+    return fd >= 0 && i < _slots.size() ? &_slots[i] : nullptr;
+  }
+
+  /// \pre fd >= 0
+  slot &at(T fd) {
+    auto i = static_cast<std::size_t>(fd);
+    if (i >= _slots.size())
+      _slots.resize(i + 1);
+    return _slots[i];
+  }
+
+  /// Release the slot, destroying its handler.
+  void erase(T fd) {
+    if (auto *s = find(fd))
+      *s = slot{};
+  }
+
+private:
+  std::vector<slot> _slots;
+};
+
+/// \tparam T descriptor type
+/// \tparam Muxer readiness notification policy, e.g. epoll_muxer
+/// \tparam Trace tracing policy, null_trace compiles away
+/// \tparam Handler callable stored per descriptor, invoked as
+/// handler(fd, message). std::function by default; inplace_function avoids
+/// allocation and static_io_mux avoids type erasure altogether.
+template <typename T, typename Muxer, typename Trace = null_trace,
+          typename Handler = socket_handler_fun>
+class io_mux_base : Muxer {
+public:
+  using handler_type = Handler;
+  using task_type = std::function<void()>;
+  using hangup_fun = std::function<void(T)>;
+  using timer_id = uint64_t;
+
+  io_mux_base() {
+    _listener_fd = this->init();
+    _notify_fd = this->make_notifier();
+    this->link_node(_listener_fd, _notify_fd);
+    _timer_fd = this->make_timer();
+    this->link_node(_listener_fd, _timer_fd);
+  }
+
+  ~io_mux_base() {
+    this->close_node(_timer_fd);
+    this->close_node(_notify_fd);
+    this->close_node(_listener_fd);
+  }
+
+  WASL_NO_COPY(io_mux_base);
 
   int listen() {
+    auto &stats = *_stats.get();
+    // only while dispatching: the reactor may be destroyed from another
+    // thread, and a listen() nested in a handler hands back the outer one
+    struct stats_scope {
+      reactor_stats *previous;
+      ~stats_scope() { this_thread_stats() = previous; }
+    } scope{this_thread_stats()};
+    this_thread_stats() = &stats;
+
     // pull fds with ready input
-    auto ready_fds = this->wait(_listener_fd);
-    if (!ready_fds.empty()) {
-      for (auto fd : ready_fds) {
-        auto it = _event_handlers.find(fd);
+    auto ready = this->wait(_listener_fd);
+    stats.wakeups.add();
+    stats.events.add(ready.size());
+    stats.batch_sizes.record(ready.size());
 
-        if (it != _event_handlers.end())
-          it->second.second(fd, "iomux event triggered: " + it->second.first);
+    for (auto &cls : _batch)
+      cls.clear();
+    _writable.clear();
+
+    for (const auto &ev : ready) {
+      if (ev.fd == _notify_fd) {
+        run_posted();
+        continue;
+      }
+      if (ev.fd == _timer_fd) {
+        run_timers();
+        continue;
+      }
+
+      if (auto *fs = stats.fd(ev.fd))
+        fs->events.add();
+      Trace::record(trace_kind::fd_ready, ev.fd);
+
+      auto *slot = _handlers.find(ev.fd);
+      if (ev.is(ready_flags::WRITABLE))
+        _writable.push_back(ev.fd);
+      if (ev.is(ready_flags::READABLE | ready_flags::HANGUP) &&
+          !(slot && slot->input_held())) {
+        auto prio = slot ? slot->priority : dispatch_priority::NORMAL;
+        _batch[local::toUType(prio)].push_back(ev);
       }
     }
 
-    return ready_fds.size();
+    // drain output first: it frees buffer space that input handlers may
+    // want to write into
+    for (auto fd : _writable)
+      dispatch_writable(fd);
+
+    for (auto &cls : _batch)
+      dispatch_class(cls, stats);
+
+    return ready.size();
+  }
+
+  /// The Muxer policy, for stateful muxers such as busy_poll_muxer.
+  Muxer &muxer() { return *this; }
+  const Muxer &muxer() const { return *this; }
+
+  /// Live counters of this reactor.
+  /// Safe to read from any thread while listen() runs.
+  const reactor_stats &stats() const { return _stats.stats(); }
+
+  /// Copy of the current counters.
+  metrics_snapshot metrics() const { return snapshot(stats()); }
+
+  /// Move the counters into a shared stats file at path so that external
+  /// tools can stats_segment::attach() to it. Counts so far are preserved.
+  ///
+  /// \return false if the segment could not be created, see errno.
+  bool export_stats(gsl::czstring<> path) {
+    stats_segment shared{path};
+    if (!shared)
+      return false;
+
+    shared.get()->assign(stats());
+    if (this_thread_stats() == _stats.get())
+      this_thread_stats() = shared.get();
+    _stats = std::move(shared);
+    return true;
+  }
+
+  /// Run task on the reactor thread during a later listen().
+  /// This is the only member safe to call from threads other than the one
+  /// calling listen(); use it to add fds, bind handlers or publish.
+  ///
+  /// A burst of posts before the reactor wakes costs a single notification.
+  void post(task_type task) {
+    _posted.push(std::move(task));
+    if (!_wake_pending.exchange(true, std::memory_order_acq_rel))
+      this->notify(_notify_fd);
+  }
+
+  /// Run task on the reactor thread during the first listen() after delay
+  /// has passed. Timers share one timer descriptor, re-armed for the
+  /// earliest deadline, so any number of them cost no extra syscalls per
+  /// wakeup.
+  /// \return id for cancel_timer()
+  timer_id run_after(std::chrono::nanoseconds delay, task_type task) {
+    auto deadline = steady_ns() + (delay.count() > 0 ? delay.count() : 0);
+    auto id = _next_timer++;
+    _timers.emplace(std::make_pair(deadline, id), std::move(task));
+    _timer_deadlines.emplace(id, deadline);
+    arm_timers();
+    return id;
+  }
+
+  /// Drop a timer before it runs. Safe to call from timer tasks.
+  /// \return false if the timer ran or was cancelled already
+  bool cancel_timer(timer_id id) {
+    auto it = _timer_deadlines.find(id);
+    if (it == _timer_deadlines.end())
+      return false;
+
+    _timers.erase(std::make_pair(it->second, id));
+    _timer_deadlines.erase(it);
+    return true;
+  }
+
+  /// Timers waiting to run.
+  std::size_t timers() const { return _timers.size(); }
+
+  /// add() from any thread.
+  void post_add(T fd) {
+    post([this, fd] { add(fd); });
+  }
+
+  /// bind_event() from any thread.
+  template <typename U, typename C>
+  void post_bind_event(T fd, labeled_handler<U, C> f) {
+    post([this, fd, f] { bind_event(fd, f); });
   }
 
   /// Bind an event handler to a socket descriptor.
   /// The event will be triggered upon reception of input on sfd.
-  template <typename U> void bind_event(T fd, labeled_handler<U> f) {
-    // todo add proper find, replace in another class.
-    // move all insert, remove, logic out to allow other muxers to use as a
-    // template param
-    _event_handlers.insert(
-        std::make_pair(fd, std::forward<labeled_handler<U>>(f)));
+  /// A handler already bound to sfd is replaced.
+  template <typename U, typename C>
+  void bind_event(T fd, labeled_handler<U, C> f) {
+    if (fd < 0)
+      return;
+
+    auto &slot = _handlers.at(fd);
+    slot.handler.first = std::move(f.first);
+    slot.handler.second = std::move(f.second);
+    slot.message = "iomux event triggered: " + slot.handler.first;
+    slot.bound = true;
+    slot.dispatching = false;
+  }
+
+  /// Replace the handler bound to fd.
+  /// \return false if fd had no handler, in which case nothing is bound
+  template <typename U, typename C>
+  bool rebind(T fd, labeled_handler<U, C> f) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !slot->bound)
+      return false;
+
+    bind_event(fd, std::move(f));
+    return true;
   }
 
   /// add a handle to the interest list
   bool add(T fd) {
-    auto handle_added = this->link_node(_listener_fd, fd);
+    if (fd < 0 || !this->link_node(_listener_fd, fd))
+      return false;
+
+    _handlers.at(fd).linked = true;
+    return true;
+  }
+
+  /// Remove fd from the interest list and release its handler and counters.
+  /// Safe to call from within fd's own handler.
+  ///
+  /// \return false if fd was neither added nor bound
+  bool remove(T fd) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !(slot->linked || slot->bound))
+      return false;
+
+    if (slot->throttled)
+      cancel_timer(slot->resume_timer);
+    if (slot->linked && !slot->detached)
+      this->unlink_node(_listener_fd, fd);
+    _handlers.erase(fd);
+    _stats.get()->reset_fd(fd);
+    return true;
+  }
+
+  /// Call f(fd) from listen() whenever fd can accept more output, until
+  /// unwatch_writable(). Use it to drain queued output without blocking.
+  /// \return false if fd was not added
+  bool watch_writable(T fd, std::function<void(T)> f) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !slot->linked)
+      return false;
+
+    bool watched = static_cast<bool>(slot->on_writable);
+    slot->on_writable = std::move(f);
+    if (!watched && !update_interest(fd, *slot)) {
+      slot->on_writable = nullptr;
+      return false;
+    }
+    return true;
+  }
+
+  /// Stop watching fd for output. Safe to call from its writable callback.
+  bool unwatch_writable(T fd) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !slot->on_writable)
+      return false;
+
+    slot->on_writable = nullptr;
+    return update_interest(fd, *slot);
+  }
 
-    if (!handle_added) { // successfully added
+  /// Stop dispatching input of fd until resume_input(), leaving it in the
+  /// kernel's buffers, e.g. to push back on a sender. The peer hanging up is
+  /// not reported while paused either. Output watches stay in place.
+  /// \return false if fd was not added
+  bool pause_input(T fd) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !slot->linked)
       return false;
+    if (slot->paused)
+      return true;
+
+    slot->paused = true;
+    return update_interest(fd, *slot);
+  }
+
+  /// Dispatch input of fd again after pause_input().
+  /// \return false if fd was not added
+  bool resume_input(T fd) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !slot->linked)
+      return false;
+    if (!slot->paused)
+      return true;
+
+    slot->paused = false;
+    return update_interest(fd, *slot);
+  }
+
+  /// Set the priority class of fd, NORMAL by default.
+  /// \pre fd >= 0
+  void set_priority(T fd, dispatch_priority prio) {
+    _handlers.at(fd).priority = prio;
+  }
+
+  /// Set the per-turn work budget of fd, one message by default.
+  /// \pre fd >= 0
+  void set_budget(T fd, dispatch_budget budget) {
+    if (budget.messages == 0)
+      budget.messages = 1;
+    _handlers.at(fd).budget = budget;
+  }
+
+  /// Limit the rate fd's input is dispatched at.
+  ///
+  /// Every dispatch takes a message, and the input bytes it consumed, from
+  /// the bucket. Once the bucket runs dry, fd is dropped from the muxer's
+  /// interest, so a flooding sender costs no wakeups, and a timer brings it
+  /// back when enough tokens refilled. Share one bucket between the fds of
+  /// a publisher to limit them together. Bytes are measured like those of a
+  /// dispatch_budget. Throttling is counted in the reactor's stats. A peer
+  /// hanging up is reported once its input was dispatched, throttled or not.
+  /// \param bucket nullptr to lift the limit
+  /// \pre fd >= 0
+  void set_rate_limit(T fd, std::shared_ptr<token_bucket> bucket) {
+    auto &slot = _handlers.at(fd);
+    slot.bucket = std::move(bucket);
+    if (!slot.bucket && slot.throttled) {
+      cancel_timer(slot.resume_timer);
+      unthrottle(fd);
     }
-    _active_socket_list.insert(fd);
-    return handle_added;
   }
 
+  /// Limit fd to limit with a bucket of its own.
+  /// \pre fd >= 0
+  void set_rate_limit(T fd, rate_limit limit) {
+    set_rate_limit(fd, std::make_shared<token_bucket>(limit, steady_ns()));
+  }
+
+  /// Whether fd waits for its rate limit to refill.
+  bool throttled(T fd) {
+    auto *slot = _handlers.find(fd);
+    return slot && slot->throttled;
+  }
+
+  /// Called with the fd when its peer hangs up, before the fd is removed.
+  /// The fd is not closed; closing it is up to its owner.
+  void on_hangup(hangup_fun f) { _on_hangup = std::move(f); }
+
 private:
+  /// An fd's remaining budget while its class is being served.
+  struct turn {
+    ready_event<T> ev;
+    uint32_t messages;
+    uint64_t bytes;
+  };
+
+  /// Serve one priority class: every ready fd once, then further rounds over
+  /// the fds that still have input and budget.
+  void dispatch_class(const std::vector<ready_event<T>> &ready,
+                      reactor_stats &stats) {
+    _turns.clear();
+    for (const auto &ev : ready) {
+      auto *slot = _handlers.find(ev.fd);
+      auto budget = slot ? slot->budget : dispatch_budget{};
+      _turns.push_back({ev, budget.messages, budget.bytes});
+    }
+
+    while (!_turns.empty()) {
+      std::size_t kept = 0;
+      for (auto t : _turns) {
+        if (t.ev.is(ready_flags::READABLE) && serve(t, stats)) {
+          _turns[kept++] = t;
+          continue;
+        }
+
+        // drain what the peer sent before reporting the hangup; input left
+        // over budget keeps the fd ready for the next listen()
+        if (t.ev.is(ready_flags::HANGUP) && this->pending_bytes(t.ev.fd) <= 0)
+          hangup(t.ev.fd);
+      }
+      _turns.resize(kept);
+    }
+  }
+
+  /// Dispatch one message of t.
+  /// \return true if t should get another round
+  bool serve(turn &t, reactor_stats &stats) {
+    auto fd = t.ev.fd;
+    auto *slot = _handlers.find(fd);
+    auto bucket = slot ? slot->bucket : nullptr;
+    if (bucket && !bucket->ready(steady_ns())) {
+      throttle(fd, *bucket, stats);
+      return false;
+    }
+
+    bool metered = t.bytes != 0;
+    bool measured = metered || (bucket && bucket->limits_bytes());
+    auto before = measured ? this->pending_bytes(fd) : 0;
+
+    if (!dispatch(fd, stats))
+      return false;
+
+    --t.messages;
+    auto after = measured ? this->pending_bytes(fd) : 0;
+    auto used = static_cast<uint64_t>(before > after ? before - after : 0);
+    if (bucket) {
+      auto now = steady_ns();
+      bucket->take(1, used, now);
+      if (!bucket->ready(now)) {
+        throttle(fd, *bucket, stats);
+        return false;
+      }
+    }
+    if (metered) {
+      t.bytes = used >= t.bytes ? 0 : t.bytes - used;
+      if (t.bytes == 0 || after <= 0)
+        return false;
+    }
+
+    return t.messages > 0 && (metered || this->pending_bytes(fd) > 0);
+  }
+
+  /// \return false if fd has no handler after dispatching
+  bool dispatch(T fd, reactor_stats &stats) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !slot->bound || slot->input_held())
+      return false;
+
+    // the handler may remove or rebind its own fd; keep the running closure
+    // alive outside the table until it returns
+    auto handler = std::move(slot->handler);
+    auto message = std::move(slot->message);
+    slot->dispatching = true;
+
+    auto start = std::chrono::steady_clock::now();
+    Trace::record(trace_kind::handler_begin, fd);
+    handler.second(fd, message);
+    Trace::record(trace_kind::handler_end, fd);
+    stats.handler_ns.record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    stats.dispatched.add();
+
+    // the table may have grown while the handler ran
+    slot = _handlers.find(fd);
+    if (slot && slot->dispatching) {
+      slot->handler = std::move(handler);
+      slot->message = std::move(message);
+      slot->dispatching = false;
+    }
+    return slot && slot->bound;
+  }
+
+  void dispatch_writable(T fd) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !slot->on_writable)
+      return;
+
+    // the callback may unwatch or remove its own fd
+    auto f = slot->on_writable;
+    f(fd);
+  }
+
+  /// \pre fd has no input left
+  void hangup(T fd) {
+    auto *slot = _handlers.find(fd);
+    // a throttled fd has nothing left to limit
+    if (!slot || !slot->linked || slot->paused)
+      return;
+
+    if (_on_hangup)
+      _on_hangup(fd);
+    remove(fd);
+  }
+
+  void run_posted() {
+    this->clear_notifier(_notify_fd);
+    // synchronizes with the producers that saw no wakeup pending, so their
+    // tasks are visible to the pops below
+    _wake_pending.exchange(false, std::memory_order_acq_rel);
+
+    task_type task;
+    while (_posted.pop(task))
+      task();
+
+    // a producer is mid-push; come back on the next listen()
+    if (!_posted.idle() &&
+        !_wake_pending.exchange(true, std::memory_order_acq_rel))
+      this->notify(_notify_fd);
+  }
+
+  /// Watch fd for what its slot wants. An fd that wants nothing leaves the
+  /// muxer: epoll reports hangups and errors whatever the interest, and a
+  /// held fd could not act on them, so they would wake every wait.
+  bool update_interest(
+      T fd, typename handler_table<T, std::string, Handler>::slot &slot) {
+    bool writable = static_cast<bool>(slot.on_writable);
+    if (slot.input_held() && !writable) {
+      if (!slot.detached && !this->unlink_node(_listener_fd, fd))
+        return false;
+      slot.detached = true;
+      return true;
+    }
+
+    if (slot.detached) {
+      if (!this->link_node(_listener_fd, fd))
+        return false;
+      slot.detached = false;
+    }
+    return this->modify_node(_listener_fd, fd, !slot.input_held(), writable);
+  }
+
+  /// Hold input of fd until bucket is ready again.
+  void throttle(T fd, token_bucket &bucket, reactor_stats &stats) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !slot->linked || slot->throttled)
+      return;
+
+    auto now = steady_ns();
+    slot->throttled = true;
+    slot->throttled_ns = now;
+    update_interest(fd, *slot);
+    slot->resume_timer =
+        run_after(std::chrono::nanoseconds(bucket.wait_ns(now)),
+                  [this, fd] { unthrottle(fd); });
+
+    stats.throttles.add();
+    if (auto *fs = stats.fd(fd))
+      fs->throttles.add();
+  }
+
+  void unthrottle(T fd) {
+    auto *slot = _handlers.find(fd);
+    if (!slot || !slot->throttled)
+      return;
+
+    slot->throttled = false;
+    update_interest(fd, *slot);
+
+    auto &stats = *_stats.get();
+    auto held = steady_ns() - slot->throttled_ns;
+    stats.throttled_ns.add(held);
+    if (auto *fs = stats.fd(fd))
+      fs->throttled_ns.add(held);
+  }
+
+  static uint64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /// Arm the timer descriptor for the earliest deadline, if it changed.
+  void arm_timers() {
+    auto earliest = _timers.empty() ? 0 : _timers.begin()->first.first;
+    if (earliest != _armed_ns) {
+      this->arm_timer(_timer_fd, earliest);
+      _armed_ns = earliest;
+    }
+  }
+
+  void run_timers() {
+    this->clear_timer(_timer_fd);
+    _armed_ns = 0;
+
+    auto now = steady_ns();
+    while (!_timers.empty() && _timers.begin()->first.first <= now) {
+      auto it = _timers.begin();
+      auto task = std::move(it->second);
+      _timer_deadlines.erase(it->first.second);
+      _timers.erase(it);
+      task();
+    }
+    arm_timers();
+  }
+
   T _listener_fd; // fd for listener/acceptor
-  std::set<T> _active_socket_list;
-  event_map<T, std::string> _event_handlers;
+  T _notify_fd;   // wakes listen() for posted tasks
+  T _timer_fd;    // wakes listen() for the earliest timer
+  handler_table<T, std::string, Handler> _handlers;
+  std::vector<ready_event<T>> _batch[3]; // ready fds by priority class
+  std::vector<turn> _turns;
+  std::vector<T> _writable; // fds ready for output this wakeup
+  hangup_fun _on_hangup;
+  stats_segment _stats;
+  mpsc_queue<task_type> _posted;
+  std::atomic<bool> _wake_pending{false};
+  // (deadline on the steady clock in ns, id) -> task, earliest first
+  std::map<std::pair<uint64_t, timer_id>, task_type> _timers;
+  std::unordered_map<timer_id, uint64_t> _timer_deadlines;
+  timer_id _next_timer{1};
+  uint64_t _armed_ns{0}; // deadline the timer descriptor is set to, 0 if none
 };
 
 /// epoll() based event muxer
@@ -81,7 +698,7 @@ private:
 template <typename T, EnableIfPlatform<posix> = true> struct epoll_muxer {
   using event_type = epoll_event;
   static constexpr int event_max = 10; // max events to fetch at a time
-  using event_list = std::vector<T>;
+  using event_list = std::vector<ready_event<T>>;
 
   /// creates a new epoll instance and adds handle to interest list
   /// to trigger notification on any input data received on the handle.
@@ -89,42 +706,267 @@ template <typename T, EnableIfPlatform<posix> = true> struct epoll_muxer {
   /// \return file descriptor for primary listening (epoll) socket
   static T init() { return epoll_create(event_max); }
 
+  static void close_node(T fd) { close(fd); }
+
+  /// \return an eventfd for waking wait() from other threads
+  static T make_notifier() { return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC); }
+
+  static void notify(T nfd) {
+    uint64_t one = 1;
+    ssize_t rc = write(nfd, &one, sizeof(one));
+    (void)rc; // EAGAIN only when the counter is saturated, already readable
+  }
+
+  static void clear_notifier(T nfd) {
+    uint64_t count;
+    ssize_t rc = read(nfd, &count, sizeof(count));
+    (void)rc;
+  }
+
+  /// \return a timerfd on the monotonic clock, the one steady_clock reads
+  static T make_timer() {
+    return timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  }
+
+  /// Make tfd readable at deadline_ns on the monotonic clock; 0 disarms it.
+  static void arm_timer(T tfd, uint64_t deadline_ns) {
+    struct itimerspec spec {};
+    spec.it_value.tv_sec = static_cast<time_t>(deadline_ns / 1000000000);
+    spec.it_value.tv_nsec = static_cast<long>(deadline_ns % 1000000000);
+    timerfd_settime(tfd, TFD_TIMER_ABSTIME, &spec, nullptr);
+  }
+
+  static void clear_timer(T tfd) {
+    uint64_t expirations;
+    ssize_t rc = read(tfd, &expirations, sizeof(expirations));
+    (void)rc; // EAGAIN if it was re-armed since it fired
+  }
+
+  /// Watch sfd for input and for the peer shutting down its write side.
   static bool link_node(T poll_fd, T sfd) {
     struct epoll_event ev;
     ev.data.fd = sfd;
-    ev.events = EPOLLIN;
+    ev.events = EPOLLIN | EPOLLRDHUP;
 
     int result = epoll_ctl(poll_fd, EPOLL_CTL_ADD, sfd, &ev);
 
     return result == 0 ? true : false;
   }
 
+  /// Set interest in sfd having input (and its peer shutting down) and in
+  /// sfd accepting output.
+  static bool modify_node(T poll_fd, T sfd, bool readable, bool writable) {
+    struct epoll_event ev;
+    ev.data.fd = sfd;
+    ev.events = readable ? EPOLLIN | EPOLLRDHUP : 0;
+    if (writable)
+      ev.events |= EPOLLOUT;
+    return epoll_ctl(poll_fd, EPOLL_CTL_MOD, sfd, &ev) == 0;
+  }
+
+  /// \return bytes queued for reading on sfd, -1 on error
+  static long pending_bytes(T sfd) {
+    int n = 0;
+    return ioctl(sfd, FIONREAD, &n) == 0 ? n : -1;
+  }
+
+  static bool unlink_node(T poll_fd, T sfd) {
+    // non-null event for kernels before 2.6.9
+    struct epoll_event ev {};
+    return epoll_ctl(poll_fd, EPOLL_CTL_DEL, sfd, &ev) == 0;
+  }
+
   /// Listen for changes to any descriptors held in evlist.
-  /// return number of ready file descriptors
   ///
-  /// \return 0 (success), -1 (error), n (number of fds ready)
+  /// \return ready descriptors, empty on error (see errno)
   static event_list wait(T poll_fd) {
     struct epoll_event events[event_max];
     event_list ev_list;
     auto nr_events = epoll_wait(poll_fd, events, event_max, -1);
 
-    /// \todo on close events remove ev.data.fd from event delegates map and
-    /// move associated handler to another socket.
-    for (auto ev : events) {
-      if (ev_list.size() >= nr_events) {
-        return ev_list;
-      }
-      if (ev.data.fd > 0) {
-        ev_list.push_back(ev.data.fd);
-      }
+    for (int i = 0; i < nr_events; ++i) {
+      ev_list.push_back({static_cast<T>(events[i].data.fd),
+                         translate(events[i].events)});
+    }
+
+    return ev_list;
+  }
+
+  static ready_flags translate(uint32_t events) {
+    auto flags = ready_flags::NONE;
+    if (events & EPOLLIN)
+      flags |= ready_flags::READABLE;
+    if (events & EPOLLOUT)
+      flags |= ready_flags::WRITABLE;
+    if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+      flags |= ready_flags::HANGUP;
+    return flags;
+  }
+};
+
+/// Tuning of a busy_poll_muxer.
+struct busy_poll_config {
+  /// longest time wait() polls without blocking; the spin adapts between
+  /// min_spin and this depending on how often spinning finds events
+  std::chrono::nanoseconds max_spin{std::chrono::microseconds{50}};
+  std::chrono::nanoseconds min_spin{0};
+
+  /// SO_BUSY_POLL in microseconds set on every linked socket, 0 to leave it
+  /// off. Lets the kernel poll the device queue on receive; values above
+  /// net.core.busy_read need CAP_NET_ADMIN.
+  int socket_busy_poll_us{0};
+};
+
+/// Counters of a busy_poll_muxer, readable from any thread.
+struct busy_poll_stats {
+  stat_counter polls;          // zero-timeout epoll_wait calls
+  stat_counter spin_hits;      // waits satisfied while spinning
+  stat_counter blocks;         // waits that fell back to blocking
+  stat_counter spin_ns;        // time spent spinning, found events or not
+  stat_counter useful_ns;      // time between waits, i.e. dispatching
+  stat_counter busy_poll_errors; // sockets refusing SO_BUSY_POLL
+};
+
+/// epoll_muxer that spins before sleeping.
+///
+/// wait() polls with a zero timeout for up to the current spin budget and
+/// only then blocks, trading CPU for the scheduler wakeup a blocking wait
+/// pays on every message. The budget doubles when spinning (or a short
+/// block) finds events and halves when it comes up empty, so an idle
+/// reactor settles into plain blocking waits.
+/// Stateful, configure it through io_mux_base::muxer().
+template <typename T> class busy_poll_muxer : public epoll_muxer<T> {
+  using clock = std::chrono::steady_clock;
+
+public:
+  using event_list = typename epoll_muxer<T>::event_list;
+
+  void configure(busy_poll_config config) {
+    _config = config;
+    _budget = config.max_spin;
+  }
+
+  const busy_poll_config &config() const { return _config; }
+
+  /// Current spin budget.
+  std::chrono::nanoseconds budget() const { return _budget; }
+
+  const busy_poll_stats &stats() const { return _stats; }
+
+  bool link_node(T poll_fd, T sfd) {
+    if (!epoll_muxer<T>::link_node(poll_fd, sfd))
+      return false;
+
+    if (_config.socket_busy_poll_us > 0 &&
+        setsockopt(sfd, SOL_SOCKET, SO_BUSY_POLL,
+                   &_config.socket_busy_poll_us,
+                   sizeof(_config.socket_busy_poll_us)) == -1)
+      _stats.busy_poll_errors.add();
+    return true;
+  }
+
+  event_list wait(T poll_fd) {
+    struct epoll_event events[epoll_muxer<T>::event_max];
+    auto start = clock::now();
+    if (_returned != clock::time_point{})
+      _stats.useful_ns.add(ns(start - _returned));
+
+    int n = 0;
+    auto deadline = start + _budget;
+    if (_budget.count() > 0) {
+      do {
+        n = epoll_wait(poll_fd, events, epoll_muxer<T>::event_max, 0);
+        _stats.polls.add();
+      } while (n == 0 && clock::now() < deadline);
+    }
+
+    auto spun = clock::now();
+    _stats.spin_ns.add(ns(spun - start));
+
+    if (n > 0) {
+      _stats.spin_hits.add();
+      grow();
+    } else {
+      _stats.blocks.add();
+      n = epoll_wait(poll_fd, events, epoll_muxer<T>::event_max, -1);
+      // events that arrived within the spin ceiling would have been caught
+      // by a longer spin
+      if (clock::now() - spun <= _config.max_spin)
+        grow();
+      else
+        shrink();
     }
 
+    event_list ev_list;
+    for (int i = 0; i < n; ++i)
+      ev_list.push_back({static_cast<T>(events[i].data.fd),
+                         epoll_muxer<T>::translate(events[i].events)});
+
+    _returned = clock::now();
     return ev_list;
   }
+
+private:
+  static uint64_t ns(clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  }
+
+  void grow() {
+    auto next = _budget.count() ? _budget * 2 : std::chrono::nanoseconds{1000};
+    _budget = next < _config.max_spin ? next : _config.max_spin;
+  }
+
+  void shrink() {
+    auto next = _budget / 2;
+    _budget = next > _config.min_spin ? next : _config.min_spin;
+  }
+
+  busy_poll_config _config;
+  std::chrono::nanoseconds _budget{_config.max_spin};
+  clock::time_point _returned;
+  busy_poll_stats _stats;
+};
+
+template <typename T, typename Muxer = epoll_muxer<T>,
+          typename Trace = null_trace>
+auto make_muxer() {
+  return std::make_unique<io_mux_base<T, Muxer, Trace>>();
+}
+
+/// io_mux_base whose handlers are a compile-time handler_set.
+///
+/// Descriptors are bound to a handler by index, and dispatch goes through
+/// the set's switch instead of a type-erased std::function, letting the
+/// compiler inline each handler into the dispatch loop.
+/// Handlers are invoked as handler(fd, const std::string &message).
+template <typename T, typename Muxer, typename Trace, typename... Handlers>
+class static_io_mux
+    : public io_mux_base<T, Muxer, Trace,
+                         static_handler<handler_set<Handlers...>>> {
+public:
+  using set_type = handler_set<Handlers...>;
+
+  explicit static_io_mux(Handlers... handlers)
+      : _set{std::move(handlers)...} {}
+
+  /// Bind fd to the handler at index I of the set.
+  template <std::size_t I> void bind_handler(T fd, std::string label = {}) {
+    static_assert(I < set_type::size, "no handler at this index");
+    this->bind_event(fd, labeled_handler<std::string, static_handler<set_type>>{
+                             std::move(label), {&_set, I}});
+  }
+
+  set_type &handlers() { return _set; }
+
+private:
+  set_type _set;
 };
 
-template <typename T, typename Muxer = epoll_muxer<T>> auto make_muxer() {
-  return std::make_unique<io_mux_base<T, Muxer>>();
+template <typename T, typename Muxer = epoll_muxer<T>,
+          typename Trace = null_trace, typename... Handlers>
+auto make_static_muxer(Handlers... handlers) {
+  return std::make_unique<static_io_mux<T, Muxer, Trace, Handlers...>>(
+      std::move(handlers)...);
 }
 
 } // end namespace ip
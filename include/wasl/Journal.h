@@ -0,0 +1,203 @@
+#ifndef WASL_JOURNAL_H
+#define WASL_JOURNAL_H
+
+#include <wasl/Common.h>
+#include <wasl/Types.h>
+
+#include <gsl/span>
+#include <gsl/string_span> // czstring
+
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wasl {
+namespace ip {
+
+/// CRC32C (Castagnoli) of len bytes, continuing from crc: pass the result of
+/// a previous call to checksum data in pieces. Uses the SSE4.2 crc32
+/// instruction when the CPU has it.
+uint32_t crc32c(const void *data, std::size_t len, uint32_t crc = 0) noexcept;
+
+/// Table-driven CRC32C, what crc32c() falls back to without SSE4.2.
+uint32_t crc32c_portable(const void *data, std::size_t len,
+                         uint32_t crc = 0) noexcept;
+
+/// Whether crc32c() runs on the crc32 instruction on this CPU.
+bool crc32c_accelerated() noexcept;
+
+/// Header of a journaled message, followed by length payload bytes and
+/// padding to the next 8-byte boundary. This is the layout on disk and, as
+/// journal::send() streams segments verbatim, on the wire. Host byte order.
+struct journal_record {
+  uint64_t offset;  // position in the topic, counting messages from 0
+  uint64_t time_ns; // wall clock time of the append
+  uint32_t length;
+  uint32_t crc; // crc32c() of the fields above, then the payload
+};
+static_assert(sizeof(journal_record) == 24, "journal_record layout changed");
+
+/// Bytes a record of len payload bytes takes, header and padding included.
+constexpr std::size_t journal_record_span(std::size_t len) {
+  return (sizeof(journal_record) + len + 7) & ~std::size_t{7};
+}
+
+/// Check the crc of rec, whose payload follows it.
+bool journal_verify(const journal_record &rec) noexcept;
+
+struct journal_options {
+  /// Size of each segment file, and so the largest record.
+  std::size_t segment_bytes{std::size_t{64} << 20};
+  /// Drop the oldest segments once all of them hold more bytes; 0 keeps all.
+  /// Checked as segments start, so the newest one may come on top.
+  std::size_t retain_bytes{0};
+  /// Drop segments whose newest record is older than this; 0 keeps all.
+  uint64_t retain_ns{0};
+};
+
+/// Read position of a subscriber catching up, see journal::cursor().
+struct journal_cursor {
+  uint64_t segment{0};     // base offset of the segment being sent
+  std::size_t position{0}; // bytes of it sent so far
+  bool partial{false};     // stopped within a record
+};
+
+/// Durable, append-only message log of one topic, so that subscribers
+/// joining late or restarting can catch up from an offset before switching
+/// to live delivery.
+///
+/// Messages go into memory-mapped segment files named after the offset of
+/// their first record; appending is a memcpy into the mapping. Once full, a
+/// segment is sealed and a new one started, and retention drops whole
+/// segments, oldest first. Reopening a journal recovers its segments and
+/// discards records after the first torn or corrupt one.
+///
+/// Catch-up streams the segment files with sendfile(), without copying
+/// through user space. Not thread-safe: append and catch up from the
+/// reactor thread.
+class journal {
+public:
+  /// Called once a subscriber caught up, with error 0, or failed, with its
+  /// errno.
+  using done_fn = std::function<void(SOCKET, int error)>;
+
+  /// Open the journal in directory dir, creating it if needed.
+  /// Check the result with operator bool and errno on failure.
+  explicit journal(std::string dir, journal_options options = {});
+  ~journal();
+
+  WASL_NO_COPY(journal);
+
+  explicit operator bool() const { return _open; }
+
+  /// Append payload as the next record.
+  /// \param time_ns time of the record, 0 for now
+  /// \return its offset, or -1 on error (see errno; EMSGSIZE if it cannot
+  /// fit a segment)
+  int64_t append(gsl::span<const char> payload, uint64_t time_ns = 0);
+
+  /// Offset of the oldest retained record.
+  uint64_t first_offset() const;
+
+  /// Offset the next append will get.
+  uint64_t next_offset() const { return _next; }
+
+  /// The record at offset as on the wire, header included; empty if it is
+  /// not retained or not written yet. Valid until its segment is dropped.
+  gsl::span<const char> record(uint64_t offset) const;
+
+  /// Cursor to send the journal from offset on, or from first_offset() if
+  /// offset was dropped already.
+  journal_cursor cursor(uint64_t offset) const;
+
+  /// Stream records at cur through sd, advancing cur, until sd would block,
+  /// max bytes were sent or cur caught up. Records are sent verbatim, so a
+  /// send may end within one. If the segment of cur was dropped meanwhile,
+  /// sending resumes at first_offset(); receivers see the jump in offsets.
+  /// Unless the last send ended within a record of it: the rest of that
+  /// record is lost, and the receiver could not find the next header.
+  /// \return bytes sent, or -1 on error (see errno; ENODATA if a partly
+  /// sent record was dropped, close sd then)
+  ssize_t send(SOCKET sd, journal_cursor &cur,
+               std::size_t max = static_cast<std::size_t>(-1));
+
+  /// Whether cur reached the end of the journal.
+  bool caught_up(const journal_cursor &cur) const;
+
+  /// Catch sd up from offset as mux finds it writable, then call done.
+  /// Appends while catching up are streamed too; once done reports 0,
+  /// deliver new records live, e.g. record() bytes through a
+  /// subscriber_queue.
+  /// \pre sd was added to mux and is non-blocking
+  template <typename Mux>
+  bool catch_up(Mux &mux, SOCKET sd, uint64_t offset, done_fn done) {
+    auto cur = std::make_shared<journal_cursor>(cursor(offset));
+    return mux.watch_writable(sd, [this, &mux, cur, done](SOCKET fd) {
+      for (;;) {
+        auto n = send(fd, *cur);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+          return;
+
+        if (n < 0 || caught_up(*cur)) {
+          auto error = n < 0 ? errno : 0;
+          mux.unwatch_writable(fd);
+          if (done)
+            done(fd, error);
+          return;
+        }
+        if (n == 0)
+          return;
+      }
+    });
+  }
+
+  /// Apply the retention limits as of now_ns, 0 for now. Runs on every new
+  /// segment too. The segment being appended to is never dropped.
+  /// \return segments dropped
+  std::size_t retain(uint64_t now_ns = 0);
+
+  std::size_t segments() const { return _segments.size(); }
+
+  /// Bytes held by all segments.
+  std::size_t size() const;
+
+  const std::string &dir() const { return _dir; }
+
+private:
+  struct segment;
+
+  segment *find(uint64_t offset) const;
+  bool recover();
+  bool roll();
+
+  std::string _dir;
+  journal_options _options;
+  std::vector<std::unique_ptr<segment>> _segments; // oldest first
+  uint64_t _next{0};
+  bool _open{false};
+};
+
+/// Journals of several topics under one root directory, one subdirectory
+/// per topic, opened on first use.
+class journal_store {
+public:
+  explicit journal_store(std::string root, journal_options options = {});
+
+  /// The journal of topic, nullptr if it cannot be opened (see errno;
+  /// EINVAL for names that are not a plain directory name).
+  journal *topic(gsl::czstring<> name);
+
+private:
+  std::string _root;
+  journal_options _options;
+  std::map<std::string, std::unique_ptr<journal>> _topics;
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_JOURNAL_H */
@@ -0,0 +1,136 @@
+#ifndef WASL_LINEFRAMER_H
+#define WASL_LINEFRAMER_H
+
+#include <wasl/SockStream.h>
+
+#include <gsl/string_span> // cstring_span
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+namespace wasl {
+namespace ip {
+
+/// First delim in [first, last), or last if there is none.
+/// Scans 32 bytes at a time with AVX2, or 16 with SSE2, as the CPU allows.
+const char *find_delimiter(const char *first, const char *last,
+                           char delim) noexcept;
+
+/// Byte-by-byte find_delimiter(), what it falls back to without SIMD.
+const char *find_delimiter_portable(const char *first, const char *last,
+                                    char delim) noexcept;
+
+/// Instruction set find_delimiter() uses on this CPU: "avx2", "sse2" or
+/// "scalar".
+const char *find_delimiter_isa() noexcept;
+
+/// Splits a byte stream into delimiter-terminated records, e.g. the lines
+/// legacy producers write with `ss << msg << std::endl`.
+///
+/// Unlike std::getline() over a sockbuf, which goes through underflow() a
+/// character at a time, data is received in large reads and scanned with
+/// find_delimiter(). Records are views straight into the receive buffer,
+/// without their delimiter, and stay valid until the next fill(). The
+/// buffer is compacted as it fills, so a record may be as long as its
+/// capacity. Does not own the socket.
+///
+/// \tparam SockIO socket I/O policy, e.g. basic_sockio
+/// \tparam Trace tracing policy, null_trace compiles away
+template <typename SockIO = basic_sockio<platform_type>,
+          typename Trace = null_trace>
+class line_framer {
+public:
+  explicit line_framer(SOCKET sd, char delim = '\n',
+                       std::size_t capacity = 64 * 1024)
+      : _sd{sd}, _delim{delim}, _buf(capacity) {}
+
+  /// Take the next complete record buffered, if any.
+  bool next(gsl::cstring_span<> &record) {
+    auto *first = _buf.data() + _begin;
+    auto *last = _buf.data() + _end;
+    auto *found = find_delimiter(_buf.data() + _scan, last, _delim);
+    if (found == last) {
+      _scan = _end; // resume after what was scanned
+      return false;
+    }
+
+    record = {first, found};
+    _begin = _scan = static_cast<std::size_t>(found + 1 - _buf.data());
+    return true;
+  }
+
+  /// Receive more of the stream, moving the incomplete record to the front
+  /// of the buffer first. Invalidates records taken so far.
+  /// \return bytes received, 0 at the end of the stream, or -1 on error
+  /// (see errno; EMSGSIZE if a record does not fit the buffer)
+  ssize_t fill(int flags = 0) {
+    if (_begin > 0) {
+      memmove(_buf.data(), _buf.data() + _begin, _end - _begin);
+      _end -= _begin;
+      _scan -= _begin;
+      _begin = 0;
+    }
+    if (_end == _buf.size()) {
+      errno = EMSGSIZE;
+      return -1;
+    }
+
+    auto n = SockIO::rv_recv_msg(_sd, _buf.data() + _end, _buf.size() - _end,
+                                 flags);
+    if (n > 0) {
+      Trace::record(trace_kind::bytes_received, _sd, n);
+      _end += n;
+    }
+    return n;
+  }
+
+  /// Take the next record, receiving until one is complete.
+  /// \return false at the end of the stream or on error (errno is 0 at the
+  /// end; see remainder() for a trailing incomplete record)
+  bool read(gsl::cstring_span<> &record, int flags = 0) {
+    while (!next(record)) {
+      auto n = fill(flags);
+      if (n <= 0) {
+        if (n == 0)
+          errno = 0;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Call fn(gsl::cstring_span<>) for every complete record buffered.
+  /// \return records passed to fn
+  template <typename Fn> std::size_t drain(Fn &&fn) {
+    std::size_t count = 0;
+    gsl::cstring_span<> record;
+    while (next(record)) {
+      fn(record);
+      ++count;
+    }
+    return count;
+  }
+
+  /// The bytes after the last complete record.
+  gsl::cstring_span<> remainder() const {
+    return {_buf.data() + _begin, _buf.data() + _end};
+  }
+
+  std::size_t capacity() const { return _buf.size(); }
+
+  friend SOCKET sockno(const line_framer &f) { return f._sd; }
+
+private:
+  SOCKET _sd;
+  char _delim;
+  std::vector<char> _buf;
+  std::size_t _begin{0}; // first byte not yet taken
+  std::size_t _scan{0};  // first byte not yet scanned for _delim
+  std::size_t _end{0};   // end of the received bytes
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_LINEFRAMER_H */
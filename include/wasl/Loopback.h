@@ -0,0 +1,245 @@
+#ifndef WASL_LOOPBACK_H
+#define WASL_LOOPBACK_H
+
+#include <wasl/Common.h>
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Peer.h>
+#include <wasl/Types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace wasl {
+namespace ip {
+
+/// Most loopback descriptors open at once.
+constexpr std::size_t loopback_max_descriptors = 4096;
+
+/// Bytes each direction of a pair holds by default.
+constexpr std::size_t loopback_default_capacity = 64 * 1024;
+
+/// Readiness bits of loopback_poll_wait(), see loopback_muxer::translate().
+constexpr uint32_t LOOPBACK_IN = 0x1;  // input, or the end of it, to read
+constexpr uint32_t LOOPBACK_OUT = 0x2; // room to send
+constexpr uint32_t LOOPBACK_HUP = 0x4; // the peer shut down its sending side
+
+/// In-process transport: connected endpoint pairs, readiness polls,
+/// notifiers and timers that never enter the kernel.
+///
+/// Loopback descriptors are small integers from a registry of their own,
+/// so they only mean something to loopback functions: a reactor built on
+/// loopback_muxer serves loopback descriptors only, and code templated on
+/// a SockIO policy reads and writes them through loopback_sockio. This lets
+/// a whole stack of handlers, framers and routers run, be tested and be
+/// measured without syscall noise, and serves as a fast channel between
+/// threads of one process.
+///
+/// Each direction of a pair is a lock-free single-producer single-consumer
+/// ring: one thread may send and one receive on it at a time. Blocking
+/// calls and polls only sleep, on a condition variable, when there is
+/// nothing to do.
+///
+/// Create a connected pair of endpoints, like socketpair(2).
+/// \param type SOCK_STREAM, or SOCK_SEQPACKET to keep message boundaries;
+/// or'ed with SOCK_NONBLOCK for non-blocking endpoints
+/// \param capacity bytes each direction holds, rounded up to a power of
+/// two; it bounds the size of a message
+/// \return 0, or -1 (see errno)
+int loopback_pair(int type, SOCKET sv[2],
+                  std::size_t capacity = loopback_default_capacity);
+
+/// Close any loopback descriptor. The peer of an endpoint reads the end of
+/// its input once it drained it, and fails to send with EPIPE.
+/// \return 0, or -1 with EBADF
+int loopback_close(SOCKET sd);
+
+/// Shut down reading, sending or both of an endpoint, like shutdown(2).
+int loopback_shutdown(SOCKET sd, int how);
+
+/// Switch an endpoint between blocking and non-blocking calls.
+int loopback_set_nonblocking(SOCKET sd, bool nonblocking);
+
+/// Stamp messages sent to sd with the wall clock time, for
+/// loopback_recv_stamped(), like socket_builder::timestamps().
+/// \pre SOCK_SEQPACKET endpoint
+int loopback_set_timestamps(SOCKET sd, bool stamped);
+
+/// Send the iovcnt buffers of iov, as one message on SOCK_SEQPACKET.
+/// Honours MSG_DONTWAIT; MSG_NOSIGNAL and MSG_MORE have no effect, no
+/// signal is ever raised.
+/// \return bytes sent, or -1 (see errno)
+ssize_t loopback_sendv(SOCKET sd, const struct iovec *iov, int iovcnt,
+                       int flags = 0);
+
+/// Receive up to len bytes, or the next message, truncated to len.
+/// Honours MSG_DONTWAIT, MSG_PEEK and, on SOCK_SEQPACKET, MSG_TRUNC.
+/// \return bytes received, 0 at the end of input, or -1 (see errno)
+ssize_t loopback_recv(SOCKET sd, void *buf, std::size_t len, int flags = 0);
+
+/// loopback_recv() with the time the message was sent.
+/// \param[out] arrival_ns wall clock time, 0 unless stamped
+ssize_t loopback_recv_stamped(SOCKET sd, void *buf, std::size_t len,
+                              uint64_t &arrival_ns, int flags = 0);
+
+/// Bytes queued for reading on sd, message headers included, or -1.
+long loopback_pending(SOCKET sd);
+
+/// \return a new poll, or -1 (see errno)
+SOCKET loopback_poll_create();
+
+/// Add sd to poll, or set what it is watched for if it was added.
+/// \return false if either is not open, or sd belongs to another poll
+bool loopback_poll_link(SOCKET poll, SOCKET sd, bool readable, bool writable);
+
+bool loopback_poll_unlink(SOCKET poll, SOCKET sd);
+
+/// A readiness event of loopback_poll_wait().
+struct loopback_event {
+  SOCKET sd;
+  uint32_t events; // LOOPBACK_IN, LOOPBACK_OUT and LOOPBACK_HUP
+};
+
+/// Wait until descriptors of poll are ready and fill up to max events,
+/// level-triggered. Descriptors are scanned round-robin, so that a few busy
+/// ones cannot starve the rest.
+/// \return events filled, or -1 (see errno)
+int loopback_poll_wait(SOCKET poll, loopback_event *events, int max);
+
+/// A descriptor that is readable from notify until cleared, like an
+/// eventfd. notify is safe to call from any thread.
+SOCKET loopback_notifier_create();
+void loopback_notify(SOCKET nd);
+void loopback_notifier_clear(SOCKET nd);
+
+/// A descriptor that is readable from a deadline on the steady clock on,
+/// like a timerfd.
+SOCKET loopback_timer_create();
+
+/// Make td readable at deadline_ns on the steady clock; 0 disarms it.
+void loopback_timer_arm(SOCKET td, uint64_t deadline_ns);
+
+/// Disarm td if its deadline passed.
+void loopback_timer_clear(SOCKET td);
+
+/// Muxer policy of io_mux_base over loopback descriptors.
+/// \note all static members for EBCO, like epoll_muxer
+template <typename T> struct loopback_muxer {
+  static constexpr int event_max = 10; // max events to fetch at a time
+  using event_list = std::vector<ready_event<T>>;
+
+  static T init() { return loopback_poll_create(); }
+
+  static void close_node(T fd) { loopback_close(fd); }
+
+  static T make_notifier() { return loopback_notifier_create(); }
+  static void notify(T nfd) { loopback_notify(nfd); }
+  static void clear_notifier(T nfd) { loopback_notifier_clear(nfd); }
+
+  static T make_timer() { return loopback_timer_create(); }
+  static void arm_timer(T tfd, uint64_t deadline_ns) {
+    loopback_timer_arm(tfd, deadline_ns);
+  }
+  static void clear_timer(T tfd) { loopback_timer_clear(tfd); }
+
+  /// Watch sfd for input and for the peer shutting down its sending side.
+  static bool link_node(T poll_fd, T sfd) {
+    return loopback_poll_link(poll_fd, sfd, true, false);
+  }
+
+  static bool modify_node(T poll_fd, T sfd, bool readable, bool writable) {
+    return loopback_poll_link(poll_fd, sfd, readable, writable);
+  }
+
+  static long pending_bytes(T sfd) { return loopback_pending(sfd); }
+
+  static bool unlink_node(T poll_fd, T sfd) {
+    return loopback_poll_unlink(poll_fd, sfd);
+  }
+
+  /// \return ready descriptors, empty on error (see errno)
+  static event_list wait(T poll_fd) {
+    loopback_event events[event_max];
+    event_list ev_list;
+    auto nr_events = loopback_poll_wait(poll_fd, events, event_max);
+    for (int i = 0; i < nr_events; ++i)
+      ev_list.push_back(
+          {static_cast<T>(events[i].sd), translate(events[i].events)});
+    return ev_list;
+  }
+
+  static ready_flags translate(uint32_t events) {
+    auto flags = ready_flags::NONE;
+    if (events & LOOPBACK_IN)
+      flags |= ready_flags::READABLE;
+    if (events & LOOPBACK_OUT)
+      flags |= ready_flags::WRITABLE;
+    if (events & LOOPBACK_HUP)
+      flags |= ready_flags::HANGUP;
+    return flags;
+  }
+};
+
+/// SockIO policy over loopback endpoints, like basic_sockio.
+/// Endpoints have no addresses: receiving sets none and sending to an
+/// address sends to the peer.
+struct loopback_sockio {
+  static constexpr int BUFLEN = 128;
+  static constexpr int MAXADDRLEN = 256;
+
+  static ssize_t rv_recv(SOCKET sfd, char *buf, int flags = 0) {
+    return loopback_recv(sfd, buf, BUFLEN, flags);
+  }
+
+  static ssize_t rv_recv_from(SOCKET sfd, char *buf, std::size_t len,
+                              peer_address &from, int flags = 0) {
+    from.len = 0;
+    return loopback_recv(sfd, buf, len, flags);
+  }
+
+  /// Size of the next message queued on sfd, without consuming it.
+  static ssize_t rv_next_size(SOCKET sfd, int flags = 0) {
+    return loopback_recv(sfd, nullptr, 0, flags | MSG_PEEK | MSG_TRUNC);
+  }
+
+  static ssize_t rv_recv_stamped(SOCKET sfd, char *buf, std::size_t len,
+                                 uint64_t &arrival_ns,
+                                 peer_address *from = nullptr, int flags = 0) {
+    if (from)
+      from->len = 0;
+    return loopback_recv_stamped(sfd, buf, len, arrival_ns, flags);
+  }
+
+  static ssize_t rv_recv_msg(SOCKET sfd, char *buf, std::size_t len,
+                             int flags = 0) {
+    return loopback_recv(sfd, buf, len, flags);
+  }
+
+  static ssize_t rv_send(SOCKET sfd, char *buf, socklen_t len, int flags = 0) {
+    struct iovec iov {
+      buf, len
+    };
+    return loopback_sendv(sfd, &iov, 1, flags);
+  }
+
+  static ssize_t rv_send_to(SOCKET sfd, const char *buf, std::size_t len,
+                            const peer_address &, int flags = 0) {
+    struct iovec iov {
+      const_cast<char *>(buf), len
+    };
+    return loopback_sendv(sfd, &iov, 1, flags);
+  }
+
+  static ssize_t rv_sendv(SOCKET sfd, const struct iovec *iov, int iovcnt,
+                          int flags = 0) {
+    return loopback_sendv(sfd, iov, iovcnt, flags);
+  }
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_LOOPBACK_H */
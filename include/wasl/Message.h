@@ -0,0 +1,243 @@
+#ifndef WASL_MESSAGE_H
+#define WASL_MESSAGE_H
+
+#include <wasl/Types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
+namespace wasl {
+namespace ip {
+
+/// Header in front of every binary message, in host byte order.
+///
+/// 16 bytes so that a payload following it in an 8-byte aligned receive
+/// buffer is itself 8-byte aligned and can be read in place.
+struct message_header {
+  static constexpr uint16_t magic_value = 0x5757; // "WW"
+  static constexpr uint8_t format_version = 1;
+
+  /// flags bit: the extension starts with the send time, uint64_t wall
+  /// clock ns
+  static constexpr uint8_t flag_send_time = 0x1;
+
+  /// flags bit: the extension ends with a uint64_t correlation id pairing a
+  /// reply with its request
+  static constexpr uint8_t flag_correlation = 0x2;
+
+  /// flags bit: the message replies to the request of its correlation id
+  static constexpr uint8_t flag_reply = 0x4;
+
+  /// flags bit: the reply reports a failure instead of a result
+  static constexpr uint8_t flag_error = 0x8;
+
+  uint16_t magic{magic_value};
+  uint8_t format{format_version};
+  uint8_t flags{0};
+  uint16_t schema_id{0};
+  uint16_t schema_version{0};
+  uint32_t length{0};     // payload bytes
+  uint32_t ext_length{0}; // header extension bytes between header and payload
+
+  bool valid() const {
+    return magic == magic_value && format == format_version &&
+           ext_length % 8 == 0;
+  }
+
+  std::size_t size() const {
+    return sizeof(message_header) + ext_length + length;
+  }
+};
+static_assert(sizeof(message_header) == 16, "message_header layout changed");
+
+/// Schema of a message payload type: its id and layout version.
+/// Specialize with WASL_MESSAGE_SCHEMA.
+///
+/// Payloads are fixed-layout, trivially copyable structs. Evolve a schema by
+/// appending fields and bumping its version: readers zero-fill fields a
+/// shorter, older payload lacks and ignore trailing fields they do not know.
+template <typename T> struct message_schema;
+
+/// Declare T as a message payload with the given id and version.
+/// Use at global scope.
+#define WASL_MESSAGE_SCHEMA(Type, Id, Version)                                 \
+  namespace wasl {                                                             \
+  namespace ip {                                                               \
+  template <> struct message_schema<Type> {                                    \
+    static_assert(std::is_trivially_copyable<Type>::value,                     \
+                  #Type " must be trivially copyable");                        \
+    static constexpr uint16_t id = Id;                                         \
+    static constexpr uint16_t version = Version;                               \
+  };                                                                           \
+  }                                                                            \
+  }
+
+template <typename T> constexpr message_header make_header() {
+  message_header h;
+  h.schema_id = message_schema<T>::id;
+  h.schema_version = message_schema<T>::version;
+  h.length = sizeof(T);
+  return h;
+}
+
+template <typename T> constexpr std::size_t encoded_size() {
+  return sizeof(message_header) + sizeof(T);
+}
+
+/// Size of a message encoded with a send time.
+template <typename T> constexpr std::size_t stamped_size() {
+  return sizeof(message_header) + sizeof(uint64_t) + sizeof(T);
+}
+
+/// Write header and payload of msg to buf.
+/// \pre buf holds at least encoded_size<T>() bytes
+/// \return bytes written
+template <typename T> std::size_t encode(const T &msg, char *buf) {
+  auto header = make_header<T>();
+  memcpy(buf, &header, sizeof(header));
+  memcpy(buf + sizeof(header), &msg, sizeof(T));
+  return encoded_size<T>();
+}
+
+/// Write header, send time and payload of msg to buf.
+/// \pre buf holds at least stamped_size<T>() bytes
+/// \param sent_ns wall clock send time, e.g. realtime_ns()
+/// \return bytes written
+template <typename T>
+std::size_t encode(const T &msg, char *buf, uint64_t sent_ns) {
+  auto header = make_header<T>();
+  header.flags |= message_header::flag_send_time;
+  header.ext_length = sizeof(sent_ns);
+  memcpy(buf, &header, sizeof(header));
+  memcpy(buf + sizeof(header), &sent_ns, sizeof(sent_ns));
+  memcpy(buf + sizeof(header) + sizeof(sent_ns), &msg, sizeof(T));
+  return stamped_size<T>();
+}
+
+/// A received message, read in place from the buffer holding it.
+/// The view does not own the buffer.
+class message_view {
+public:
+  message_view(const char *buf, std::size_t len) : _buf{buf}, _len{len} {
+    if (len >= sizeof(message_header))
+      memcpy(&_header, buf, sizeof(_header));
+  }
+
+  /// true if the buffer holds a complete, well-formed message
+  bool valid() const { return _header.valid() && _len >= _header.size(); }
+
+  const message_header &header() const { return _header; }
+
+  const char *payload() const {
+    return _buf + sizeof(message_header) + _header.ext_length;
+  }
+
+  std::size_t payload_size() const { return _header.length; }
+
+  /// Send time stamped by the sender, 0 if the message carries none.
+  uint64_t send_time() const {
+    uint64_t sent_ns = 0;
+    if (valid() && (_header.flags & message_header::flag_send_time) &&
+        _header.ext_length >= sizeof(sent_ns))
+      memcpy(&sent_ns, _buf + sizeof(message_header), sizeof(sent_ns));
+    return sent_ns;
+  }
+
+  /// Correlation id of a request or reply, 0 if the message carries none.
+  uint64_t correlation() const {
+    uint64_t id = 0;
+    if (valid() && (_header.flags & message_header::flag_correlation) &&
+        _header.ext_length >= sizeof(id))
+      memcpy(&id,
+             _buf + sizeof(message_header) + _header.ext_length - sizeof(id),
+             sizeof(id));
+    return id;
+  }
+
+  template <typename T> bool is() const {
+    return valid() && _header.schema_id == message_schema<T>::id;
+  }
+
+  /// Pointer to the payload in the buffer, without copying.
+  /// \return nullptr unless the message is a T of the reader's version and
+  /// the payload is suitably aligned; use read() in that case.
+  template <typename T> const T *get() const {
+    if (!is<T>() || _header.schema_version != message_schema<T>::version ||
+        _header.length < sizeof(T) ||
+        reinterpret_cast<std::uintptr_t>(payload()) % alignof(T) != 0)
+      return nullptr;
+    return reinterpret_cast<const T *>(payload());
+  }
+
+  /// Copy the payload into out, zero-filling fields an older writer did not
+  /// send. \return false if the message is not a T
+  template <typename T> bool read(T &out) const {
+    if (!is<T>())
+      return false;
+    auto n = _header.length < sizeof(T) ? _header.length : sizeof(T);
+    memset(&out, 0, sizeof(T));
+    memcpy(&out, payload(), n);
+    return true;
+  }
+
+private:
+  const char *_buf;
+  std::size_t _len;
+  message_header _header{};
+};
+
+template <typename T> struct wire_ref {
+  T &msg;
+  uint64_t sent_ns;
+};
+
+/// Wrap msg for binary stream insertion or extraction:
+///   ss << wire(quote) << std::flush;
+///   ss << wire(quote, realtime_ns()) << std::flush; // with send time
+///   ss >> wire(quote);
+template <typename T> wire_ref<T> wire(T &msg, uint64_t sent_ns = 0) {
+  return {msg, sent_ns};
+}
+
+template <typename T>
+std::ostream &operator<<(std::ostream &os, wire_ref<T> w) {
+  auto header = make_header<std::remove_const_t<T>>();
+  if (w.sent_ns) {
+    header.flags |= message_header::flag_send_time;
+    header.ext_length = sizeof(w.sent_ns);
+  }
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (w.sent_ns)
+    os.write(reinterpret_cast<const char *>(&w.sent_ns), sizeof(w.sent_ns));
+  os.write(reinterpret_cast<const char *>(&w.msg), sizeof(T));
+  return os;
+}
+
+/// Sets failbit if the next message on is is not a T.
+template <typename T>
+std::istream &operator>>(std::istream &is, wire_ref<T> w) {
+  message_header header;
+  if (!is.read(reinterpret_cast<char *>(&header), sizeof(header)))
+    return is;
+
+  if (!header.valid() || header.schema_id != message_schema<T>::id) {
+    is.setstate(std::ios::failbit);
+    return is;
+  }
+
+  is.ignore(header.ext_length);
+  auto n = header.length < sizeof(T) ? header.length : sizeof(T);
+  memset(&w.msg, 0, sizeof(T));
+  is.read(reinterpret_cast<char *>(&w.msg), n);
+  is.ignore(header.length - n);
+  return is;
+}
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_MESSAGE_H */
@@ -0,0 +1,311 @@
+#ifndef WASL_METRICS_H
+#define WASL_METRICS_H
+
+#include <wasl/Common.h>
+#include <wasl/Peer.h>
+#include <wasl/Types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gsl/string_span> // czstring
+
+#include <sys/uio.h>
+#include <time.h>
+
+namespace wasl {
+namespace ip {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "stat counters must be lock free to live in shared memory");
+
+/// A counter with a single writer (the reactor thread).
+/// Readers on other threads, or in other processes mapping a
+/// \ref stats_segment, can load it at any time without tearing.
+class stat_counter {
+public:
+  void add(uint64_t n = 1) noexcept {
+    _value.store(_value.load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+  }
+
+  void set(uint64_t n) noexcept { _value.store(n, std::memory_order_relaxed); }
+
+  uint64_t get() const noexcept {
+    return _value.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint64_t> _value{0};
+};
+
+/// Power-of-two histogram. Bucket 0 counts zeros, bucket i counts samples in
+/// [2^(i-1), 2^i). Samples past the last bucket are clamped into it.
+template <std::size_t N> class log2_histogram {
+public:
+  static constexpr std::size_t buckets = N;
+
+  void record(uint64_t sample) noexcept { _buckets[bucket_of(sample)].add(); }
+
+  uint64_t count(std::size_t bucket) const noexcept {
+    return _buckets[bucket].get();
+  }
+
+  void set(std::size_t bucket, uint64_t n) noexcept { _buckets[bucket].set(n); }
+
+  static std::size_t bucket_of(uint64_t sample) noexcept {
+    std::size_t width = 0;
+#if defined(__GNUC__) || defined(__clang__)
+    width = sample ? 64 - __builtin_clzll(sample) : 0;
+#else
+    for (; sample; sample >>= 1)
+      ++width;
+#endif
+    return width < N ? width : N - 1;
+  }
+
+private:
+  stat_counter _buckets[N];
+};
+
+struct fd_stats {
+  stat_counter events;    // times reported ready by the muxer
+  stat_counter bytes_in;  // bytes received through a metered sockio
+  stat_counter bytes_out; // bytes sent through a metered sockio
+  stat_counter throttles;    // times input was held for the rate limit
+  stat_counter throttled_ns; // time input was held, once released
+};
+
+/// Counters kept by one reactor (one io_mux_base).
+///
+/// The layout is fixed and contains no pointers so it can be placed in a
+/// shared mapping and read by an external tool. Bump \ref layout_version
+/// whenever a field is added, removed or reordered.
+struct reactor_stats {
+  static constexpr uint32_t magic_value = 0x5741534c; // "WASL"
+  static constexpr uint32_t layout_version = 3;
+  static constexpr int max_tracked_fds = 1024;
+
+  uint32_t magic = magic_value;
+  uint32_t version = layout_version;
+
+  stat_counter wakeups;    // returns from Muxer::wait
+  stat_counter events;     // ready fds across all wakeups
+  stat_counter dispatched; // handler invocations
+  stat_counter bytes_in;
+  stat_counter bytes_out;
+  stat_counter throttles;    // see io_mux_base::set_rate_limit()
+  stat_counter throttled_ns;
+
+  log2_histogram<16> batch_sizes; // ready fds per wakeup
+  log2_histogram<40> handler_ns;  // handler execution time
+
+  // latency of received messages, see record_latency()
+  log2_histogram<40> wire_to_handler_ns; // kernel arrival to handler
+  log2_histogram<40> end_to_end_ns;      // sender's clock to handler
+
+  /// fds at or above max_tracked_fds are only counted in the totals
+  fd_stats fds[max_tracked_fds];
+
+  fd_stats *fd(SOCKET sfd) noexcept {
+    return sfd >= 0 && sfd < max_tracked_fds ? &fds[sfd] : nullptr;
+  }
+
+  void record_in(SOCKET sfd, uint64_t n) noexcept {
+    bytes_in.add(n);
+    if (auto *s = fd(sfd))
+      s->bytes_in.add(n);
+  }
+
+  void record_out(SOCKET sfd, uint64_t n) noexcept {
+    bytes_out.add(n);
+    if (auto *s = fd(sfd))
+      s->bytes_out.add(n);
+  }
+
+  /// Zero the counters of sfd, e.g. when the descriptor is recycled.
+  void reset_fd(SOCKET sfd) noexcept;
+
+  /// Copy every counter of other into this.
+  void assign(const reactor_stats &other) noexcept;
+};
+
+/// Point-in-time copy of a \ref reactor_stats.
+struct metrics_snapshot {
+  struct fd_entry {
+    SOCKET fd;
+    uint64_t events;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t throttles;
+    uint64_t throttled_ns;
+  };
+
+  uint64_t wakeups{0};
+  uint64_t events{0};
+  uint64_t dispatched{0};
+  uint64_t bytes_in{0};
+  uint64_t bytes_out{0};
+  uint64_t throttles{0};
+  uint64_t throttled_ns{0};
+
+  std::vector<uint64_t> batch_sizes;
+  std::vector<uint64_t> handler_ns;
+  std::vector<uint64_t> wire_to_handler_ns;
+  std::vector<uint64_t> end_to_end_ns;
+
+  /// only fds with any recorded activity
+  std::vector<fd_entry> fds;
+};
+
+metrics_snapshot snapshot(const reactor_stats &stats);
+
+/// Memory holding a \ref reactor_stats.
+///
+/// Default constructed segments are private anonymous mappings. Segments
+/// created from a path are shared file mappings, so another process can
+/// attach() to the same path and read live counters without a syscall into
+/// the owning process.
+class stats_segment {
+public:
+  /// private, process-local counters
+  stats_segment();
+
+  /// shared counters backed by the file at path (created or truncated)
+  explicit stats_segment(gsl::czstring<> path);
+
+  ~stats_segment();
+
+  stats_segment(stats_segment &&other) noexcept;
+  stats_segment &operator=(stats_segment &&other) noexcept;
+  WASL_NO_COPY(stats_segment);
+
+  /// Map an existing segment read-only.
+  /// Check the result with operator bool and errno on failure.
+  static stats_segment attach(gsl::czstring<> path);
+
+  explicit operator bool() const { return _stats != nullptr; }
+
+  /// \pre segment is valid and was not attach()'ed
+  reactor_stats *get() const noexcept { return _writable ? _stats : nullptr; }
+
+  const reactor_stats &stats() const noexcept { return *_stats; }
+
+private:
+  stats_segment(reactor_stats *stats, bool writable) noexcept
+      : _stats{stats}, _writable{writable} {}
+
+  reactor_stats *_stats{nullptr};
+  bool _writable{false};
+};
+
+/// Stats of the reactor currently dispatching on this thread, or nullptr.
+/// Set by io_mux_base::listen() for its duration so that I/O policies such as
+/// \ref metered_sockio can attribute bytes without holding a reactor pointer.
+inline reactor_stats *&this_thread_stats() noexcept {
+  static thread_local reactor_stats *stats = nullptr;
+  return stats;
+}
+
+/// Wall clock in nanoseconds, the clock of kernel receive timestamps and of
+/// send times stamped into message headers.
+inline uint64_t realtime_ns() noexcept {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+/// Record the latency of a message being handled now into the stats of the
+/// reactor dispatching on this thread, if any.
+///
+/// \param arrival_ns kernel receive timestamp, 0 if unknown
+/// \param sent_ns send time stamped by the sender, 0 if unknown; only
+/// meaningful across hosts with synchronized clocks
+inline void record_latency(uint64_t arrival_ns, uint64_t sent_ns = 0) noexcept {
+  auto *stats = this_thread_stats();
+  if (!stats)
+    return;
+
+  auto now = realtime_ns();
+  if (arrival_ns && arrival_ns <= now)
+    stats->wire_to_handler_ns.record(now - arrival_ns);
+  if (sent_ns && sent_ns <= now)
+    stats->end_to_end_ns.record(now - sent_ns);
+}
+
+/// SockIO policy decorator counting bytes into this_thread_stats().
+template <typename SockIO> struct metered_sockio : SockIO {
+  static ssize_t rv_recv(SOCKET sfd, char *buf, int flags = 0) {
+    auto n = SockIO::rv_recv(sfd, buf, flags);
+    if (n > 0)
+      if (auto *stats = this_thread_stats())
+        stats->record_in(sfd, n);
+    return n;
+  }
+
+  static ssize_t rv_recv_from(SOCKET sfd, char *buf, std::size_t len,
+                              peer_address &from, int flags = 0) {
+    auto n = SockIO::rv_recv_from(sfd, buf, len, from, flags);
+    if (n > 0)
+      if (auto *stats = this_thread_stats())
+        stats->record_in(sfd, n);
+    return n;
+  }
+
+  /// Not counted: the message is counted once it is received.
+  static ssize_t rv_next_size(SOCKET sfd, int flags = 0) {
+    return SockIO::rv_next_size(sfd, flags);
+  }
+
+  static ssize_t rv_recv_stamped(SOCKET sfd, char *buf, std::size_t len,
+                                 uint64_t &arrival_ns,
+                                 peer_address *from = nullptr, int flags = 0) {
+    auto n = SockIO::rv_recv_stamped(sfd, buf, len, arrival_ns, from, flags);
+    if (n > 0)
+      if (auto *stats = this_thread_stats())
+        stats->record_in(sfd, n);
+    return n;
+  }
+
+  static ssize_t rv_recv_msg(SOCKET sfd, char *buf, std::size_t len,
+                             int flags = 0) {
+    auto n = SockIO::rv_recv_msg(sfd, buf, len, flags);
+    if (n > 0)
+      if (auto *stats = this_thread_stats())
+        stats->record_in(sfd, n);
+    return n;
+  }
+
+  static ssize_t rv_send(SOCKET sfd, char *buf, socklen_t len, int flags = 0) {
+    auto n = SockIO::rv_send(sfd, buf, len, flags);
+    if (n > 0)
+      if (auto *stats = this_thread_stats())
+        stats->record_out(sfd, n);
+    return n;
+  }
+
+  static ssize_t rv_send_to(SOCKET sfd, const char *buf, std::size_t len,
+                            const peer_address &to, int flags = 0) {
+    auto n = SockIO::rv_send_to(sfd, buf, len, to, flags);
+    if (n > 0)
+      if (auto *stats = this_thread_stats())
+        stats->record_out(sfd, n);
+    return n;
+  }
+
+  static ssize_t rv_sendv(SOCKET sfd, const struct iovec *iov, int iovcnt,
+                          int flags = 0) {
+    auto n = SockIO::rv_sendv(sfd, iov, iovcnt, flags);
+    if (n > 0)
+      if (auto *stats = this_thread_stats())
+        stats->record_out(sfd, n);
+    return n;
+  }
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_METRICS_H */
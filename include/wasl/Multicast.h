@@ -0,0 +1,172 @@
+#ifndef WASL_MULTICAST_H
+#define WASL_MULTICAST_H
+
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Peer.h>
+#include <wasl/Socket.h>
+
+#include <gsl/span>
+#include <gsl/string_span> // czstring
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wasl {
+namespace ip {
+
+/// Header in front of every multicast payload, in host byte order.
+/// Sequence numbers count per publisher and topic from 1, so a receiver can
+/// tell lost datagrams from reordered or duplicated ones.
+struct mcast_header {
+  static constexpr uint16_t magic_value = 0x574d; // "WM"
+
+  uint16_t magic{magic_value};
+  uint16_t reserved{0};
+  uint32_t topic{0};
+  uint64_t seq{0};
+};
+static_assert(sizeof(mcast_header) == 16, "mcast_header layout changed");
+
+/// Stable 32-bit id of a topic name (FNV-1a).
+uint32_t topic_id(gsl::czstring<> topic);
+
+/// Maps topics to IPv4 multicast groups sharing one port.
+///
+/// Topics hash onto a block of consecutive groups starting at a base
+/// address unless assigned a group explicitly. Subscribers join only the
+/// groups of their topics, so unrelated traffic is filtered by the NIC and
+/// kernel rather than by every receiver.
+class topic_map {
+public:
+  /// \param base first group of the block, e.g. "239.192.0.0"
+  /// \param groups number of groups in the block, at least 1
+  topic_map(gsl::czstring<> base, uint32_t groups, in_port_t port);
+
+  /// Pin topic to group instead of hashing it.
+  void assign(gsl::czstring<> topic, gsl::czstring<> group);
+
+  /// Dotted group address of topic, empty if the base address was invalid.
+  std::string group_for(gsl::czstring<> topic) const;
+
+  in_port_t port() const { return _port; }
+
+private:
+  uint32_t _base; // host byte order, 0 if invalid
+  uint32_t _groups;
+  in_port_t _port;
+  std::unordered_map<uint32_t, std::string> _assigned;
+};
+
+/// Publishes sequence-numbered messages to the groups of their topics.
+/// One send reaches every subscriber, however many there are.
+class mcast_publisher {
+public:
+  /// \param iface address of the interface to send through, nullptr for the
+  /// route's choice; "127.0.0.1" keeps traffic on this host
+  explicit mcast_publisher(topic_map topics, int ttl = 1,
+                           gsl::czstring<> iface = nullptr);
+
+  explicit operator bool() const { return _sock && is_open(*_sock); }
+
+  /// Send payload as one datagram.
+  /// \return payload bytes sent, or -1 on error (see errno)
+  ssize_t publish(gsl::czstring<> topic, gsl::span<const char> payload);
+
+  /// Sequence number of the last message published on topic, 0 if none.
+  uint64_t sequence(gsl::czstring<> topic) const;
+
+  friend SOCKET sockno(const mcast_publisher &pub) {
+    return pub._sock ? sockno(*pub._sock) : INVALID_SOCKET;
+  }
+
+private:
+  topic_map _topics;
+  std::unique_ptr<socket_dgram_udp> _sock;
+  std::unordered_map<uint32_t, uint64_t> _seq;
+};
+
+/// Counters of an mcast_subscriber.
+struct mcast_stats {
+  uint64_t received{0};   // messages delivered
+  uint64_t gaps{0};       // sequence gaps detected
+  uint64_t lost{0};       // messages missing across all gaps
+  uint64_t duplicates{0}; // duplicated or late messages dropped
+  uint64_t malformed{0};  // datagrams without a valid header
+};
+
+/// Receives the topics it subscribed to and detects sequence gaps per
+/// publisher and topic.
+class mcast_subscriber {
+public:
+  using message_fn =
+      std::function<void(uint32_t topic, uint64_t seq, gsl::span<const char>)>;
+
+  /// Called before the message that revealed the gap.
+  using gap_fn =
+      std::function<void(uint32_t topic, uint64_t first_missing, uint64_t count)>;
+
+  /// \param iface address of the interface to join groups on, see
+  /// mcast_publisher
+  explicit mcast_subscriber(topic_map topics, gsl::czstring<> iface = nullptr);
+
+  explicit operator bool() const { return _sock && is_open(*_sock); }
+
+  /// Start receiving topic, joining its group if needed.
+  /// \return false if the group could not be joined (see errno)
+  bool subscribe(gsl::czstring<> topic);
+
+  /// Stop receiving topic, leaving its group once no topic needs it.
+  bool unsubscribe(gsl::czstring<> topic);
+
+  void on_message(message_fn fn) { _on_message = std::move(fn); }
+  void on_gap(gap_fn fn) { _on_gap = std::move(fn); }
+
+  /// Receive and deliver everything queued on the socket without blocking.
+  /// \return number of messages delivered
+  std::size_t drain();
+
+  /// Drive receive from a reactor: drain() whenever the socket is readable.
+  /// \return false if the socket failed or cannot be added to mux
+  template <typename Mux> bool attach(Mux &mux) {
+    if (!_sock)
+      return false;
+
+    auto sd = sockno(*_sock);
+    if (!mux.add(sd))
+      return false;
+    mux.bind_event(sd, labeled_handler<std::string>{
+                           "mcast", [this](SOCKET, std::string) { drain(); }});
+    return true;
+  }
+
+  const mcast_stats &stats() const { return _stats; }
+
+  friend SOCKET sockno(const mcast_subscriber &sub) {
+    return sub._sock ? sockno(*sub._sock) : INVALID_SOCKET;
+  }
+
+private:
+  void deliver(const peer_address &from, const char *buf, std::size_t len);
+
+  topic_map _topics;
+  std::string _iface;
+  std::unique_ptr<socket_dgram_udp> _sock;
+  std::unordered_map<uint32_t, std::string> _subscribed; // topic -> group
+  std::map<std::string, int> _joined;                     // group -> topics
+  peer_table _publishers;
+  std::unordered_map<uint64_t, uint64_t> _expected; // publisher, topic -> seq
+  std::vector<char> _buf;
+  mcast_stats _stats;
+  message_fn _on_message;
+  gap_fn _on_gap;
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_MULTICAST_H */
@@ -0,0 +1,112 @@
+#ifndef WASL_PEER_H
+#define WASL_PEER_H
+
+#include <wasl/Types.h>
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace wasl {
+namespace ip {
+
+/// Source or destination address of a connectionless message.
+struct peer_address {
+  struct sockaddr_storage addr {};
+  socklen_t len{0};
+
+  const struct sockaddr *get() const {
+    return reinterpret_cast<const struct sockaddr *>(&addr);
+  }
+
+  struct sockaddr *get() {
+    return reinterpret_cast<struct sockaddr *>(&addr);
+  }
+
+  /// false for messages without a source, e.g. from an unbound unix socket
+  explicit operator bool() const { return len > 0; }
+};
+
+inline bool operator==(const peer_address &a, const peer_address &b) {
+  return a.len == b.len && memcmp(&a.addr, &b.addr, a.len) == 0;
+}
+
+inline bool operator!=(const peer_address &a, const peer_address &b) {
+  return !(a == b);
+}
+
+/// FNV-1a over the significant bytes of the address.
+struct peer_address_hash {
+  std::size_t operator()(const peer_address &peer) const {
+    auto *bytes = reinterpret_cast<const unsigned char *>(&peer.addr);
+    uint64_t h = 14695981039346656037ull;
+    for (socklen_t i = 0; i < peer.len; ++i) {
+      h ^= bytes[i];
+      h *= 1099511628211ull;
+    }
+    return static_cast<std::size_t>(h);
+  }
+};
+
+/// Compact handle for a cached peer_address.
+using peer_id = uint32_t;
+constexpr peer_id invalid_peer = UINT32_MAX;
+
+/// Cache of peer addresses keyed by compact ids.
+///
+/// Lets one unconnected datagram socket answer many peers: the receive path
+/// interns each source address once and handlers keep the 4-byte id instead
+/// of a sockaddr_storage. Ids of forgotten peers are reused.
+class peer_table {
+public:
+  /// \return the id of peer, assigning one on first sight
+  peer_id intern(const peer_address &peer) {
+    auto it = _ids.find(peer);
+    if (it != _ids.end())
+      return it->second;
+
+    peer_id id;
+    if (!_free.empty()) {
+      id = _free.back();
+      _free.pop_back();
+      _peers[id] = peer;
+    } else {
+      id = static_cast<peer_id>(_peers.size());
+      _peers.push_back(peer);
+    }
+    _ids.emplace(peer, id);
+    return id;
+  }
+
+  /// \return the address of id, or nullptr if it is not in use
+  const peer_address *find(peer_id id) const {
+    if (id >= _peers.size() || !_peers[id])
+      return nullptr;
+    return &_peers[id];
+  }
+
+  /// Drop id, e.g. when its peer stops responding.
+  /// \return false if id was not in use
+  bool forget(peer_id id) {
+    if (!find(id))
+      return false;
+
+    _ids.erase(_peers[id]);
+    _peers[id] = peer_address{};
+    _free.push_back(id);
+    return true;
+  }
+
+  std::size_t size() const { return _ids.size(); }
+
+private:
+  std::vector<peer_address> _peers; // indexed by peer_id
+  std::unordered_map<peer_address, peer_id, peer_address_hash> _ids;
+  std::vector<peer_id> _free;
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_PEER_H */
@@ -0,0 +1,94 @@
+#ifndef WASL_RATELIMIT_H
+#define WASL_RATELIMIT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace wasl {
+namespace ip {
+
+/// Sustained rates and bursts a source may send at.
+struct rate_limit {
+  double messages_per_sec{0}; // 0 for no limit
+  double bytes_per_sec{0};    // 0 for no limit
+  double burst_messages{0};   // most messages at once, 0 for a second's worth
+  double burst_bytes{0};      // most bytes at once, 0 for a second's worth
+};
+
+/// Token bucket of a message and a byte rate.
+///
+/// Tokens refill continuously up to the burst size and every message takes
+/// one message token and its size in byte tokens. As a message's size is
+/// only known once it was read, byte tokens may go into debt; the source
+/// is not ready again until the debt is paid off.
+///
+/// Times are nanoseconds on any monotonic clock, passed in by the caller.
+class token_bucket {
+public:
+  /// Starts full.
+  explicit token_bucket(rate_limit limit, uint64_t now_ns = 0)
+      : _limit{limit}, _last_ns{now_ns} {
+    if (_limit.burst_messages <= 0)
+      _limit.burst_messages = std::max(_limit.messages_per_sec, 1.0);
+    if (_limit.burst_bytes <= 0)
+      _limit.burst_bytes = std::max(_limit.bytes_per_sec, 1.0);
+    _messages = _limit.burst_messages;
+    _bytes = _limit.burst_bytes;
+  }
+
+  /// Whether a message may be taken at now_ns.
+  bool ready(uint64_t now_ns) {
+    refill(now_ns);
+    return (!limits_messages() || _messages >= 1) &&
+           (!limits_bytes() || _bytes > 0);
+  }
+
+  /// Take messages of bytes in total at now_ns.
+  void take(uint64_t messages, uint64_t bytes, uint64_t now_ns) {
+    refill(now_ns);
+    if (limits_messages())
+      _messages -= messages;
+    if (limits_bytes())
+      _bytes -= bytes;
+  }
+
+  /// Nanoseconds from now_ns until ready(), 0 if it is.
+  uint64_t wait_ns(uint64_t now_ns) {
+    refill(now_ns);
+    double wait = 0;
+    if (limits_messages() && _messages < 1)
+      wait = (1 - _messages) / _limit.messages_per_sec;
+    if (limits_bytes() && _bytes <= 0)
+      wait = std::max(wait, (1 - _bytes) / _limit.bytes_per_sec);
+    return static_cast<uint64_t>(std::ceil(wait * 1e9));
+  }
+
+  bool limits_messages() const { return _limit.messages_per_sec > 0; }
+  bool limits_bytes() const { return _limit.bytes_per_sec > 0; }
+
+  const rate_limit &limit() const { return _limit; }
+
+private:
+  void refill(uint64_t now_ns) {
+    if (now_ns <= _last_ns)
+      return;
+
+    double elapsed = (now_ns - _last_ns) / 1e9;
+    _last_ns = now_ns;
+    _messages = std::min(_limit.burst_messages,
+                         _messages + elapsed * _limit.messages_per_sec);
+    _bytes = std::min(_limit.burst_bytes,
+                      _bytes + elapsed * _limit.bytes_per_sec);
+  }
+
+  rate_limit _limit;
+  double _messages;
+  double _bytes;
+  uint64_t _last_ns;
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_RATELIMIT_H */
@@ -0,0 +1,308 @@
+#ifndef WASL_RELAY_H
+#define WASL_RELAY_H
+
+#include <wasl/Common.h>
+#include <wasl/Types.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace wasl {
+namespace ip {
+
+struct relay_stats {
+  uint64_t bytes_in{0};       // spliced from the source
+  uint64_t bytes_out{0};      // spliced to the destination
+  uint64_t bytes_mirrored{0}; // spliced to the mirror
+  uint64_t stalls{0};         // times the source was paused, pipe full
+};
+
+/// Forwards a stream socket to another, and optionally mirrors it to a
+/// third, without the payload entering user space.
+///
+/// Bytes move from the source into a pipe with splice(2) and from the pipe
+/// to the destination with splice(2) again. A mirror gets its own pipe,
+/// filled with tee(2), which duplicates pipe buffers by reference.
+///
+/// The pipe is the relay's only buffer: once it is full because a
+/// destination is slow, input of the source is paused in the reactor until
+/// the destination drains, and a mirror holds up the destination just as
+/// much. When the source reaches its end, the destinations are shut down
+/// for writing once everything was forwarded, leaving their other
+/// direction open; relay the reverse direction with a second splice_relay.
+/// A finished relay stops reading the source, which stays added to the
+/// reactor; removing and closing the sockets is up to their owner.
+///
+/// splice() has no MSG_NOSIGNAL: ignore SIGPIPE, so that a destination
+/// closing fails the relay with EPIPE rather than killing the process.
+/// Not thread-safe: run it on the reactor thread.
+/// \tparam Mux io_mux_base instantiation
+template <typename Mux> class splice_relay {
+public:
+  /// Called once the source ended and everything was forwarded, with
+  /// error 0, or the relay failed, with its errno. The relay may be
+  /// destroyed from it.
+  using done_fn = std::function<void(int error)>;
+
+  /// \param mirror also forward to this socket, INVALID_SOCKET for none
+  /// \param pipe_size bytes the pipes should hold, 0 for the system default
+  /// Check the result with operator bool and errno on failure.
+  splice_relay(Mux &mux, SOCKET src, SOCKET dst,
+               SOCKET mirror = INVALID_SOCKET, std::size_t pipe_size = 0)
+      : _mux{mux}, _src{src}, _dst{dst}, _mirror{mirror} {
+    _open = open_pipe(_main, pipe_size) &&
+            (mirror == INVALID_SOCKET || open_pipe(_copy, pipe_size));
+  }
+
+  /// Stops reading the source if still relaying.
+  ~splice_relay() {
+    if (_running) {
+      stop_watching();
+      release_source();
+    }
+    close_pipe(_main);
+    close_pipe(_copy);
+  }
+
+  WASL_NO_COPY(splice_relay);
+
+  explicit operator bool() const { return _open; }
+
+  /// Start relaying as the reactor finds the sockets ready.
+  /// \pre src, dst and mirror were added to the reactor and are
+  /// non-blocking
+  bool start(done_fn done = nullptr) {
+    if (!_open || _running)
+      return false;
+
+    _done = std::move(done);
+    _running = true;
+    _mux.bind_event(_src, labeled_handler<std::string>{
+                              "relay", [this](SOCKET, std::string) { pump(); }});
+    return true;
+  }
+
+  /// Whether the relay started and has not finished yet.
+  bool running() const { return _running; }
+
+  /// Bytes read from the source and not yet sent to every destination.
+  std::size_t buffered() const { return _main.len + _copy.len; }
+
+  const relay_stats &stats() const { return _stats; }
+
+private:
+  struct pipe_end {
+    int r{-1};
+    int w{-1};
+    std::size_t len{0}; // bytes in the pipe
+    std::size_t cap{0};
+  };
+
+  static bool would_block() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+
+  static bool open_pipe(pipe_end &p, std::size_t size) {
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1)
+      return false;
+
+    p.r = fds[0];
+    p.w = fds[1];
+    if (size > 0)
+      fcntl(p.w, F_SETPIPE_SZ, static_cast<int>(size)); // best effort
+    auto cap = fcntl(p.w, F_GETPIPE_SZ);
+    p.cap = cap > 0 ? static_cast<std::size_t>(cap) : 65536;
+    return true;
+  }
+
+  static void close_pipe(pipe_end &p) {
+    if (p.r != -1) {
+      close(p.r);
+      close(p.w);
+    }
+  }
+
+  bool mirrored() const { return _mirror != INVALID_SOCKET; }
+
+  /// Move data along until nothing can move without blocking.
+  void pump() {
+    bool moved = true;
+    while (moved && _running) {
+      moved = false;
+
+      if (!_eof && !_full) {
+        auto n = fill();
+        if (n > 0) {
+          _main.len += n;
+          _stats.bytes_in += n;
+          moved = true;
+        } else if (n == 0) {
+          _eof = true;
+        } else if (would_block()) {
+          // pipes fill up by buffer slots as well as by bytes
+          _full = _main.len > 0 && input_pending();
+        } else {
+          return finish(errno);
+        }
+      }
+
+      // tee() copies from the head of the pipe, so only once the bytes
+      // copied before went out to the destination
+      if (mirrored() && _teed == 0 && _main.len > 0) {
+        auto n = tee(_main.r, _copy.w, _main.len, SPLICE_F_NONBLOCK);
+        if (n > 0) {
+          _teed = n;
+          _copy.len += n;
+          moved = true;
+        } else if (n < 0 && !would_block()) {
+          return finish(errno);
+        }
+      }
+
+      auto n = drain(_main, _dst, mirrored() ? _teed : _main.len,
+                     _dst_waiting);
+      if (n < 0)
+        return finish(errno);
+      if (n > 0) {
+        if (mirrored())
+          _teed -= n;
+        _stats.bytes_out += n;
+        _full = false;
+        moved = true;
+      }
+
+      if (mirrored()) {
+        n = drain(_copy, _mirror, _copy.len, _mirror_waiting);
+        if (n < 0)
+          return finish(errno);
+        _stats.bytes_mirrored += n;
+        moved = moved || n > 0;
+      }
+    }
+    if (!_running)
+      return;
+
+    if (_eof && buffered() == 0) {
+      shutdown(_dst, SHUT_WR);
+      if (mirrored())
+        shutdown(_mirror, SHUT_WR);
+      return finish(0);
+    }
+
+    // stop reading while the pipe is full, and for good at the end, which
+    // also keeps the reactor from removing the source on the hangup
+    bool paused = _eof || _full;
+    if (paused != _paused) {
+      _paused = paused;
+      if (paused) {
+        _mux.pause_input(_src);
+        if (!_eof)
+          ++_stats.stalls;
+      } else {
+        _mux.resume_input(_src);
+      }
+    }
+  }
+
+  /// Splice from the source into the pipe.
+  /// \return bytes moved, 0 at the end of the source, or -1 (see errno)
+  ssize_t fill() {
+    if (_main.len == _main.cap) {
+      errno = EAGAIN;
+      return -1;
+    }
+    return splice(_src, nullptr, _main.w, nullptr, _main.cap - _main.len,
+                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  }
+
+  bool input_pending() const {
+    int n = 0;
+    return ioctl(_src, FIONREAD, &n) == 0 && n > 0;
+  }
+
+  /// Splice up to max bytes of p to sd, watching sd if it would block.
+  /// \return bytes sent, or -1 on error
+  ssize_t drain(pipe_end &p, SOCKET sd, std::size_t max, bool &waiting) {
+    if (max == 0 || waiting)
+      return 0;
+
+    auto n = splice(p.r, nullptr, sd, nullptr, max,
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0) {
+      p.len -= n;
+      return n;
+    }
+    if (n < 0 && would_block()) {
+      // a destination that left the reactor would never drain
+      if (!_mux.watch_writable(sd, [this, &waiting](SOCKET fd) {
+            waiting = false;
+            _mux.unwatch_writable(fd);
+            pump();
+          })) {
+        errno = EBADF;
+        return -1;
+      }
+      waiting = true;
+      return 0;
+    }
+    return n;
+  }
+
+  void stop_watching() {
+    if (_dst_waiting)
+      _mux.unwatch_writable(_dst);
+    if (_mirror_waiting)
+      _mux.unwatch_writable(_mirror);
+    _dst_waiting = _mirror_waiting = false;
+  }
+
+  /// Stop reading the source for good. Its slot stays in the reactor: the
+  /// source may be the destination of the relay in the other direction,
+  /// watched for output.
+  void release_source() {
+    if (!_paused) {
+      _mux.pause_input(_src);
+      _paused = true;
+    }
+    _mux.rebind(_src, labeled_handler<std::string>{
+                          "relay", [](SOCKET, std::string) {}});
+  }
+
+  void finish(int error) {
+    stop_watching();
+    release_source();
+    _running = false;
+
+    auto done = std::move(_done);
+    if (done)
+      done(error);
+  }
+
+  Mux &_mux;
+  SOCKET _src;
+  SOCKET _dst;
+  SOCKET _mirror;
+  pipe_end _main;
+  pipe_end _copy;        // of the mirror
+  std::size_t _teed{0};  // head of _main already in _copy
+  bool _open{false};
+  bool _running{false};
+  bool _eof{false};
+  bool _full{false}; // the source has input the pipe cannot take
+  bool _paused{false};
+  bool _dst_waiting{false};
+  bool _mirror_waiting{false};
+  done_fn _done;
+  relay_stats _stats;
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_RELAY_H */
@@ -0,0 +1,484 @@
+#ifndef WASL_RPC_H
+#define WASL_RPC_H
+
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Message.h>
+#include <wasl/SockStream.h>
+#include <wasl/Types.h>
+
+#include <gsl/span>
+#include <gsl/string_span> // czstring
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wasl {
+namespace ip {
+
+/// Outcome of an rpc call.
+enum class rpc_status : uint8_t {
+  OK,
+  ERROR,        // the server failed the call, e.g. for an unknown method
+  TIMEOUT,      // no reply before the deadline
+  DISCONNECTED, // the connection closed or failed before the reply
+};
+
+/// Counters of an rpc_client.
+struct rpc_stats {
+  uint64_t calls{0};
+  uint64_t replies{0};  // OK and ERROR replies matched to a call
+  uint64_t timeouts{0};
+  uint64_t late{0};     // replies arriving after their call timed out
+  uint64_t writes{0};   // sends carrying the batched requests
+};
+
+/// Framed, batched message exchange over one stream socket, the transport
+/// of rpc_client and rpc_server.
+///
+/// Frames are messages (see message_header) whose schema id names the
+/// method and whose header extension carries the correlation id. Queued
+/// frames are written together: once batch_bytes accumulate, or when the
+/// reactor next finds the socket writable, so that the calls made during
+/// one reactor turn share a single send.
+template <typename Mux, typename SockIO = basic_sockio<platform_type>>
+class rpc_channel {
+public:
+  /// Largest payload accepted; larger frames fail the connection.
+  static constexpr uint32_t max_payload = 16u << 20;
+
+  using message_fn = std::function<void(const message_view &)>;
+  using close_fn = std::function<void(int error)>;
+
+  rpc_channel(Mux &mux, SOCKET sd, std::size_t batch_bytes)
+      : _mux{mux}, _sd{sd}, _batch_bytes{batch_bytes} {}
+
+  ~rpc_channel() {
+    if (_open)
+      _mux.remove(_sd);
+  }
+
+  WASL_NO_COPY(rpc_channel);
+
+  /// Watch the socket and deliver received frames to on_message until the
+  /// connection closes (error 0) or fails.
+  bool start(message_fn on_message, close_fn on_close) {
+    if (!_mux.add(_sd))
+      return false;
+
+    _on_message = std::move(on_message);
+    _on_close = std::move(on_close);
+    _open = true;
+    _mux.bind_event(_sd, labeled_handler<std::string>{
+                             "rpc", [this](SOCKET, std::string) { receive(); }});
+    return true;
+  }
+
+  explicit operator bool() const { return _open; }
+
+  /// Queue a frame for sending.
+  /// \return false if the connection is closed
+  bool queue(uint16_t method, uint8_t flags, uint64_t id,
+             gsl::span<const char> payload) {
+    if (!_open)
+      return false;
+
+    message_header header;
+    header.flags = flags | message_header::flag_correlation;
+    header.schema_id = method;
+    header.length = static_cast<uint32_t>(payload.size());
+    header.ext_length = sizeof(id);
+
+    auto at = _out.size();
+    _out.resize(at + header.size());
+    memcpy(&_out[at], &header, sizeof(header));
+    memcpy(&_out[at + sizeof(header)], &id, sizeof(id));
+    memcpy(&_out[at + sizeof(header) + sizeof(id)], payload.data(),
+           payload.size());
+
+    if (_out.size() - _sent >= _batch_bytes)
+      return flush() >= 0;
+    watch(true);
+    return true;
+  }
+
+  /// Send queued frames until the socket would block.
+  /// \return bytes sent, or -1 if the connection failed
+  ssize_t flush() {
+    ssize_t total = 0;
+    while (_open && _sent < _out.size()) {
+      auto n = SockIO::rv_send(_sd, &_out[_sent],
+                               static_cast<socklen_t>(_out.size() - _sent),
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+        fail(errno);
+        return -1;
+      }
+      ++_writes;
+      _sent += n;
+      total += n;
+    }
+
+    if (_sent == _out.size()) {
+      _out.clear();
+      _sent = 0;
+    }
+    watch(_sent < _out.size());
+    return total;
+  }
+
+  /// Sends made by flush() so far.
+  uint64_t writes() const { return _writes; }
+
+  friend SOCKET sockno(const rpc_channel &ch) { return ch._sd; }
+
+private:
+  void watch(bool pending) {
+    if (!_open || pending == _watching)
+      return;
+    _watching = pending;
+    if (pending)
+      _mux.watch_writable(_sd, [this](SOCKET) { flush(); });
+    else
+      _mux.unwatch_writable(_sd);
+  }
+
+  void receive() {
+    char buf[16 * 1024];
+    for (;;) {
+      auto n = SockIO::rv_recv_msg(_sd, buf, sizeof(buf), MSG_DONTWAIT);
+      if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        fail(n == 0 ? 0 : errno);
+        return;
+      }
+      if (n < 0)
+        break;
+
+      _in.insert(_in.end(), buf, buf + n);
+      if (static_cast<std::size_t>(n) < sizeof(buf))
+        break;
+    }
+
+    std::size_t pos = 0;
+    while (_open && _in.size() - pos >= sizeof(message_header)) {
+      message_view msg{&_in[pos], _in.size() - pos};
+      if (!msg.header().valid() || msg.header().length > max_payload) {
+        fail(EPROTO);
+        return;
+      }
+      if (!msg.valid())
+        break; // incomplete
+
+      pos += msg.header().size();
+      _on_message(msg);
+    }
+    _in.erase(_in.begin(), _in.begin() + pos);
+  }
+
+  void fail(int error) {
+    if (!_open)
+      return;
+    _open = false;
+    _watching = false;
+    _mux.remove(_sd);
+    if (_on_close)
+      _on_close(error);
+  }
+
+  Mux &_mux;
+  SOCKET _sd;
+  std::size_t _batch_bytes;
+  std::vector<char> _in;
+  std::vector<char> _out;
+  std::size_t _sent{0}; // bytes of _out already sent
+  bool _open{false};
+  bool _watching{false};
+  uint64_t _writes{0};
+  message_fn _on_message;
+  close_fn _on_close;
+};
+
+/// Client end of a connection carrying many outstanding calls at once.
+///
+/// Each call gets a correlation id; replies may arrive in any order and are
+/// matched to their calls by it. A call's deadline runs on the reactor's
+/// timers, so every call completes exactly once: with the reply, or with
+/// TIMEOUT or DISCONNECTED. The socket is not closed by the client.
+///
+/// \tparam Mux io_mux_base instantiation driving the connection
+template <typename Mux, typename SockIO = basic_sockio<platform_type>>
+class rpc_client {
+public:
+  /// Called once per call. The reply is only valid during the call; for
+  /// TIMEOUT and DISCONNECTED it is empty (not valid()).
+  using reply_fn = std::function<void(rpc_status, const message_view &reply)>;
+
+  /// \param batch_bytes queued requests are sent once this many accumulate,
+  /// else at the end of the reactor turn
+  rpc_client(Mux &mux, SOCKET sd, std::size_t batch_bytes = 16 * 1024)
+      : _mux{mux}, _channel{mux, sd, batch_bytes} {
+    _channel.start([this](const message_view &msg) { on_reply(msg); },
+                   [this](int) { disconnect(); });
+  }
+
+  /// Outstanding calls are dropped without completing.
+  ~rpc_client() {
+    for (auto &p : _pending)
+      _mux.cancel_timer(p.second.timer);
+  }
+
+  WASL_NO_COPY(rpc_client);
+
+  explicit operator bool() const { return static_cast<bool>(_channel); }
+
+  /// Call method with payload.
+  /// \param timeout deadline for the reply, from now
+  /// \return the call's correlation id, or 0 if the connection is closed
+  uint64_t call(uint16_t method, gsl::span<const char> payload,
+                std::chrono::nanoseconds timeout, reply_fn done) {
+    auto id = _next_id++;
+    if (!_channel.queue(method, 0, id, payload))
+      return 0;
+
+    auto timer = _mux.run_after(timeout, [this, id] { expire(id); });
+    _pending.emplace(id, pending{std::move(done), timer});
+    ++_stats.calls;
+    return id;
+  }
+
+  /// Call the method named by T's message schema with request as payload.
+  template <typename T>
+  uint64_t call(const T &request, std::chrono::nanoseconds timeout,
+                reply_fn done) {
+    auto *p = reinterpret_cast<const char *>(&request);
+    return call(message_schema<T>::id, {p, p + sizeof(T)}, timeout,
+                std::move(done));
+  }
+
+  /// Send queued requests now rather than at the end of the reactor turn.
+  ssize_t flush() { return _channel.flush(); }
+
+  /// Calls waiting for their reply.
+  std::size_t outstanding() const { return _pending.size(); }
+
+  rpc_stats stats() const {
+    auto s = _stats;
+    s.writes = _channel.writes();
+    return s;
+  }
+
+private:
+  struct pending {
+    reply_fn done;
+    typename Mux::timer_id timer;
+  };
+
+  void on_reply(const message_view &msg) {
+    if (!(msg.header().flags & message_header::flag_reply))
+      return;
+
+    auto it = _pending.find(msg.correlation());
+    if (it == _pending.end()) {
+      ++_stats.late;
+      return;
+    }
+
+    auto p = std::move(it->second);
+    _pending.erase(it);
+    _mux.cancel_timer(p.timer);
+    ++_stats.replies;
+    p.done(msg.header().flags & message_header::flag_error ? rpc_status::ERROR
+                                                            : rpc_status::OK,
+           msg);
+  }
+
+  void expire(uint64_t id) {
+    auto it = _pending.find(id);
+    if (it == _pending.end())
+      return;
+
+    auto p = std::move(it->second);
+    _pending.erase(it);
+    ++_stats.timeouts;
+    // the id stays unknown, so a late reply is counted and dropped
+    p.done(rpc_status::TIMEOUT, message_view{nullptr, 0});
+  }
+
+  void disconnect() {
+    auto calls = std::move(_pending);
+    _pending.clear();
+    for (auto &p : calls) {
+      _mux.cancel_timer(p.second.timer);
+      p.second.done(rpc_status::DISCONNECTED, message_view{nullptr, 0});
+    }
+  }
+
+  Mux &_mux;
+  rpc_channel<Mux, SockIO> _channel;
+  std::unordered_map<uint64_t, pending> _pending;
+  uint64_t _next_id{1};
+  rpc_stats _stats;
+};
+
+/// Serves rpc calls on any number of connections.
+///
+/// Methods reply through a responder, right away or later, e.g. once a
+/// backend answers, so calls on one connection complete out of order.
+/// Replies queued during one reactor turn share a send.
+///
+/// \tparam Mux io_mux_base instantiation driving the connections
+template <typename Mux, typename SockIO = basic_sockio<platform_type>>
+class rpc_server {
+  struct connection;
+
+public:
+  /// Replies to one call. Copyable; replying after the connection closed,
+  /// or more than once, does nothing.
+  class responder {
+  public:
+    /// \return false if the reply cannot be sent
+    bool reply(gsl::span<const char> payload) {
+      return send(_method, 0, payload);
+    }
+
+    /// Reply with the message named by T's schema.
+    template <typename T> bool reply(const T &result) {
+      auto *p = reinterpret_cast<const char *>(&result);
+      return send(message_schema<T>::id, 0, {p, p + sizeof(T)});
+    }
+
+    /// Fail the call with reason, reported to the caller as ERROR.
+    bool fail(gsl::czstring<> reason) {
+      return send(_method, message_header::flag_error,
+                  {reason, reason + strlen(reason)});
+    }
+
+  private:
+    friend class rpc_server;
+
+    responder(rpc_server *server, SOCKET sd, uint64_t serial, uint64_t id,
+              uint16_t method)
+        : _server{server}, _sd{sd}, _serial{serial}, _id{id}, _method{method} {}
+
+    bool send(uint16_t method, uint8_t flags, gsl::span<const char> payload) {
+      if (_done)
+        return false;
+      _done = true;
+      auto *conn = _server->find(_sd, _serial);
+      return conn && conn->channel.queue(method,
+                                         flags | message_header::flag_reply,
+                                         _id, payload);
+    }
+
+    rpc_server *_server;
+    SOCKET _sd;
+    uint64_t _serial; // tells the connection from a later one on the same fd
+    uint64_t _id;
+    uint16_t _method;
+    bool _done{false};
+  };
+
+  using method_fn = std::function<void(const message_view &, responder)>;
+  using close_fn = std::function<void(SOCKET)>;
+
+  explicit rpc_server(Mux &mux, std::size_t batch_bytes = 16 * 1024)
+      : _mux{mux}, _batch_bytes{batch_bytes} {}
+
+  WASL_NO_COPY(rpc_server);
+
+  /// Serve method with f, replacing any previous handler.
+  void handle(uint16_t method, method_fn f) { _methods[method] = std::move(f); }
+
+  /// Serve the method named by T's message schema.
+  template <typename T> void handle(method_fn f) {
+    handle(message_schema<T>::id, std::move(f));
+  }
+
+  /// Serve calls arriving on sd.
+  /// \return false if sd is already served or cannot be watched
+  bool serve(SOCKET sd) {
+    if (_connections.count(sd))
+      return false;
+
+    auto conn = std::make_unique<connection>(_mux, sd, _batch_bytes,
+                                             ++_serial);
+    auto serial = conn->serial;
+    auto started = conn->channel.start(
+        [this, sd, serial](const message_view &msg) {
+          dispatch(sd, serial, msg);
+        },
+        [this, sd, serial](int) { closed(sd, serial); });
+    if (!started)
+      return false;
+
+    _connections.emplace(sd, std::move(conn));
+    return true;
+  }
+
+  /// Called with the socket of a connection that closed or failed. It is
+  /// not closed by the server.
+  void on_close(close_fn f) { _on_close = std::move(f); }
+
+  std::size_t connections() const { return _connections.size(); }
+
+private:
+  struct connection {
+    connection(Mux &mux, SOCKET sd, std::size_t batch_bytes, uint64_t serial)
+        : channel{mux, sd, batch_bytes}, serial{serial} {}
+
+    rpc_channel<Mux, SockIO> channel;
+    uint64_t serial;
+  };
+
+  connection *find(SOCKET sd, uint64_t serial) {
+    auto it = _connections.find(sd);
+    return it != _connections.end() && it->second->serial == serial
+               ? it->second.get()
+               : nullptr;
+  }
+
+  void dispatch(SOCKET sd, uint64_t serial, const message_view &msg) {
+    auto method = msg.header().schema_id;
+    responder r{this, sd, serial, msg.correlation(), method};
+    auto it = _methods.find(method);
+    if (it == _methods.end()) {
+      r.fail("unknown method");
+      return;
+    }
+    it->second(msg, r);
+  }
+
+  void closed(SOCKET sd, uint64_t serial) {
+    // connections closed before are off the stack by now; this one is
+    // still running its receive loop
+    _closed.clear();
+    auto it = _connections.find(sd);
+    if (it != _connections.end() && it->second->serial == serial) {
+      _closed.push_back(std::move(it->second));
+      _connections.erase(it);
+    }
+    if (_on_close)
+      _on_close(sd);
+  }
+
+  Mux &_mux;
+  std::size_t _batch_bytes;
+  std::unordered_map<uint16_t, method_fn> _methods;
+  std::unordered_map<SOCKET, std::unique_ptr<connection>> _connections;
+  std::vector<std::unique_ptr<connection>> _closed; // released on next close
+  uint64_t _serial{0};
+  close_fn _on_close;
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_RPC_H */
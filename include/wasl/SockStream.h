@@ -2,9 +2,12 @@
 #define WASL_SOCKSTREAM_H
 
 #include <wasl/Common.h>
+#include <wasl/Peer.h>
+#include <wasl/Trace.h>
 #include <wasl/Types.h>
 #include <wasl/vproxy_ptr.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
@@ -12,6 +15,10 @@
 #include <cstdio>
 #include <iostream>
 #include <type_traits>
+#include <vector>
+
+#include <limits.h> // IOV_MAX
+#include <sys/uio.h>
 
 namespace wasl {
 
@@ -22,26 +29,99 @@ template <typename PlatformType> struct basic_sockio {
   static constexpr int MAXADDRLEN = 256;
 
   static ssize_t rv_recv(SOCKET sfd, char *buf, int flags = 0) {
-    struct sockaddr_storage peer_addr;
-    socklen_t peer_addr_len;
-
-    ssize_t n_read = recvfrom(sfd, buf, BUFLEN, flags, (SOCKADDR *)&peer_addr,
-                              &peer_addr_len);
+    return recv(sfd, buf, BUFLEN, flags);
+  }
 
-    // TODO use peer_addr here or return to caller
+  /// Receive up to len bytes and the address they came from.
+  static ssize_t rv_recv_from(SOCKET sfd, char *buf, std::size_t len,
+                              peer_address &from, int flags = 0) {
+    from.len = sizeof(from.addr);
+    ssize_t n_read = recvfrom(sfd, buf, len, flags, from.get(), &from.len);
+    if (n_read < 0)
+      from.len = 0;
     return n_read;
   }
 
+  /// Size of the next datagram queued on sfd, without consuming it.
+  /// Blocks like recv() unless flags has MSG_DONTWAIT.
+  static ssize_t rv_next_size(SOCKET sfd, int flags = 0) {
+    return recv(sfd, nullptr, 0, flags | MSG_PEEK | MSG_TRUNC);
+  }
+
+  /// Receive up to len bytes with their kernel arrival time.
+  /// \param[out] arrival_ns wall clock time the data reached the socket, or
+  /// 0 unless the socket was built with socket_builder::timestamps()
+  /// \param[out] from source address, if not nullptr
+  static ssize_t rv_recv_stamped(SOCKET sfd, char *buf, std::size_t len,
+                                 uint64_t &arrival_ns,
+                                 peer_address *from = nullptr, int flags = 0) {
+    struct iovec iov {
+      buf, len
+    };
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(struct timespec))];
+
+    struct msghdr msg {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (from) {
+      msg.msg_name = from->get();
+      msg.msg_namelen = sizeof(from->addr);
+    }
+
+    arrival_ns = 0;
+    auto n = recvmsg(sfd, &msg, flags);
+    if (n < 0)
+      return n;
+
+    if (from)
+      from->len = msg.msg_namelen;
+    for (auto *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+      if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPNS) {
+        struct timespec ts;
+        memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+        arrival_ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull +
+                     ts.tv_nsec;
+      }
+    }
+    return n;
+  }
+
+  /// Receive up to len bytes, one whole datagram if len is large enough.
+  static ssize_t rv_recv_msg(SOCKET sfd, char *buf, std::size_t len,
+                             int flags = 0) {
+    return recv(sfd, buf, len, flags);
+  }
+
   /// \pre sfd is already "connected" to an address
   static ssize_t rv_send(SOCKET sfd, char *buf, socklen_t len, int flags = 0) {
     ssize_t n_read = sendto(sfd, buf, len, flags, NULL, 0);
     return n_read;
   }
+
+  /// Send len bytes to a peer over an unconnected socket.
+  static ssize_t rv_send_to(SOCKET sfd, const char *buf, std::size_t len,
+                            const peer_address &to, int flags = 0) {
+    return sendto(sfd, buf, len, flags, to.get(), to.len);
+  }
+
+  /// Gather-send iovcnt buffers in one syscall.
+  /// \pre sfd is already "connected" to an address
+  static ssize_t rv_sendv(SOCKET sfd, const struct iovec *iov, int iovcnt,
+                          int flags = 0) {
+    struct msghdr msg {};
+    msg.msg_iov = const_cast<struct iovec *>(iov);
+    msg.msg_iovlen = iovcnt;
+    return sendmsg(sfd, &msg, flags);
+  }
 };
 
 /// A readable/writable streambuf connected to a socket desriptor.
 /// \todo override peek() using MSG_PEEK
-template <typename SockIO>
+/// \tparam SockIO socket I/O policy, e.g. basic_sockio
+/// \tparam Trace tracing policy, null_trace compiles away
+template <typename SockIO, typename Trace = null_trace>
 class sockbuf : public std::streambuf, private SockIO {
   // return underlying socket descriptor
 public:
@@ -56,9 +136,45 @@ public:
 
   virtual ~sockbuf() {}
 
-  friend class sockstream;
+  template <typename> friend class basic_sockstream;
   friend class ios_base; // sync_with_stdio
 
+  /// Hold back sends until uncork().
+  /// While corked, every flush appends to a gather list instead of calling
+  /// into the socket, so `ss << header << body << std::endl` and any number
+  /// of further messages leave in a single sendmsg().
+  /// On datagram sockets the corked output becomes one datagram.
+  void cork() { m_corked = true; }
+
+  /// Send everything accumulated since cork() and stop corking.
+  /// \return 0 on success, -1 on error (see errno); unsent output is dropped
+  int uncork() {
+    if (!m_corked)
+      return 0;
+
+    stash(pbase(), pptr() - pbase());
+    pbump(-static_cast<int>(pptr() - pbase()));
+    m_corked = false;
+    return send_corked();
+  }
+
+  bool corked() const { return m_corked; }
+
+  /// Queue len bytes at data for sending without copying them into the
+  /// stream buffer. While corked they are sent in place by uncork(), so data
+  /// must stay valid until then; otherwise they are sent immediately after
+  /// any buffered output.
+  /// \return 0 on success, -1 on error
+  int write_ref(const char *data, std::size_t len) {
+    // buffered output goes first, uncorked or not
+    bool corked = m_corked;
+    cork();
+    stash(pbase(), pptr() - pbase());
+    pbump(-static_cast<int>(pptr() - pbase()));
+    m_segments.push_back({data, 0, len});
+    return corked ? 0 : uncork();
+  }
+
 protected:
   /**
    * output
@@ -67,9 +183,16 @@ protected:
   int flushBuffer() {
     auto num = pptr() - pbase();
 
+    if (m_corked) {
+      stash(pbase(), num);
+      pbump(-num);
+      return num;
+    }
+
     if (SockIO::rv_send(m_sockFD, m_buffer, num) != num) {
       return std::char_traits<char>::eof();
     }
+    Trace::record(trace_kind::bytes_sent, m_sockFD, num);
     pbump(-num); // reset put pointer
     return num;
   }
@@ -122,6 +245,7 @@ protected:
     if (num <= 0) {
       return std::char_traits<char>::eof();
     }
+    Trace::record(trace_kind::bytes_received, m_sockFD, num);
 
     // reset buffer ptrs
     setg(m_buffer + (PUTBACK_BUFSZ - numPutback), // start of putback area
@@ -133,21 +257,91 @@ protected:
   }
 
 private:
+  /// Part of the corked output: either len bytes at ref, or len bytes at
+  /// offset in m_cork_buf (which may reallocate until uncork()).
+  struct segment {
+    const char *ref;
+    std::size_t offset;
+    std::size_t len;
+  };
+
+  void stash(const char *data, std::size_t len) {
+    if (!len)
+      return;
+
+    auto offset = m_cork_buf.size();
+    m_cork_buf.insert(m_cork_buf.end(), data, data + len);
+
+    // extend the previous copied segment when contiguous
+    if (!m_segments.empty() && !m_segments.back().ref &&
+        m_segments.back().offset + m_segments.back().len == offset) {
+      m_segments.back().len += len;
+    } else {
+      m_segments.push_back({nullptr, offset, len});
+    }
+  }
+
+  int send_corked() {
+    std::vector<struct iovec> iov;
+    iov.reserve(m_segments.size());
+    for (const auto &seg : m_segments) {
+      auto *base = seg.ref ? seg.ref : m_cork_buf.data() + seg.offset;
+      iov.push_back({const_cast<char *>(base), seg.len});
+    }
+    m_segments.clear();
+
+    int rc = 0;
+    std::size_t first = 0;
+    while (first < iov.size()) {
+      int count = static_cast<int>(
+          std::min<std::size_t>(iov.size() - first, IOV_MAX));
+      bool last = first + count == iov.size();
+
+      // MSG_MORE keeps a batch split at IOV_MAX in one packet or datagram
+      auto sent = SockIO::rv_sendv(m_sockFD, &iov[first], count,
+                                   last ? 0 : MSG_MORE);
+      if (sent < 0) {
+        rc = -1;
+        break;
+      }
+      Trace::record(trace_kind::bytes_sent, m_sockFD, sent);
+
+      // skip what went out; a stream socket may take only part of it
+      while (sent > 0 && first < iov.size()) {
+        auto n = std::min<std::size_t>(sent, iov[first].iov_len);
+        iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + n;
+        iov[first].iov_len -= n;
+        sent -= n;
+        if (iov[first].iov_len == 0)
+          ++first;
+      }
+      while (first < iov.size() && iov[first].iov_len == 0)
+        ++first;
+    }
+
+    m_cork_buf.clear();
+    return rc;
+  }
+
   SOCKET m_sockFD;
   char_type m_buffer[SockIO::BUFLEN];
+  bool m_corked{false};
+  std::vector<char> m_cork_buf;
+  std::vector<segment> m_segments;
 
   /// number of chars allowed in putback buffer
   constexpr static int PUTBACK_BUFSZ = 4;
 };
 
 /// A socket-backed read-writable stream
-class sockstream : public std::iostream {
-  using buf_type = sockbuf<basic_sockio<platform_type>>;
+/// \tparam SockBuf sockbuf instantiation performing the socket I/O
+template <typename SockBuf> class basic_sockstream : public std::iostream {
+  using buf_type = SockBuf;
 
 public:
-  sockstream() = default;
+  basic_sockstream() = default;
 
-  explicit sockstream(SOCKET sd) {
+  explicit basic_sockstream(SOCKET sd) {
     if (sd != INVALID_SOCKET) {
       set_handle(sd);
       this->init(rdbuf());
@@ -157,26 +351,44 @@ public:
   // TODO implement fstream-like path constructor of (Socket)T types
   //	explicit sockstream(const char* path) { }
 
-  virtual ~sockstream() = default;
+  virtual ~basic_sockstream() = default;
 
   // sockstreams are not copyable
-  WASL_NO_COPY(sockstream);
+  WASL_NO_COPY(basic_sockstream);
 
-  sockstream(sockstream &&other) noexcept
+  basic_sockstream(basic_sockstream &&other) noexcept
       : m_sockbuf{std::move(other.m_sockbuf)} {
     this->init(rdbuf());
   }
 
-  sockstream &operator=(sockstream &&other) noexcept {
+  basic_sockstream &operator=(basic_sockstream &&other) noexcept {
     m_sockbuf = std::move(other.m_sockbuf);
     this->init(rdbuf());
     return *this;
   }
 
-  friend SOCKET sockno(const sockstream &);
+  /// Get a sockstream's underlying socket descriptor
+  /// \see fileno()
+  friend SOCKET sockno(const basic_sockstream &sock) {
+    if (sock)
+      return sock._sd();
+    else
+      return INVALID_SOCKET;
+  }
 
   buf_type *rdbuf() const { return m_sockbuf.get(); }
 
+  /// \see sockbuf::cork()
+  void cork() { rdbuf()->cork(); }
+
+  /// Flush and send everything held since cork().
+  /// \see sockbuf::uncork()
+  basic_sockstream &uncork() {
+    if (rdbuf()->uncork() == -1)
+      this->setstate(std::ios::badbit);
+    return *this;
+  }
+
   void set_handle(SOCKET sockfd) {
     assert(sockfd != INVALID_SOCKET);
     if (sockfd == INVALID_SOCKET) {
@@ -195,18 +407,23 @@ private:
   vproxy_ptr<buf_type> m_sockbuf;
 };
 
-/// Get a sockstream's underlying socket descriptor
-/// \see fileno()
-SOCKET sockno(const sockstream &sock) {
-  if (sock)
-    return sock._sd();
-  else
-    return INVALID_SOCKET;
-}
+using sockstream = basic_sockstream<sockbuf<basic_sockio<platform_type>>>;
+
+/// Corks a sockstream or sockbuf for the guard's lifetime, e.g. for one
+/// reactor iteration, and sends the accumulated output when it ends.
+template <typename Corkable> class cork_guard {
+public:
+  explicit cork_guard(Corkable &c) : _c{c} { _c.cork(); }
+  ~cork_guard() { _c.uncork(); }
+  WASL_NO_COPY(cork_guard);
+
+private:
+  Corkable &_c;
+};
 
 /// Open sockstream given a SOCKET descriptor.
 /// \see fdopen()
-std::unique_ptr<sockstream> sdopen(SOCKET sd) {
+inline std::unique_ptr<sockstream> sdopen(SOCKET sd) {
   return std::make_unique<sockstream>(sd);
 }
 
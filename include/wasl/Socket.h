@@ -1,12 +1,16 @@
 #ifndef WASL_SOCKET_H
 #define WASL_SOCKET_H
 
+#include <wasl/Trace.h>
 #include <wasl/Types.h>
 
 #include <gsl/pointers>
 #include <gsl/string_span> // czstring
+#include <memory>
+#include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -20,15 +24,26 @@
 #include <iostream>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <unistd.h>
 #endif
 
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
 namespace wasl {
 namespace ip {
 
+/// Socket paths are filesystem paths for sockaddr_un and "host:port" for
+/// sockaddr_in ("127.0.0.1:9000") and sockaddr_in6 ("[::1]:9000"), where
+/// port 0 binds an ephemeral port.
 template <typename T> struct socket_traits {};
 
 template <> struct socket_traits<struct sockaddr_in> {
@@ -49,7 +64,17 @@ template <> struct socket_traits<struct sockaddr_un> {
   static constexpr int domain = AF_LOCAL;
 };
 
-template <typename SocketNode> struct socket_builder;
+template <typename SocketNode, typename Trace = null_trace>
+struct socket_builder;
+
+/// Remove what a bound socket leaves behind when it closes: the socket file
+/// of a unix domain socket, nothing for other families.
+inline void release_address(const struct sockaddr_un &addr) {
+  if (addr.sun_path[0] != '\0')
+    unlink(addr.sun_path);
+}
+
+template <typename AddrType> void release_address(const AddrType &) {}
 
 template <typename AddrType, int Type,
           typename SockTraits = socket_traits<AddrType>>
@@ -69,8 +94,8 @@ public:
       closesocket(sd);
     }
 
-    // TODO check platform here
-    unlink(_addr.sun_path);
+    if (_owns_address)
+      release_address(_addr);
   }
 
   inline friend constexpr bool is_open(const socket_node &node) noexcept {
@@ -86,21 +111,35 @@ public:
     return node._addr;
   }
 
-  static auto create(path_type spath) {
-    return std::make_unique<socket_builder<type>>(spath);
+  template <typename Trace = null_trace> static auto create(path_type spath) {
+    return std::make_unique<socket_builder<type, Trace>>(spath);
   }
 
 private:
-  friend socket_builder<type>;
+  template <typename, typename> friend struct socket_builder;
 
-  addr_type _addr;           // the underlying socket struct
+  addr_type _addr{};         // the underlying socket struct
   SOCKET sd{INVALID_SOCKET}; // a socket descriptor
+  bool _owns_address{true};  // release _addr on close; not when accepted
 
   /// Construction is enforced through socket_builder to ensure valid
   /// initialization of sockets.
   socket_node() = default;
 };
 
+/// The socket path of addr, the inverse of how builders parse them:
+/// "127.0.0.1:9000", "[::1]:9000" or the file system path.
+std::string address_path(const struct sockaddr_in &addr);
+std::string address_path(const struct sockaddr_in6 &addr);
+std::string address_path(const struct sockaddr_un &addr);
+
+/// Join or leave multicast group on sd outside of a socket_builder.
+/// \param domain AF_INET or AF_INET6
+/// \param iface see socket_builder::join_group()
+/// \return 0 on success, -1 on error (see errno)
+int multicast_membership(SOCKET sd, int domain, gsl::czstring<> group,
+                         gsl::czstring<> iface, bool join);
+
 /// Get a socket's address struct
 /// \tparam AddrType struct type of socket address
 /// \return socket address struct, e.g. struct sockaddr_in
@@ -127,9 +166,13 @@ int socket_connect(const T *node, SOCKET link) {
   return connect(sockno(*node), (SOCKADDR *)&(addr), sizeof(addr));
 }
 
-// todo move impl to cpp and use explicit instantiation for dgrams and streams
-// maintain error state for step-wise error handling
-template <typename SocketNode> struct socket_builder {
+/// Builds a socket_node step by step, keeping the error state of every step
+/// so that a chain can be checked once at its end.
+///
+/// Passive opens chain socket(), bind() and listen(), then accept() builds
+/// each connection; active opens chain socket() and connect().
+/// \tparam Trace tracing policy recording the result of each step
+template <typename SocketNode, typename Trace> struct socket_builder {
   static constexpr int socket_type = SocketNode::socket_type;
   using node_type = SocketNode;
   using sock_traits = socket_traits<typename SocketNode::addr_type>;
@@ -143,6 +186,9 @@ template <typename SocketNode> struct socket_builder {
   // TODO SFINAE or dispatch if family = AF_UNIX/AF_LOCAL
   explicit socket_builder(typename sock_traits::path_type sock_path);
 
+  /// Builder of a node without an address of its own, for accept().
+  socket_builder();
+
   auto get_error() {
 #ifndef NDEBUG
     std::cerr << "wasl error: " << local::toUType(sock_err) << '\n';
@@ -156,6 +202,67 @@ template <typename SocketNode> struct socket_builder {
 
   socket_builder *connect(SOCKET target_sd);
 
+  /// Connect to the address the builder was created with, which is then
+  /// the peer's and left in place when the node closes.
+  socket_builder *connect();
+
+  /// Let several sockets bind the same address (SO_REUSEPORT); the kernel
+  /// spreads connections, or datagrams, across them.
+  /// \pre before bind(); inet or inet6 socket
+  socket_builder *reuse_port() { return option(SOL_SOCKET, SO_REUSEPORT, 1); }
+
+  /// Accept connections, queueing up to backlog not yet accepted.
+  /// \pre bound SOCK_STREAM or SOCK_SEQPACKET socket
+  socket_builder *listen(int backlog = SOMAXCONN);
+
+  /// Take the next connection queued on listener, in place of socket() and
+  /// bind(). The node gets the peer's address but, unlike a bound node,
+  /// leaves it in place when it closes. Flags ERR_ACCEPT on failure, e.g.
+  /// EAGAIN for an empty queue on a non-blocking listener.
+  /// \param flags accept4() flags, e.g. SOCK_NONBLOCK
+  /// \pre built with the default constructor
+  socket_builder *accept(SOCKET listener, int flags = SOCK_CLOEXEC);
+
+  /// setsockopt(level, name, value), flags ERR_SOCKOPT on failure
+  socket_builder *option(int level, int name, int value);
+
+  /// Opt in to UDP GSO: each send of up to 64 segments of gso_size bytes
+  /// crosses into the kernel once and is split there, or by the NIC.
+  /// \pre UDP socket (sockaddr_in/sockaddr_in6, SOCK_DGRAM)
+  socket_builder *udp_segment(uint16_t gso_size) {
+    return option(SOL_UDP, UDP_SEGMENT, gso_size);
+  }
+
+  /// Opt in to UDP GRO: consecutive datagrams of one flow may be received
+  /// as one super-packet, see udp_recv_gro().
+  /// \pre UDP socket (sockaddr_in/sockaddr_in6, SOCK_DGRAM)
+  socket_builder *udp_gro() { return option(SOL_UDP, UDP_GRO, 1); }
+
+  /// Stamp every received message with its kernel arrival time
+  /// (SO_TIMESTAMPNS), see basic_sockio::rv_recv_stamped().
+  socket_builder *timestamps() {
+    return option(SOL_SOCKET, SO_TIMESTAMPNS, 1);
+  }
+
+  /// Join multicast group, e.g. "239.192.0.1" or "ff15::1".
+  /// \param iface local interface: its address for INET ("127.0.0.1"), its
+  /// name for INET6 ("lo"); nullptr lets the kernel choose
+  socket_builder *join_group(gsl::czstring<> group,
+                             gsl::czstring<> iface = nullptr);
+
+  /// Leave a group joined with join_group().
+  socket_builder *leave_group(gsl::czstring<> group,
+                              gsl::czstring<> iface = nullptr);
+
+  /// Hop limit of outgoing multicast, 1 (this subnet) by default.
+  socket_builder *multicast_ttl(int hops);
+
+  /// Whether outgoing multicast is delivered to this host's own members.
+  socket_builder *multicast_loop(bool enable);
+
+  /// Send multicast through iface, see join_group().
+  socket_builder *multicast_interface(gsl::czstring<> iface);
+
   explicit operator bool() const {
     return !local::toUType(sock_err) && is_open(*sock);
   }
@@ -168,17 +275,14 @@ template <typename SocketNode> struct socket_builder {
 };
 
 /// create a unique_ptr to a socket_node
-/// TODO add overloads for:
-/// passive_opens (e.g., TCP servers) adding listen() to builder chain
-/// active opens (e.g., client sockets) adding connect() to builder chain
-/// see Stevens UNPp34
+/// \see make_listener() and make_connection() for passive and active opens
 /// \tparam AddType Any of struct addr_x socket types e.g.: { sockaddr_un,
 /// sockaddr_in, ...} \tparam SockType type of socket used in socket() call: {
 /// SOCK_STREAM, SOCK_DGRAM, SOCK_RAW, ...}
-template <typename AddrType, int SockType,
+template <typename AddrType, int SockType, typename Trace = null_trace,
           typename sock_traits = socket_traits<AddrType>>
 auto make_socket(typename sock_traits::path_type sock_path) {
-  auto socket{socket_node<AddrType, SockType>::create(sock_path)
+  auto socket{socket_node<AddrType, SockType>::template create<Trace>(sock_path)
                   ->socket()
                   ->bind()
                   ->build()};
@@ -190,7 +294,93 @@ auto make_socket(typename sock_traits::path_type sock_path) {
   return std::unique_ptr<socket_node<AddrType, SockType>>(std::move(socket));
 }
 
+/// Create a socket_node listening at sock_path.
+/// \param reuse_port bind with SO_REUSEPORT, see make_reuseport_listeners()
+/// \tparam SockType SOCK_STREAM or SOCK_SEQPACKET
+/// \return the listener, or nullptr on error (see errno)
+template <typename AddrType, int SockType, typename Trace = null_trace,
+          typename sock_traits = socket_traits<AddrType>>
+auto make_listener(typename sock_traits::path_type sock_path,
+                   int backlog = SOMAXCONN, bool reuse_port = false) {
+  using node_type = socket_node<AddrType, SockType>;
+  auto builder{node_type::template create<Trace>(sock_path)};
+  builder->socket();
+  if (reuse_port)
+    builder->reuse_port();
+  builder->bind()->listen(backlog);
+
+  std::unique_ptr<node_type> node{builder->build()};
+  if (!*builder) {
+    auto err = GET_SOCKERRNO();
+    node.reset();
+    errno = err;
+  }
+  return node;
+}
+
+/// Create listeners of one address, one per reactor shard, bound with
+/// SO_REUSEPORT so that the kernel spreads incoming connections across
+/// them. A port of 0 picks one ephemeral port for all of them.
+/// \return count listeners, or none on error (see errno)
+template <typename AddrType, int SockType = SOCK_STREAM,
+          typename Trace = null_trace>
+std::vector<std::unique_ptr<socket_node<AddrType, SockType>>>
+make_reuseport_listeners(gsl::czstring<> sock_path, std::size_t count,
+                         int backlog = SOMAXCONN) {
+  std::vector<std::unique_ptr<socket_node<AddrType, SockType>>> listeners;
+  std::string path = sock_path;
+  for (std::size_t i = 0; i < count; ++i) {
+    auto node{make_listener<AddrType, SockType, Trace>(path.c_str(), backlog,
+                                                       true)};
+    if (!node)
+      return {};
+    if (i == 0)
+      path = address_path(get_address<AddrType>(sockno(*node)));
+    listeners.push_back(std::move(node));
+  }
+  return listeners;
+}
+
+/// Create a socket_node connected to the listener at sock_path.
+/// \return the connection, or nullptr on error (see errno)
+template <typename AddrType, int SockType, typename Trace = null_trace,
+          typename sock_traits = socket_traits<AddrType>>
+auto make_connection(typename sock_traits::path_type sock_path) {
+  using node_type = socket_node<AddrType, SockType>;
+  auto builder{node_type::template create<Trace>(sock_path)};
+  builder->socket()->connect();
+
+  std::unique_ptr<node_type> node{builder->build()};
+  if (!*builder) {
+    auto err = GET_SOCKERRNO();
+    node.reset();
+    errno = err;
+  }
+  return node;
+}
+
+/// Accept the next connection on listener.
+/// \return the connection, or nullptr on error (see errno)
+template <typename Node, typename Trace = null_trace>
+std::unique_ptr<Node> accept_socket(SOCKET listener,
+                                    int flags = SOCK_CLOEXEC) {
+  socket_builder<Node, Trace> builder;
+  if (!*builder.accept(listener, flags)) {
+    delete builder.build();
+    return nullptr;
+  }
+  return std::unique_ptr<Node>(builder.build());
+}
+
 using socket_dgram_local = socket_node<struct sockaddr_un, SOCK_DGRAM>;
+using socket_dgram_udp = socket_node<struct sockaddr_in, SOCK_DGRAM>;
+using socket_dgram_udp6 = socket_node<struct sockaddr_in6, SOCK_DGRAM>;
+using socket_stream_local = socket_node<struct sockaddr_un, SOCK_STREAM>;
+using socket_stream_tcp = socket_node<struct sockaddr_in, SOCK_STREAM>;
+using socket_stream_tcp6 = socket_node<struct sockaddr_in6, SOCK_STREAM>;
+/// Reliable, ordered and message-preserving local connections: read them
+/// with a dgram_sockstream.
+using socket_seqpacket_local = socket_node<struct sockaddr_un, SOCK_SEQPACKET>;
 
 } // namespace ip
 } // namespace wasl
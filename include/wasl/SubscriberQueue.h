@@ -0,0 +1,286 @@
+#ifndef WASL_SUBSCRIBERQUEUE_H
+#define WASL_SUBSCRIBERQUEUE_H
+
+#include <wasl/Metrics.h>
+#include <wasl/SockStream.h>
+#include <wasl/Types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <poll.h>
+
+namespace wasl {
+namespace ip {
+
+/// What a bounded_queue does with a value that does not fit.
+enum class overflow_policy : uint8_t {
+  BLOCK,       // refuse it; the producer waits for room
+  DROP_OLDEST, // evict the head to make room
+  DROP_NEWEST, // discard the new value
+  CONFLATE,    // keep only the latest value per key, else drop the oldest
+};
+
+/// Counters of a bounded_queue, readable from any thread.
+struct queue_stats {
+  stat_counter enqueued;
+  stat_counter dequeued;
+  stat_counter dropped_oldest;
+  stat_counter dropped_newest;
+  stat_counter conflated; // values replaced by a newer one of the same key
+  stat_counter blocked;   // pushes refused under BLOCK
+  stat_counter blocked_ns;
+  stat_counter high_water; // largest size reached
+};
+
+/// FIFO of at most capacity values with a selectable overflow policy.
+///
+/// Under CONFLATE a value whose key is already queued replaces the queued
+/// value in place, keeping its position, so a slow reader sees the latest
+/// state of every key instead of a backlog of stale updates.
+///
+/// A head held with hold_front() is never replaced: eviction takes the
+/// entry behind it, and a value of its key is queued as a new entry.
+///
+/// \tparam T value type
+/// \tparam Key conflation key, hashable
+template <typename T, typename Key = uint64_t> class bounded_queue {
+public:
+  enum class push_result { QUEUED, CONFLATED, DROPPED_OLDEST, DROPPED, FULL };
+
+  bounded_queue(std::size_t capacity, overflow_policy policy)
+      : _capacity{capacity ? capacity : 1}, _policy{policy} {}
+
+  /// Queue value, applying the overflow policy if the queue is full.
+  /// \return FULL only under BLOCK, in which case value is left untouched
+  template <typename U> push_result push(U &&value, Key key = Key{}) {
+    if (_policy == overflow_policy::CONFLATE) {
+      auto it = _positions.find(key);
+      if (it != _positions.end() && !(_held && it->second == _head)) {
+        _entries[it->second - _head].value = std::forward<U>(value);
+        _stats.conflated.add();
+        return push_result::CONFLATED;
+      }
+    }
+
+    auto result = push_result::QUEUED;
+    if (full()) {
+      switch (_policy) {
+      case overflow_policy::BLOCK:
+        _stats.blocked.add();
+        return push_result::FULL;
+      case overflow_policy::DROP_NEWEST:
+        _stats.dropped_newest.add();
+        return push_result::DROPPED;
+      case overflow_policy::DROP_OLDEST:
+      case overflow_policy::CONFLATE:
+        if (_held && _entries.size() < 2) {
+          // nothing but the held head to evict
+          _stats.dropped_newest.add();
+          return push_result::DROPPED;
+        }
+        if (_held)
+          discard_second();
+        else
+          discard_front();
+        _stats.dropped_oldest.add();
+        result = push_result::DROPPED_OLDEST;
+        break;
+      }
+    }
+
+    if (_policy == overflow_policy::CONFLATE)
+      _positions[key] = _head + _entries.size();
+    _entries.push_back({std::move(key), T(std::forward<U>(value))});
+    _stats.enqueued.add();
+    if (_entries.size() > _stats.high_water.get())
+      _stats.high_water.set(_entries.size());
+    return result;
+  }
+
+  /// \pre !empty()
+  T &front() { return _entries.front().value; }
+
+  /// \pre !empty()
+  void pop() {
+    discard_front();
+    _held = false;
+    _stats.dequeued.add();
+  }
+
+  /// Keep the head from being evicted or replaced until pop(), e.g. while
+  /// it is partly sent.
+  /// \pre !empty()
+  void hold_front() { _held = true; }
+
+  bool empty() const { return _entries.empty(); }
+  bool full() const { return _entries.size() >= _capacity; }
+  std::size_t size() const { return _entries.size(); }
+  std::size_t capacity() const { return _capacity; }
+  overflow_policy policy() const { return _policy; }
+
+  queue_stats &stats() { return _stats; }
+  const queue_stats &stats() const { return _stats; }
+
+private:
+  struct entry {
+    Key key;
+    T value;
+  };
+
+  void discard_front() {
+    if (_policy == overflow_policy::CONFLATE) {
+      auto it = _positions.find(_entries.front().key);
+      if (it != _positions.end() && it->second == _head)
+        _positions.erase(it);
+    }
+    _entries.pop_front();
+    ++_head;
+  }
+
+  /// Evict the entry behind the head, moving the head into its place.
+  /// \pre size() >= 2
+  void discard_second() {
+    if (_policy == overflow_policy::CONFLATE) {
+      auto it = _positions.find(_entries[1].key);
+      if (it != _positions.end() && it->second == _head + 1)
+        _positions.erase(it);
+      it = _positions.find(_entries.front().key);
+      if (it != _positions.end() && it->second == _head)
+        it->second = _head + 1;
+    }
+    _entries[1] = std::move(_entries.front());
+    _entries.pop_front();
+    ++_head;
+  }
+
+  std::size_t _capacity;
+  overflow_policy _policy;
+  std::deque<entry> _entries;
+  uint64_t _head{0}; // absolute index of _entries.front()
+  bool _held{false}; // the head is not to be evicted or replaced
+  std::unordered_map<Key, uint64_t> _positions; // CONFLATE: key -> index
+  queue_stats _stats;
+};
+
+/// Bounded outbound queue of messages for one subscriber's socket.
+///
+/// publish() never waits on the socket unless the policy is BLOCK: messages
+/// the socket cannot take right away are queued, and once attached to a
+/// reactor the queue drains as the socket becomes writable. A slow
+/// subscriber thus only ever costs its own queue, which stays bounded.
+///
+/// \tparam SockIO socket I/O policy, e.g. basic_sockio
+template <typename SockIO = basic_sockio<platform_type>>
+class subscriber_queue {
+public:
+  subscriber_queue(SOCKET sd, std::size_t capacity, overflow_policy policy)
+      : _sd{sd}, _queue{capacity, policy} {}
+
+  WASL_NO_COPY(subscriber_queue);
+
+  /// Queue msg and send what the socket accepts without blocking.
+  /// Under BLOCK, waits for the socket while the queue is full.
+  /// \return false if msg was dropped or the socket failed
+  bool publish(std::string msg, uint64_t key = 0) {
+    using result = typename bounded_queue<std::string>::push_result;
+
+    auto rc = _queue.push(std::move(msg), key);
+    if (rc == result::FULL) {
+      if (!wait_for_room())
+        return false;
+      rc = _queue.push(std::move(msg), key); // msg was left untouched
+    }
+
+    if (flush() < 0)
+      return false;
+    return rc != result::DROPPED;
+  }
+
+  /// Send queued messages until the socket would block.
+  /// \return messages sent, or -1 on a socket error (see errno)
+  ssize_t flush() {
+    ssize_t sent = 0;
+    while (!_queue.empty()) {
+      auto &msg = _queue.front();
+      auto n = SockIO::rv_send(_sd, &msg[_offset], msg.size() - _offset,
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+        return -1;
+      }
+
+      // stream sockets may take part of a message; the rest must follow
+      // as it is, or the peer loses the framing
+      _offset += n;
+      if (_offset < msg.size()) {
+        _queue.hold_front();
+        break;
+      }
+
+      _offset = 0;
+      _queue.pop();
+      ++sent;
+    }
+
+    if (_watch)
+      _watch(!_queue.empty());
+    return sent;
+  }
+
+  /// Drain from mux: watch the socket for output while messages are queued.
+  /// \pre sd was added to mux
+  template <typename Mux> void attach(Mux &mux) {
+    _watch = [this, &mux](bool pending) {
+      if (pending == _watching)
+        return;
+      _watching = pending;
+      if (pending)
+        mux.watch_writable(_sd, [this](SOCKET) { flush(); });
+      else
+        mux.unwatch_writable(_sd);
+    };
+    _watch(!_queue.empty());
+  }
+
+  std::size_t pending() const { return _queue.size(); }
+  const queue_stats &stats() const { return _queue.stats(); }
+  overflow_policy policy() const { return _queue.policy(); }
+
+  friend SOCKET sockno(const subscriber_queue &q) { return q._sd; }
+
+private:
+  /// BLOCK: wait until the socket takes at least the head message.
+  bool wait_for_room() {
+    auto start = std::chrono::steady_clock::now();
+    struct pollfd pfd {
+      _sd, POLLOUT, 0
+    };
+    while (_queue.full()) {
+      if (poll(&pfd, 1, -1) < 0 || flush() < 0)
+        return false;
+    }
+    _queue.stats().blocked_ns.add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    return true;
+  }
+
+  SOCKET _sd;
+  bounded_queue<std::string> _queue;
+  std::size_t _offset{0}; // bytes of the head message already sent
+  std::function<void(bool)> _watch;
+  bool _watching{false};
+};
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_SUBSCRIBERQUEUE_H */
@@ -0,0 +1,71 @@
+#ifndef WASL_TASKQUEUE_H
+#define WASL_TASKQUEUE_H
+
+#include <wasl/Types.h>
+
+#include <atomic>
+#include <utility>
+
+namespace wasl {
+
+/// Unbounded lock-free multi-producer single-consumer queue.
+///
+/// Producers never block or retry: push() is one atomic exchange and one
+/// store. The consumer owns a dummy node whose successor holds the next
+/// value (Vyukov's intrusive MPSC design).
+///
+/// \tparam T default constructible, movable value type
+template <typename T> class mpsc_queue {
+  struct node {
+    std::atomic<node *> next{nullptr};
+    T value;
+  };
+
+public:
+  mpsc_queue() : _head{new node}, _tail{_head.load()} {}
+
+  ~mpsc_queue() {
+    while (_tail) {
+      auto *next = _tail->next.load(std::memory_order_relaxed);
+      delete _tail;
+      _tail = next;
+    }
+  }
+
+  WASL_NO_COPY(mpsc_queue);
+
+  /// Safe to call from any thread.
+  void push(T value) {
+    auto *n = new node;
+    n->value = std::move(value);
+    auto *prev = _head.exchange(n, std::memory_order_acq_rel);
+    prev->next.store(n, std::memory_order_release);
+  }
+
+  /// Consumer only.
+  /// \return false if the queue is empty or the next producer has not
+  /// finished linking its node yet, see idle().
+  bool pop(T &out) {
+    auto *next = _tail->next.load(std::memory_order_acquire);
+    if (!next)
+      return false;
+
+    out = std::move(next->value);
+    next->value = T{};
+    delete _tail;
+    _tail = next;
+    return true;
+  }
+
+  /// Consumer only.
+  /// \return true if no push is pending, i.e. a failed pop() meant empty.
+  bool idle() const { return _head.load(std::memory_order_acquire) == _tail; }
+
+private:
+  std::atomic<node *> _head; // producers' end
+  node *_tail;               // consumer's dummy node
+};
+
+} // namespace wasl
+
+#endif /* WASL_TASKQUEUE_H */
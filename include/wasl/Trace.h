@@ -0,0 +1,115 @@
+#ifndef WASL_TRACE_H
+#define WASL_TRACE_H
+
+#include <wasl/Common.h>
+#include <wasl/Types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include <gsl/string_span> // czstring
+
+namespace wasl {
+namespace ip {
+
+enum class trace_kind : uint16_t {
+  fd_ready = 1,   // muxer reported fd ready
+  handler_begin,  // event handler entered
+  handler_end,    // event handler returned
+  bytes_sent,     // arg: number of bytes
+  bytes_received, // arg: number of bytes
+  sock_open,      // arg: errno, 0 on success
+  sock_bind,      // arg: errno, 0 on success
+  sock_connect,   // arg: errno, 0 on success
+  sock_option,    // arg: errno, 0 on success
+  sock_listen,    // arg: errno, 0 on success
+  sock_accept,    // arg: errno, 0 on success
+};
+
+/// Fixed-size binary trace record as stored in rings and trace files.
+struct trace_record {
+  uint64_t ts_ns; // steady clock
+  uint64_t arg;
+  uint32_t tid;
+  int32_t fd;
+  uint16_t kind;
+  uint16_t reserved[3];
+};
+static_assert(sizeof(trace_record) == 32, "trace_record layout changed");
+
+/// Tracing policy that records nothing.
+/// Every call is an empty inline function, so traced code paths compile to
+/// the same instructions as untraced ones.
+struct null_trace {
+  static constexpr bool enabled = false;
+
+  static void record(trace_kind, SOCKET, uint64_t = 0) noexcept {}
+};
+
+/// Single-producer ring of trace records owned by one thread.
+/// The owning thread never blocks; old records are overwritten once the ring
+/// wraps.
+class trace_ring {
+public:
+  static constexpr std::size_t capacity = 1 << 14; // power of two
+
+  explicit trace_ring(uint32_t tid) : _tid{tid} {}
+  WASL_NO_COPY(trace_ring);
+
+  void push(trace_kind kind, SOCKET fd, uint64_t arg, uint64_t ts) noexcept {
+    auto head = _head.load(std::memory_order_relaxed);
+    auto &rec = _records[head & (capacity - 1)];
+    rec.ts_ns = ts;
+    rec.arg = arg;
+    rec.tid = _tid;
+    rec.fd = fd;
+    rec.kind = static_cast<uint16_t>(kind);
+    _head.store(head + 1, std::memory_order_release);
+  }
+
+  /// Append the records still held by the ring to out, oldest first.
+  /// Records overwritten while copying are dropped; for an exact copy read
+  /// while the owning thread is quiescent.
+  void read(std::vector<trace_record> &out) const;
+
+private:
+  uint32_t _tid;
+  std::atomic<uint64_t> _head{0};
+  trace_record _records[capacity];
+};
+
+/// Tracing policy writing into a lock-free ring per thread.
+/// Rings outlive their threads so dump() sees every thread that traced.
+struct ring_trace {
+  static constexpr bool enabled = true;
+
+  static void record(trace_kind kind, SOCKET fd, uint64_t arg = 0) noexcept {
+    static thread_local trace_ring *ring = register_thread();
+    ring->push(kind, fd, arg, now_ns());
+  }
+
+  /// Write the records of all rings to a binary trace file.
+  /// \see trace_to_chrome_json()
+  /// \return false on I/O error, see errno
+  static bool dump(gsl::czstring<> path);
+
+  /// All records of all rings, ordered by timestamp.
+  static std::vector<trace_record> collect();
+
+private:
+  static trace_ring *register_thread();
+  static uint64_t now_ns() noexcept;
+};
+
+/// Convert a binary trace file written by ring_trace::dump() into Chrome
+/// trace-event JSON, loadable by chrome://tracing or Perfetto.
+/// \return false if in is not a trace file
+bool trace_to_chrome_json(std::istream &in, std::ostream &out);
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_TRACE_H */
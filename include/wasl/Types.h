@@ -1,6 +1,8 @@
 #ifndef WASL_TYPES_H
 #define WASL_TYPES_H
 
+#include <wasl/Common.h>
+
 #include <memory>
 #include <type_traits>
 
@@ -106,7 +108,9 @@ enum class SockError : uint32_t {
   ERR_BIND = 0x2,
   ERR_CONNECT = 0x4,
   ERR_LISTEN = 0x8,
-  ERR_PATH_INVAL = 0x10
+  ERR_PATH_INVAL = 0x10,
+  ERR_SOCKOPT = 0x20,
+  ERR_ACCEPT = 0x40
 };
 
 WASL_MARK_AS_BITMASK_ENUM(SockError);
@@ -0,0 +1,107 @@
+#ifndef WASL_UDP_H
+#define WASL_UDP_H
+
+#include <wasl/Peer.h>
+#include <wasl/Socket.h>
+
+#include <gsl/span>
+
+#include <cstdint>
+#include <cstring>
+
+namespace wasl {
+namespace ip {
+
+/// Most segments the kernel accepts in one GSO send (UDP_MAX_SEGMENTS).
+constexpr std::size_t udp_max_segments = 64;
+
+/// Send buf as consecutive datagrams of segment bytes each, the last one
+/// possibly shorter, in a single syscall using UDP GSO.
+///
+/// Works without the udp_segment() builder step: the segment size is passed
+/// per call. buf may hold at most udp_max_segments segments and 64KiB.
+/// \param to destination, or nullptr on a connected socket
+/// \return bytes sent, or -1 on error (see errno)
+inline ssize_t udp_send_segmented(SOCKET sfd, gsl::span<const char> buf,
+                                  uint16_t segment,
+                                  const peer_address *to = nullptr) {
+  struct iovec iov {
+    const_cast<char *>(buf.data()), static_cast<std::size_t>(buf.size())
+  };
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+
+  struct msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (to) {
+    msg.msg_name = const_cast<struct sockaddr *>(to->get());
+    msg.msg_namelen = to->len;
+  }
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  auto *cm = CMSG_FIRSTHDR(&msg);
+  cm->cmsg_level = SOL_UDP;
+  cm->cmsg_type = UDP_SEGMENT;
+  cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  memcpy(CMSG_DATA(cm), &segment, sizeof(segment));
+
+  return sendmsg(sfd, &msg, 0);
+}
+
+/// Receive a datagram or, on a socket built with udp_gro(), a GRO
+/// super-packet of several same-sized datagrams.
+/// \param[out] segment size of each datagram in buf (the last one may be
+/// shorter); equals the return value when nothing was coalesced
+/// \param[out] from source address, if not nullptr
+/// \return bytes received, or -1 on error (see errno)
+inline ssize_t udp_recv_gro(SOCKET sfd, gsl::span<char> buf, int &segment,
+                            peer_address *from = nullptr, int flags = 0) {
+  struct iovec iov {
+    buf.data(), static_cast<std::size_t>(buf.size())
+  };
+  alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+  struct msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (from) {
+    msg.msg_name = from->get();
+    msg.msg_namelen = sizeof(from->addr);
+  }
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  auto n = recvmsg(sfd, &msg, flags);
+  if (n < 0)
+    return n;
+
+  if (from)
+    from->len = msg.msg_namelen;
+
+  segment = static_cast<int>(n);
+  for (auto *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+    if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+      memcpy(&segment, CMSG_DATA(cm), sizeof(segment));
+  }
+  return n;
+}
+
+/// Call fn(const char *data, std::size_t len) for each datagram of a
+/// buffer filled by udp_recv_gro().
+template <typename Fn>
+void for_each_segment(const char *buf, std::size_t len, int segment, Fn fn) {
+  if (segment <= 0)
+    return;
+
+  for (std::size_t off = 0; off < len; off += segment) {
+    auto n = len - off < static_cast<std::size_t>(segment) ? len - off
+                                                            : segment;
+    fn(buf + off, n);
+  }
+}
+
+} // namespace ip
+} // namespace wasl
+
+#endif /* WASL_UDP_H */
@@ -0,0 +1,241 @@
+#include <wasl/Capture.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wasl {
+namespace ip {
+
+constexpr char capture_file::magic[4];
+constexpr uint32_t capture_file::version;
+constexpr std::size_t capture_file::header_size;
+
+namespace {
+
+struct capture_file_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t reserved;
+};
+static_assert(sizeof(capture_file_header) == capture_file::header_size,
+              "capture_file_header layout changed");
+
+constexpr std::size_t record_span(std::size_t len) {
+  return (sizeof(capture_record) + len + 7) & ~std::size_t{7};
+}
+
+} // namespace
+
+capture_file::capture_file(gsl::czstring<> path, std::size_t capacity)
+    : _capacity{capacity < header_size ? header_size : capacity} {
+  // a new file rather than a truncated one, which readers of the previous
+  // capture may still have mapped
+  unlink(path);
+  _fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (_fd == -1)
+    return;
+
+  if (ftruncate(_fd, _capacity) == 0) {
+    auto *p = mmap(nullptr, _capacity, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   _fd, 0);
+    if (p != MAP_FAILED)
+      _base = static_cast<char *>(p);
+  }
+
+  if (!_base) {
+    close(_fd);
+    _fd = -1;
+    return;
+  }
+
+  capture_file_header header{};
+  memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.record_size = sizeof(capture_record);
+  memcpy(_base, &header, sizeof(header));
+}
+
+capture_file::~capture_file() {
+  if (_base)
+    munmap(_base, _capacity);
+  // the file keeps its capacity: truncating it would fault readers that
+  // mapped all of it, and the unused tail is sparse zeros they stop at
+  if (_fd != -1)
+    close(_fd);
+}
+
+std::size_t capture_file::size() const noexcept {
+  auto tail = _tail.load(std::memory_order_relaxed);
+  return tail < _capacity ? tail : _capacity;
+}
+
+void capture_file::set_topic(SOCKET fd, uint32_t topic) noexcept {
+  if (fd >= 0 && fd < reactor_stats::max_tracked_fds)
+    _topics[fd].store(topic, std::memory_order_relaxed);
+}
+
+uint32_t capture_file::topic(SOCKET fd) const noexcept {
+  if (fd >= 0 && fd < reactor_stats::max_tracked_fds)
+    return _topics[fd].load(std::memory_order_relaxed);
+  return 0;
+}
+
+capture_record *capture_file::reserve(SOCKET fd, capture_dir dir,
+                                      std::size_t len,
+                                      uint64_t time_ns) noexcept {
+  // a zero length would read as the end of the capture
+  if (len == 0)
+    return nullptr;
+  if (!_base || len > UINT32_MAX) {
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  auto span = record_span(len);
+  auto off = _tail.fetch_add(span, std::memory_order_relaxed);
+  if (off + span > _capacity) {
+    // later records cannot fit either: the capture ends at off
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  auto *rec = reinterpret_cast<capture_record *>(_base + off);
+  rec->time_ns = time_ns ? time_ns : realtime_ns();
+  rec->fd = fd;
+  rec->topic = topic(fd);
+  rec->dir = static_cast<uint8_t>(dir);
+  return rec;
+}
+
+void capture_file::publish(capture_record *rec, std::size_t len) noexcept {
+  // readers stop at a zero length, so it is written last
+  __atomic_store_n(&rec->length, static_cast<uint32_t>(len), __ATOMIC_RELEASE);
+  _records.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool capture_file::append(SOCKET fd, capture_dir dir, const char *data,
+                          std::size_t len, uint64_t time_ns) noexcept {
+  auto *rec = reserve(fd, dir, len, time_ns);
+  if (!rec)
+    return false;
+
+  memcpy(rec + 1, data, len);
+  publish(rec, len);
+  return true;
+}
+
+bool capture_file::appendv(SOCKET fd, capture_dir dir,
+                           const struct iovec *iov, int iovcnt,
+                           std::size_t len, uint64_t time_ns) noexcept {
+  auto *rec = reserve(fd, dir, len, time_ns);
+  if (!rec)
+    return false;
+
+  auto *out = reinterpret_cast<char *>(rec + 1);
+  std::size_t copied = 0;
+  for (int i = 0; i < iovcnt && copied < len; ++i) {
+    auto n = iov[i].iov_len < len - copied ? iov[i].iov_len : len - copied;
+    memcpy(out + copied, iov[i].iov_base, n);
+    copied += n;
+  }
+  publish(rec, len);
+  return true;
+}
+
+capture_reader::capture_reader(gsl::czstring<> path) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<std::size_t>(st.st_size) >= capture_file::header_size) {
+    auto *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+      _base = static_cast<const char *>(p);
+      _size = st.st_size;
+    }
+  }
+  close(fd);
+
+  if (!_base)
+    return;
+
+  capture_file_header header;
+  memcpy(&header, _base, sizeof(header));
+  if (memcmp(header.magic, capture_file::magic, sizeof(header.magic)) != 0 ||
+      header.version != capture_file::version ||
+      header.record_size != sizeof(capture_record)) {
+    munmap(const_cast<char *>(_base), _size);
+    _base = nullptr;
+    errno = EPROTO;
+  }
+}
+
+capture_reader::~capture_reader() {
+  if (_base)
+    munmap(const_cast<char *>(_base), _size);
+}
+
+std::size_t capture_reader::next(std::size_t off,
+                                 const capture_record **rec) const {
+  *rec = nullptr;
+  if (off + sizeof(capture_record) > _size)
+    return off;
+
+  auto *r = reinterpret_cast<const capture_record *>(_base + off);
+  auto len = __atomic_load_n(&r->length, __ATOMIC_ACQUIRE);
+  if (!len || off + record_span(len) > _size)
+    return off;
+
+  *rec = r;
+  return off + record_span(len);
+}
+
+std::size_t replay(const capture_reader &capture, const replay_options &options,
+                   const replay_fn &send) {
+  using clock = std::chrono::steady_clock;
+
+  std::size_t sent = 0;
+  bool stopped = false;
+  uint64_t first_ns = 0;
+  clock::time_point start;
+
+  capture.for_each([&](const capture_record &rec,
+                       gsl::span<const char> payload) {
+    if (stopped || rec.dir != static_cast<uint8_t>(options.dir) ||
+        (options.fd != INVALID_SOCKET && rec.fd != options.fd) ||
+        (options.topic && rec.topic != options.topic))
+      return;
+
+    if (!first_ns) {
+      first_ns = rec.time_ns;
+      start = clock::now();
+    }
+    if (options.speed > 0 && rec.time_ns > first_ns) {
+      auto offset_ns = static_cast<double>(rec.time_ns - first_ns) /
+                       options.speed;
+      std::this_thread::sleep_until(
+          start + std::chrono::nanoseconds(static_cast<int64_t>(offset_ns)));
+    }
+
+    if (!send(rec, payload)) {
+      stopped = true;
+      return;
+    }
+    ++sent;
+  });
+
+  return sent;
+}
+
+} // namespace ip
+} // namespace wasl
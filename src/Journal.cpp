@@ -0,0 +1,442 @@
+#include <wasl/Journal.h>
+#include <wasl/Metrics.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define WASL_CRC32C_SSE42 1
+#endif
+
+namespace wasl {
+namespace ip {
+
+namespace {
+
+/// Reflected Castagnoli polynomial.
+constexpr uint32_t crc32c_poly = 0x82f63b78;
+
+struct crc32c_table {
+  uint32_t entries[256];
+
+  crc32c_table() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit)
+        crc = crc & 1 ? (crc >> 1) ^ crc32c_poly : crc >> 1;
+      entries[i] = crc;
+    }
+  }
+};
+
+uint32_t crc32c_bytes(uint32_t crc, const unsigned char *p, std::size_t len) {
+  static const crc32c_table table;
+  while (len--)
+    crc = table.entries[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#ifdef WASL_CRC32C_SSE42
+__attribute__((target("sse4.2"))) uint32_t
+crc32c_sse42(uint32_t crc, const unsigned char *p, std::size_t len) {
+#ifdef __x86_64__
+  uint64_t crc64 = crc;
+  for (; len >= 8; len -= 8, p += 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = static_cast<uint32_t>(crc64);
+#endif
+  for (; len >= 4; len -= 4, p += 4) {
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    crc = _mm_crc32_u32(crc, word);
+  }
+  while (len--)
+    crc = _mm_crc32_u8(crc, *p++);
+  return crc;
+}
+#endif
+
+using crc32c_fn = uint32_t (*)(uint32_t, const unsigned char *, std::size_t);
+
+crc32c_fn select_crc32c() {
+#ifdef WASL_CRC32C_SSE42
+  if (__builtin_cpu_supports("sse4.2"))
+    return crc32c_sse42;
+#endif
+  return crc32c_bytes;
+}
+
+crc32c_fn crc32c_impl() {
+  static const crc32c_fn impl = select_crc32c();
+  return impl;
+}
+
+/// crc32c() of the fields in front of journal_record::crc and the payload.
+uint32_t record_crc(const journal_record &rec, const char *payload) {
+  auto crc = crc32c(&rec, offsetof(journal_record, crc));
+  return crc32c(payload, rec.length, crc);
+}
+
+std::string segment_name(uint64_t base) {
+  char name[32];
+  snprintf(name, sizeof(name), "%020" PRIu64 ".log", base);
+  return name;
+}
+
+/// Base offset of a segment file name, false for other files.
+bool parse_segment_name(const char *name, uint64_t &base) {
+  char *end;
+  errno = 0;
+  auto value = strtoull(name, &end, 10);
+  if (errno || end != name + 20 || strcmp(end, ".log") != 0)
+    return false;
+  base = value;
+  return true;
+}
+
+} // namespace
+
+uint32_t crc32c(const void *data, std::size_t len, uint32_t crc) noexcept {
+  return ~crc32c_impl()(~crc, static_cast<const unsigned char *>(data), len);
+}
+
+uint32_t crc32c_portable(const void *data, std::size_t len,
+                         uint32_t crc) noexcept {
+  return ~crc32c_bytes(~crc, static_cast<const unsigned char *>(data), len);
+}
+
+bool crc32c_accelerated() noexcept { return crc32c_impl() != crc32c_bytes; }
+
+bool journal_verify(const journal_record &rec) noexcept {
+  return record_crc(rec, reinterpret_cast<const char *>(&rec + 1)) == rec.crc;
+}
+
+/// A mapped segment file. Only the newest one is appended to; older ones
+/// are sealed, truncated to the records they hold.
+struct journal::segment {
+  uint64_t base{0};
+  std::string path;
+  int fd{-1};
+  char *map{nullptr};
+  std::size_t capacity{0};     // bytes mapped
+  std::size_t used{0};         // bytes of complete records
+  std::vector<uint32_t> index; // position of each record
+  uint64_t last_time_ns{0};    // time of the newest record
+  bool sealed{false};
+
+  ~segment() {
+    if (map)
+      munmap(map, capacity);
+    if (fd != -1)
+      close(fd);
+  }
+
+  uint64_t end() const { return base + index.size(); }
+
+  /// Whether pos is where a record starts, or past the last one.
+  bool at_record(std::size_t pos) const {
+    return pos >= used || std::binary_search(index.begin(), index.end(),
+                                             static_cast<uint32_t>(pos));
+  }
+
+  /// Truncate the file to its records; they remain mapped.
+  void seal() {
+    sealed = true;
+    int rc = ftruncate(fd, used);
+    (void)rc; // left at full size, the zeros past used fail validation
+  }
+
+  /// Size the file to size bytes and map all of it.
+  bool map_file(std::size_t size) {
+    if (ftruncate(fd, size) == -1)
+      return false;
+    auto *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      return false;
+    map = static_cast<char *>(p);
+    capacity = size;
+    return true;
+  }
+
+  /// Index the valid records from the start of the file.
+  void scan(std::size_t size) {
+    std::size_t pos = 0;
+    while (pos + sizeof(journal_record) <= size) {
+      auto *rec = reinterpret_cast<const journal_record *>(map + pos);
+      auto span = journal_record_span(rec->length);
+      if (rec->offset != end() || span > size - pos || !journal_verify(*rec))
+        break;
+
+      index.push_back(static_cast<uint32_t>(pos));
+      last_time_ns = rec->time_ns;
+      pos += span;
+    }
+    used = pos;
+  }
+};
+
+journal::journal(std::string dir, journal_options options)
+    : _dir{std::move(dir)}, _options{options} {
+  if (_options.segment_bytes < journal_record_span(0))
+    _options.segment_bytes = journal_record_span(0);
+
+  if (mkdir(_dir.c_str(), 0755) == -1 && errno != EEXIST)
+    return;
+  _open = recover();
+}
+
+journal::~journal() {
+  if (!_segments.empty())
+    _segments.back()->seal();
+}
+
+bool journal::recover() {
+  auto *d = opendir(_dir.c_str());
+  if (!d)
+    return false;
+
+  std::vector<uint64_t> bases;
+  while (auto *entry = readdir(d)) {
+    uint64_t base;
+    if (parse_segment_name(entry->d_name, base))
+      bases.push_back(base);
+  }
+  closedir(d);
+  std::sort(bases.begin(), bases.end());
+
+  for (std::size_t i = 0; i < bases.size(); ++i) {
+    auto seg = std::make_unique<segment>();
+    seg->base = bases[i];
+    seg->path = _dir + "/" + segment_name(bases[i]);
+
+    // a segment not following on from the previous one, e.g. after a torn
+    // record, starts records nobody can tell apart from lost ones
+    bool follows = _segments.empty() || _segments.back()->end() == seg->base;
+    struct stat st;
+    seg->fd = follows ? open(seg->path.c_str(), O_RDWR | O_CLOEXEC) : -1;
+    if (seg->fd == -1 || fstat(seg->fd, &st) == -1 ||
+        static_cast<std::size_t>(st.st_size) < journal_record_span(0) ||
+        !seg->map_file(st.st_size)) {
+      unlink(seg->path.c_str());
+      continue;
+    }
+
+    seg->scan(st.st_size);
+    if (seg->index.empty()) {
+      unlink(seg->path.c_str());
+      continue;
+    }
+    seg->seal();
+    _segments.push_back(std::move(seg));
+  }
+
+  if (!_segments.empty())
+    _next = _segments.back()->end();
+
+  // appends go to a fresh segment, so sealed files are never written again
+  return true;
+}
+
+bool journal::roll() {
+  auto seg = std::make_unique<segment>();
+  seg->base = _next;
+  seg->path = _dir + "/" + segment_name(_next);
+  seg->fd = open(seg->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                 0644);
+  if (seg->fd == -1)
+    return false;
+  if (!seg->map_file(_options.segment_bytes)) {
+    unlink(seg->path.c_str());
+    return false;
+  }
+
+  if (!_segments.empty())
+    _segments.back()->seal();
+  _segments.push_back(std::move(seg));
+  retain();
+  return true;
+}
+
+int64_t journal::append(gsl::span<const char> payload, uint64_t time_ns) {
+  auto len = static_cast<std::size_t>(payload.size());
+  auto span = journal_record_span(len);
+  if (!_open) {
+    errno = EBADF;
+    return -1;
+  }
+  if (span > _options.segment_bytes) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  // recovered segments are sealed; appends always start a new one
+  auto *seg = _segments.empty() ? nullptr : _segments.back().get();
+  if (!seg || seg->sealed || seg->used + span > seg->capacity) {
+    if (!roll())
+      return -1;
+    seg = _segments.back().get();
+  }
+
+  journal_record rec{};
+  rec.offset = _next;
+  rec.time_ns = time_ns ? time_ns : realtime_ns();
+  rec.length = static_cast<uint32_t>(len);
+  rec.crc = record_crc(rec, payload.data());
+
+  auto *out = seg->map + seg->used;
+  memcpy(out, &rec, sizeof(rec));
+  memcpy(out + sizeof(rec), payload.data(), len);
+  memset(out + sizeof(rec) + len, 0, span - sizeof(rec) - len);
+
+  seg->index.push_back(static_cast<uint32_t>(seg->used));
+  seg->used += span;
+  seg->last_time_ns = rec.time_ns;
+  return static_cast<int64_t>(_next++);
+}
+
+uint64_t journal::first_offset() const {
+  return _segments.empty() ? _next : _segments.front()->base;
+}
+
+journal::segment *journal::find(uint64_t offset) const {
+  auto it = std::upper_bound(
+      _segments.begin(), _segments.end(), offset,
+      [](uint64_t off, const std::unique_ptr<segment> &s) {
+        return off < s->base;
+      });
+  if (it == _segments.begin())
+    return nullptr;
+  return (--it)->get();
+}
+
+gsl::span<const char> journal::record(uint64_t offset) const {
+  auto *seg = find(offset);
+  if (!seg || offset >= seg->end())
+    return {};
+
+  auto pos = seg->index[offset - seg->base];
+  auto *rec = reinterpret_cast<const journal_record *>(seg->map + pos);
+  const char *begin = seg->map + pos;
+  return {begin, begin + journal_record_span(rec->length)};
+}
+
+journal_cursor journal::cursor(uint64_t offset) const {
+  if (_segments.empty())
+    return {_next, 0};
+
+  auto *seg = find(offset);
+  if (!seg)
+    return {_segments.front()->base, 0};
+  if (offset >= seg->end())
+    return {seg->base, seg->used};
+  return {seg->base, seg->index[offset - seg->base]};
+}
+
+bool journal::caught_up(const journal_cursor &cur) const {
+  if (_segments.empty())
+    return true;
+  auto &last = *_segments.back();
+  return cur.segment == last.base && cur.position >= last.used;
+}
+
+ssize_t journal::send(SOCKET sd, journal_cursor &cur, std::size_t max) {
+  ssize_t sent = 0;
+  while (!_segments.empty() && static_cast<std::size_t>(sent) < max) {
+    auto *seg = find(cur.segment);
+    if (!seg || seg->base != cur.segment) {
+      // dropped by retention while this cursor was behind
+      if (cur.partial) {
+        errno = ENODATA;
+        return sent ? sent : -1;
+      }
+      cur = {_segments.front()->base, 0};
+      continue;
+    }
+
+    if (cur.position >= seg->used) {
+      if (seg == _segments.back().get())
+        break;
+      cur = {seg->end(), 0};
+      continue;
+    }
+
+    off_t pos = static_cast<off_t>(cur.position);
+    auto n = sendfile(sd, seg->fd, &pos,
+                      std::min(seg->used - cur.position,
+                               max - static_cast<std::size_t>(sent)));
+    if (n < 0)
+      return sent ? sent : -1;
+    if (n == 0)
+      break;
+    cur.position += n;
+    cur.partial = !seg->at_record(cur.position);
+    sent += n;
+  }
+  return sent;
+}
+
+std::size_t journal::retain(uint64_t now_ns) {
+  if (!now_ns)
+    now_ns = realtime_ns();
+
+  std::size_t dropped = 0;
+  while (_segments.size() > 1) {
+    auto &oldest = *_segments.front();
+    bool too_big = _options.retain_bytes && size() > _options.retain_bytes;
+    bool too_old = _options.retain_ns &&
+                   oldest.last_time_ns + _options.retain_ns < now_ns;
+    if (!too_big && !too_old)
+      break;
+
+    unlink(oldest.path.c_str());
+    _segments.erase(_segments.begin());
+    ++dropped;
+  }
+  return dropped;
+}
+
+std::size_t journal::size() const {
+  std::size_t total = 0;
+  for (auto &seg : _segments)
+    total += seg->used;
+  return total;
+}
+
+journal_store::journal_store(std::string root, journal_options options)
+    : _root{std::move(root)}, _options{options} {
+  mkdir(_root.c_str(), 0755);
+}
+
+journal *journal_store::topic(gsl::czstring<> name) {
+  auto it = _topics.find(name);
+  if (it != _topics.end())
+    return it->second.get();
+
+  if (!*name || *name == '.' || strchr(name, '/')) {
+    errno = EINVAL;
+    return nullptr;
+  }
+
+  auto j = std::make_unique<journal>(_root + "/" + name, _options);
+  if (!*j)
+    return nullptr;
+  return (_topics[name] = std::move(j)).get();
+}
+
+} // namespace ip
+} // namespace wasl
@@ -0,0 +1,87 @@
+#include <wasl/LineFramer.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WASL_DELIMITER_SIMD 1
+#endif
+
+namespace wasl {
+namespace ip {
+
+namespace {
+
+const char *find_bytes(const char *first, const char *last, char delim) {
+  for (; first != last; ++first)
+    if (*first == delim)
+      return first;
+  return last;
+}
+
+#ifdef WASL_DELIMITER_SIMD
+__attribute__((target("sse2"))) const char *
+find_sse2(const char *first, const char *last, char delim) {
+  auto needle = _mm_set1_epi8(delim);
+  for (; last - first >= 16; first += 16) {
+    auto block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    auto mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (mask)
+      return first + __builtin_ctz(mask);
+  }
+  return find_bytes(first, last, delim);
+}
+
+__attribute__((target("avx2"))) const char *
+find_avx2(const char *first, const char *last, char delim) {
+  auto needle = _mm256_set1_epi8(delim);
+  for (; last - first >= 32; first += 32) {
+    auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    auto mask = static_cast<uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+    if (mask)
+      return first + __builtin_ctz(mask);
+  }
+  return find_sse2(first, last, delim);
+}
+#endif
+
+using find_fn = const char *(*)(const char *, const char *, char);
+
+find_fn select_find() {
+#ifdef WASL_DELIMITER_SIMD
+  if (__builtin_cpu_supports("avx2"))
+    return find_avx2;
+  if (__builtin_cpu_supports("sse2"))
+    return find_sse2;
+#endif
+  return find_bytes;
+}
+
+find_fn find_impl() {
+  static const find_fn impl = select_find();
+  return impl;
+}
+
+} // namespace
+
+const char *find_delimiter(const char *first, const char *last,
+                           char delim) noexcept {
+  return find_impl()(first, last, delim);
+}
+
+const char *find_delimiter_portable(const char *first, const char *last,
+                                    char delim) noexcept {
+  return find_bytes(first, last, delim);
+}
+
+const char *find_delimiter_isa() noexcept {
+#ifdef WASL_DELIMITER_SIMD
+  if (find_impl() == find_avx2)
+    return "avx2";
+  if (find_impl() == find_sse2)
+    return "sse2";
+#endif
+  return "scalar";
+}
+
+} // namespace ip
+} // namespace wasl
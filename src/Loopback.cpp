@@ -0,0 +1,780 @@
+#include <wasl/Loopback.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include <time.h>
+
+namespace wasl {
+namespace ip {
+
+namespace {
+
+uint64_t steady_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint64_t wall_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+/// Threads sleeping until some state changes, and how to wake them.
+///
+/// Whoever changes the state issues a fence and, only if a thread sleeps,
+/// takes the lock to notify it; a sleeper registers before checking the
+/// state a last time. One of the two always sees the other, so no wakeup is
+/// missed while the fast path never touches the lock.
+struct sleepers {
+  std::mutex lock;
+  std::condition_variable cv;
+  std::atomic<int> count{0};
+
+  /// Sleep on g, a lock of this, until ready(deadline_ns) holds. ready may
+  /// set a deadline on the steady clock to check again at.
+  template <typename Ready>
+  void wait(std::unique_lock<std::mutex> &g, Ready ready) {
+    count.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (;;) {
+      uint64_t deadline_ns = 0;
+      if (ready(deadline_ns))
+        break;
+      if (deadline_ns == 0) {
+        cv.wait(g);
+      } else {
+        using clock = std::chrono::steady_clock;
+        cv.wait_until(g, clock::time_point(std::chrono::duration_cast<
+                                           clock::duration>(
+                             std::chrono::nanoseconds(deadline_ns))));
+      }
+    }
+    count.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  /// \pre a seq_cst fence since the state changed
+  void wake_fenced() {
+    if (count.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> g{lock};
+      cv.notify_all();
+    }
+  }
+};
+
+/// Lock-free single-producer single-consumer ring of bytes.
+///
+/// Positions only grow, so the bytes queued are head - tail with no
+/// ambiguity between full and empty. The producer stages bytes past the
+/// head and publishes them at once, so a consumer never sees part of a
+/// message.
+class byte_ring {
+public:
+  /// \pre capacity is a power of two
+  explicit byte_ring(std::size_t capacity)
+      : _buf{new char[capacity]}, _mask{capacity - 1} {}
+
+  std::size_t capacity() const { return _mask + 1; }
+
+  /// Bytes queued; safe from any thread.
+  std::size_t size() const {
+    auto tail = _tail.load(std::memory_order_acquire);
+    return _head.load(std::memory_order_acquire) - tail;
+  }
+
+  /// Producer: bytes that fit.
+  std::size_t room() const {
+    return capacity() - (_head.load(std::memory_order_relaxed) -
+                         _tail.load(std::memory_order_acquire));
+  }
+
+  /// Producer: copy n bytes to offset past the head, unpublished.
+  void stage(std::size_t offset, const void *src, std::size_t n) {
+    copy_in(_head.load(std::memory_order_relaxed) + offset,
+            static_cast<const char *>(src), n);
+  }
+
+  /// Producer: make n staged bytes visible to the consumer.
+  void publish(std::size_t n) {
+    _head.store(_head.load(std::memory_order_relaxed) + n,
+                std::memory_order_release);
+  }
+
+  /// Consumer: copy n bytes from offset past the tail.
+  void peek(std::size_t offset, void *dst, std::size_t n) const {
+    auto pos = _tail.load(std::memory_order_relaxed) + offset;
+    auto i = pos & _mask;
+    auto first = std::min(n, capacity() - i);
+    memcpy(dst, _buf.get() + i, first);
+    memcpy(static_cast<char *>(dst) + first, _buf.get(), n - first);
+  }
+
+  /// Consumer: drop n bytes.
+  void consume(std::size_t n) {
+    _tail.store(_tail.load(std::memory_order_relaxed) + n,
+                std::memory_order_release);
+  }
+
+private:
+  void copy_in(std::size_t pos, const char *src, std::size_t n) {
+    auto i = pos & _mask;
+    auto first = std::min(n, capacity() - i);
+    memcpy(_buf.get() + i, src, first);
+    memcpy(_buf.get(), src + first, n - first);
+  }
+
+  std::unique_ptr<char[]> _buf;
+  std::size_t _mask;
+  alignas(64) std::atomic<std::size_t> _head{0}; // written by the producer
+  alignas(64) std::atomic<std::size_t> _tail{0}; // written by the consumer
+};
+
+/// Prefix of every message of a SOCK_SEQPACKET pair.
+struct message_header {
+  uint32_t length;
+  uint32_t reserved;
+  uint64_t time_ns; // wall clock time of the send, 0 unless stamped
+};
+
+/// Both directions of a pair; to[s] carries bytes toward side s.
+struct channel {
+  struct direction {
+    explicit direction(std::size_t capacity) : ring{capacity} {}
+
+    byte_ring ring;
+    sleepers readers;                  // of the receiving side, for input
+    sleepers writers;                  // of the sending side, for room
+    std::atomic<bool> closed{false};   // the sender shut down
+    std::atomic<bool> abandoned{false}; // the receiver shut down
+    std::atomic<bool> stamped{false};
+  };
+
+  channel(bool msgs, std::size_t capacity) : messages{msgs} {
+    to[0].reset(new direction{capacity});
+    to[1].reset(new direction{capacity});
+  }
+
+  const bool messages;
+  std::unique_ptr<direction> to[2];
+  SOCKET sd[2]{INVALID_SOCKET, INVALID_SOCKET};
+};
+
+enum class node_kind : uint8_t { FREE, POLL, NOTIFIER, TIMER, ENDPOINT };
+
+/// State of a loopback descriptor. Nodes are recycled but never freed, so
+/// that a thread signalling a descriptor closed meanwhile at worst wakes a
+/// poll for nothing.
+struct node {
+  std::atomic<node_kind> kind{node_kind::FREE};
+
+  // the poll this is linked to, and what for; not of polls
+  std::atomic<SOCKET> poll{INVALID_SOCKET};
+  std::atomic<bool> want_read{false};
+  std::atomic<bool> want_write{false};
+  std::size_t index{0}; // in the poll's linked, under its lock
+
+  // ENDPOINT
+  std::shared_ptr<channel> chan;
+  int side{0};
+  std::atomic<bool> nonblocking{false};
+
+  // NOTIFIER
+  std::atomic<bool> signaled{false};
+
+  // TIMER
+  std::atomic<uint64_t> deadline_ns{0};
+
+  // POLL
+  sleepers waiters; // its lock also guards linked and cursor
+  std::vector<SOCKET> linked;
+  std::size_t cursor{0}; // where the next scan starts
+
+  void reset() {
+    poll.store(INVALID_SOCKET, std::memory_order_relaxed);
+    want_read.store(false, std::memory_order_relaxed);
+    want_write.store(false, std::memory_order_relaxed);
+    chan.reset();
+    side = 0;
+    nonblocking.store(false, std::memory_order_relaxed);
+    signaled.store(false, std::memory_order_relaxed);
+    deadline_ns.store(0, std::memory_order_relaxed);
+    linked.clear();
+    cursor = 0;
+  }
+};
+
+/// Loopback descriptors, lowest free first like file descriptors. Lookups
+/// are lock-free; opening and closing lock.
+class registry {
+public:
+  registry() {
+    for (auto &s : _slots)
+      s.store(nullptr, std::memory_order_relaxed);
+  }
+
+  node *find(SOCKET sd) const {
+    if (sd < 0 || static_cast<std::size_t>(sd) >= loopback_max_descriptors)
+      return nullptr;
+    auto *n = _slots[sd].load(std::memory_order_acquire);
+    return n && n->kind.load(std::memory_order_acquire) != node_kind::FREE
+               ? n
+               : nullptr;
+  }
+
+  node *find(SOCKET sd, node_kind kind) const {
+    auto *n = find(sd);
+    return n && n->kind.load(std::memory_order_acquire) == kind ? n : nullptr;
+  }
+
+  /// \return the new descriptor, or INVALID_SOCKET with EMFILE
+  SOCKET open(node_kind kind) {
+    std::lock_guard<std::mutex> g{_lock};
+    for (std::size_t i = 0; i < loopback_max_descriptors; ++i) {
+      if (!_owned[i]) {
+        _owned[i].reset(new node);
+        _slots[i].store(_owned[i].get(), std::memory_order_release);
+      } else if (_owned[i]->kind.load(std::memory_order_relaxed) !=
+                 node_kind::FREE) {
+        continue;
+      }
+      _owned[i]->reset();
+      _owned[i]->kind.store(kind, std::memory_order_release);
+      return static_cast<SOCKET>(i);
+    }
+    errno = EMFILE;
+    return INVALID_SOCKET;
+  }
+
+  void release(node &n) {
+    std::lock_guard<std::mutex> g{_lock};
+    n.kind.store(node_kind::FREE, std::memory_order_release);
+  }
+
+private:
+  std::mutex _lock;
+  std::unique_ptr<node> _owned[loopback_max_descriptors];
+  std::atomic<node *> _slots[loopback_max_descriptors];
+};
+
+registry &nodes() {
+  static registry r;
+  return r;
+}
+
+node *endpoint(SOCKET sd) {
+  auto *n = nodes().find(sd);
+  if (!n)
+    errno = EBADF;
+  else if (n->kind.load(std::memory_order_acquire) != node_kind::ENDPOINT)
+    errno = ENOTSOCK;
+  else
+    return n;
+  return nullptr;
+}
+
+/// Wake the poll sd is linked to, if any.
+/// \pre a seq_cst fence since the state of sd changed
+void signal_fenced(SOCKET sd) {
+  auto *n = nodes().find(sd);
+  if (!n)
+    return;
+  auto poll = n->poll.load(std::memory_order_acquire);
+  if (poll == INVALID_SOCKET)
+    return;
+  if (auto *p = nodes().find(poll, node_kind::POLL))
+    p->waiters.wake_fenced();
+}
+
+void signal(SOCKET sd) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  signal_fenced(sd);
+}
+
+bool would_fit(const channel &c, const channel::direction &d) {
+  return d.ring.room() > (c.messages ? sizeof(message_header) : 0);
+}
+
+/// Readiness of n for its poll, and the deadline of a timer yet to fire.
+uint32_t readiness(node &n, uint64_t now, uint64_t &deadline_ns) {
+  switch (n.kind.load(std::memory_order_acquire)) {
+  case node_kind::NOTIFIER:
+    return n.signaled.load(std::memory_order_acquire) ? LOOPBACK_IN : 0;
+  case node_kind::TIMER: {
+    auto d = n.deadline_ns.load(std::memory_order_acquire);
+    if (d != 0 && d <= now)
+      return LOOPBACK_IN;
+    if (d != 0 && (deadline_ns == 0 || d < deadline_ns))
+      deadline_ns = d;
+    return 0;
+  }
+  case node_kind::ENDPOINT: {
+    auto &c = *n.chan;
+    auto &in = *c.to[n.side];
+    auto &out = *c.to[1 - n.side];
+    uint32_t events = 0;
+    if (n.want_read.load(std::memory_order_relaxed)) {
+      bool ended = in.closed.load(std::memory_order_acquire) ||
+                   in.abandoned.load(std::memory_order_acquire);
+      if (ended)
+        events |= LOOPBACK_IN | LOOPBACK_HUP;
+      else if (in.ring.size() > 0)
+        events |= LOOPBACK_IN;
+    }
+    // sending fails rather than blocks once either side shut it down
+    if (n.want_write.load(std::memory_order_relaxed) &&
+        (would_fit(c, out) || out.closed.load(std::memory_order_acquire) ||
+         out.abandoned.load(std::memory_order_acquire)))
+      events |= LOOPBACK_OUT;
+    return events;
+  }
+  default:
+    return 0;
+  }
+}
+
+/// Fill up to max events of the descriptors linked to p, starting where the
+/// last scan left off.
+/// \pre p's lock is held
+int scan(node &p, loopback_event *events, int max, uint64_t &deadline_ns) {
+  auto size = p.linked.size();
+  if (size == 0)
+    return 0;
+
+  auto now = steady_ns();
+  int count = 0;
+  std::size_t i = 0;
+  for (; i < size && count < max; ++i) {
+    auto sd = p.linked[(p.cursor + i) % size];
+    auto *n = nodes().find(sd);
+    if (!n)
+      continue;
+    if (auto ev = readiness(*n, now, deadline_ns))
+      events[count++] = {sd, ev};
+  }
+  p.cursor = (p.cursor + i) % size;
+  return count;
+}
+
+/// Unlink n, descriptor sd, from p.
+/// \pre p's lock is held and n is linked to it
+void unlink_locked(node &p, node &n, SOCKET sd) {
+  auto last = p.linked.back();
+  p.linked[n.index] = last;
+  if (last != sd)
+    nodes().find(last)->index = n.index;
+  p.linked.pop_back();
+  if (p.cursor >= p.linked.size())
+    p.cursor = 0;
+  n.poll.store(INVALID_SOCKET, std::memory_order_release);
+}
+
+/// Stop the sending side of n: no more bytes toward the peer.
+void shut_send(node &n) {
+  auto &c = *n.chan;
+  auto &out = *c.to[1 - n.side];
+  out.closed.store(true, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  out.readers.wake_fenced();
+  out.writers.wake_fenced();
+  signal_fenced(c.sd[1 - n.side]);
+}
+
+/// Stop the receiving side of n: the peer's sends fail from now on.
+void shut_receive(node &n) {
+  auto &c = *n.chan;
+  auto &in = *c.to[n.side];
+  in.abandoned.store(true, std::memory_order_release);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  in.readers.wake_fenced();
+  in.writers.wake_fenced();
+  signal_fenced(c.sd[1 - n.side]);
+}
+
+ssize_t receive(SOCKET sd, void *buf, std::size_t len, int flags,
+                uint64_t *time_ns) {
+  auto *n = endpoint(sd);
+  if (!n)
+    return -1;
+
+  auto &c = *n->chan;
+  auto &in = *c.to[n->side];
+  bool dontwait = (flags & MSG_DONTWAIT) ||
+                  n->nonblocking.load(std::memory_order_relaxed);
+  auto ended = [&in] {
+    return in.closed.load(std::memory_order_acquire) ||
+           in.abandoned.load(std::memory_order_acquire);
+  };
+
+  std::size_t queued;
+  while ((queued = in.ring.size()) == 0) {
+    if (ended())
+      return 0;
+    if (dontwait) {
+      errno = EAGAIN;
+      return -1;
+    }
+    std::unique_lock<std::mutex> g{in.readers.lock};
+    in.readers.wait(g, [&](uint64_t &) {
+      return in.ring.size() > 0 || ended();
+    });
+  }
+
+  bool peek = flags & MSG_PEEK;
+  std::size_t copied, taken;
+  ssize_t result;
+  if (c.messages) {
+    message_header h;
+    in.ring.peek(0, &h, sizeof(h));
+    copied = std::min<std::size_t>(len, h.length);
+    if (copied > 0)
+      in.ring.peek(sizeof(h), buf, copied);
+    taken = sizeof(h) + h.length;
+    result = (flags & MSG_TRUNC) ? h.length : copied;
+    if (time_ns)
+      *time_ns = h.time_ns;
+  } else {
+    copied = std::min(len, queued);
+    if (copied > 0)
+      in.ring.peek(0, buf, copied);
+    taken = copied;
+    result = copied;
+    if (time_ns)
+      *time_ns = 0;
+  }
+
+  if (!peek && taken > 0) {
+    in.ring.consume(taken);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    in.writers.wake_fenced();
+    signal_fenced(c.sd[1 - n->side]);
+  }
+  return result;
+}
+
+/// Copy up to n bytes of iov, skipping the first skip, to offset past the
+/// head of ring.
+void stage_iov(byte_ring &ring, std::size_t offset, const struct iovec *iov,
+               int iovcnt, std::size_t skip, std::size_t n) {
+  for (int i = 0; i < iovcnt && n > 0; ++i) {
+    if (skip >= iov[i].iov_len) {
+      skip -= iov[i].iov_len;
+      continue;
+    }
+    auto k = std::min(iov[i].iov_len - skip, n);
+    ring.stage(offset, static_cast<const char *>(iov[i].iov_base) + skip, k);
+    offset += k;
+    n -= k;
+    skip = 0;
+  }
+}
+
+} // namespace
+
+int loopback_pair(int type, SOCKET sv[2], std::size_t capacity) {
+  bool nonblocking = type & SOCK_NONBLOCK;
+  type &= ~(SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if ((type != SOCK_STREAM && type != SOCK_SEQPACKET && type != SOCK_DGRAM) ||
+      capacity == 0 || capacity > (std::size_t{1} << 40)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::size_t cap = 64;
+  while (cap < capacity)
+    cap <<= 1;
+  auto chan = std::make_shared<channel>(type != SOCK_STREAM, cap);
+
+  SOCKET sds[2];
+  for (int side = 0; side < 2; ++side) {
+    sds[side] = nodes().open(node_kind::ENDPOINT);
+    if (sds[side] == INVALID_SOCKET) {
+      if (side == 1)
+        loopback_close(sds[0]);
+      return -1;
+    }
+    auto *n = nodes().find(sds[side]);
+    n->chan = chan;
+    n->side = side;
+    n->nonblocking.store(nonblocking, std::memory_order_relaxed);
+    chan->sd[side] = sds[side];
+  }
+  sv[0] = sds[0];
+  sv[1] = sds[1];
+  return 0;
+}
+
+int loopback_close(SOCKET sd) {
+  auto *n = nodes().find(sd);
+  if (!n) {
+    errno = EBADF;
+    return -1;
+  }
+
+  auto poll = n->poll.load(std::memory_order_acquire);
+  if (poll != INVALID_SOCKET)
+    loopback_poll_unlink(poll, sd);
+
+  switch (n->kind.load(std::memory_order_acquire)) {
+  case node_kind::ENDPOINT:
+    shut_send(*n);
+    shut_receive(*n);
+    break;
+  case node_kind::POLL: {
+    std::lock_guard<std::mutex> g{n->waiters.lock};
+    for (auto linked : n->linked)
+      if (auto *l = nodes().find(linked))
+        l->poll.store(INVALID_SOCKET, std::memory_order_release);
+    n->linked.clear();
+    break;
+  }
+  default:
+    break;
+  }
+  nodes().release(*n);
+  return 0;
+}
+
+int loopback_shutdown(SOCKET sd, int how) {
+  auto *n = endpoint(sd);
+  if (!n)
+    return -1;
+  if (how != SHUT_RD && how != SHUT_WR && how != SHUT_RDWR) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (how != SHUT_RD)
+    shut_send(*n);
+  if (how != SHUT_WR)
+    shut_receive(*n);
+  return 0;
+}
+
+int loopback_set_nonblocking(SOCKET sd, bool nonblocking) {
+  auto *n = endpoint(sd);
+  if (!n)
+    return -1;
+  n->nonblocking.store(nonblocking, std::memory_order_relaxed);
+  return 0;
+}
+
+int loopback_set_timestamps(SOCKET sd, bool stamped) {
+  auto *n = endpoint(sd);
+  if (!n)
+    return -1;
+  if (!n->chan->messages) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+  n->chan->to[n->side]->stamped.store(stamped, std::memory_order_relaxed);
+  return 0;
+}
+
+ssize_t loopback_sendv(SOCKET sd, const struct iovec *iov, int iovcnt,
+                       int flags) {
+  auto *n = endpoint(sd);
+  if (!n)
+    return -1;
+  if (iovcnt < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  auto &c = *n->chan;
+  auto &out = *c.to[1 - n->side];
+  bool dontwait = (flags & MSG_DONTWAIT) ||
+                  n->nonblocking.load(std::memory_order_relaxed);
+  auto broken = [&out] {
+    return out.closed.load(std::memory_order_acquire) ||
+           out.abandoned.load(std::memory_order_acquire);
+  };
+
+  std::size_t total = 0;
+  for (int i = 0; i < iovcnt; ++i)
+    total += iov[i].iov_len;
+
+  // a message goes in whole; a stream takes what fits and, if blocking,
+  // waits for room for the rest
+  std::size_t need = c.messages ? sizeof(message_header) + total : 1;
+  if (need > out.ring.capacity() || total > UINT32_MAX) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  std::size_t sent = 0;
+  for (;;) {
+    if (broken()) {
+      if (sent > 0)
+        return sent;
+      errno = EPIPE;
+      return -1;
+    }
+
+    auto room = out.ring.room();
+    if (room >= need) {
+      std::size_t k;
+      if (c.messages) {
+        message_header h{static_cast<uint32_t>(total), 0,
+                         out.stamped.load(std::memory_order_relaxed) ? wall_ns()
+                                                                     : 0};
+        out.ring.stage(0, &h, sizeof(h));
+        stage_iov(out.ring, sizeof(h), iov, iovcnt, 0, total);
+        out.ring.publish(sizeof(h) + total);
+        k = total;
+      } else {
+        k = std::min(room, total - sent);
+        stage_iov(out.ring, 0, iov, iovcnt, sent, k);
+        out.ring.publish(k);
+      }
+      sent += k;
+
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      out.readers.wake_fenced();
+      signal_fenced(c.sd[1 - n->side]);
+      if (c.messages || sent == total)
+        return sent;
+    }
+    if (total == 0)
+      return 0;
+
+    if (dontwait) {
+      if (sent > 0)
+        return sent;
+      errno = EAGAIN;
+      return -1;
+    }
+    std::unique_lock<std::mutex> g{out.writers.lock};
+    out.writers.wait(g, [&](uint64_t &) {
+      return out.ring.room() >= need || broken();
+    });
+  }
+}
+
+ssize_t loopback_recv(SOCKET sd, void *buf, std::size_t len, int flags) {
+  return receive(sd, buf, len, flags, nullptr);
+}
+
+ssize_t loopback_recv_stamped(SOCKET sd, void *buf, std::size_t len,
+                              uint64_t &arrival_ns, int flags) {
+  arrival_ns = 0;
+  return receive(sd, buf, len, flags, &arrival_ns);
+}
+
+long loopback_pending(SOCKET sd) {
+  auto *n = nodes().find(sd);
+  if (!n) {
+    errno = EBADF;
+    return -1;
+  }
+  if (n->kind.load(std::memory_order_acquire) != node_kind::ENDPOINT)
+    return 0;
+  return static_cast<long>(n->chan->to[n->side]->ring.size());
+}
+
+SOCKET loopback_poll_create() { return nodes().open(node_kind::POLL); }
+
+bool loopback_poll_link(SOCKET poll, SOCKET sd, bool readable, bool writable) {
+  auto *p = nodes().find(poll, node_kind::POLL);
+  auto *n = nodes().find(sd);
+  if (!p || !n || n->kind.load(std::memory_order_acquire) == node_kind::POLL) {
+    errno = EBADF;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> g{p->waiters.lock};
+  auto linked = n->poll.load(std::memory_order_relaxed);
+  if (linked == INVALID_SOCKET) {
+    n->index = p->linked.size();
+    p->linked.push_back(sd);
+    n->poll.store(poll, std::memory_order_release);
+  } else if (linked != poll) {
+    errno = EEXIST;
+    return false;
+  }
+  n->want_read.store(readable, std::memory_order_relaxed);
+  n->want_write.store(writable, std::memory_order_relaxed);
+  return true;
+}
+
+bool loopback_poll_unlink(SOCKET poll, SOCKET sd) {
+  auto *p = nodes().find(poll, node_kind::POLL);
+  auto *n = nodes().find(sd);
+  if (!p || !n) {
+    errno = EBADF;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> g{p->waiters.lock};
+  if (n->poll.load(std::memory_order_relaxed) != poll) {
+    errno = ENOENT;
+    return false;
+  }
+  unlink_locked(*p, *n, sd);
+  return true;
+}
+
+int loopback_poll_wait(SOCKET poll, loopback_event *events, int max) {
+  auto *p = nodes().find(poll, node_kind::POLL);
+  if (!p) {
+    errno = EBADF;
+    return -1;
+  }
+  if (max <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  std::unique_lock<std::mutex> g{p->waiters.lock};
+  uint64_t deadline_ns = 0;
+  int count = scan(*p, events, max, deadline_ns);
+  if (count == 0)
+    p->waiters.wait(g, [&](uint64_t &deadline) {
+      count = scan(*p, events, max, deadline);
+      return count > 0;
+    });
+  return count;
+}
+
+SOCKET loopback_notifier_create() {
+  return nodes().open(node_kind::NOTIFIER);
+}
+
+void loopback_notify(SOCKET nd) {
+  if (auto *n = nodes().find(nd, node_kind::NOTIFIER)) {
+    n->signaled.store(true, std::memory_order_release);
+    signal(nd);
+  }
+}
+
+void loopback_notifier_clear(SOCKET nd) {
+  if (auto *n = nodes().find(nd, node_kind::NOTIFIER))
+    n->signaled.store(false, std::memory_order_release);
+}
+
+SOCKET loopback_timer_create() { return nodes().open(node_kind::TIMER); }
+
+void loopback_timer_arm(SOCKET td, uint64_t deadline_ns) {
+  if (auto *n = nodes().find(td, node_kind::TIMER)) {
+    n->deadline_ns.store(deadline_ns, std::memory_order_release);
+    signal(td);
+  }
+}
+
+void loopback_timer_clear(SOCKET td) {
+  if (auto *n = nodes().find(td, node_kind::TIMER)) {
+    auto d = n->deadline_ns.load(std::memory_order_acquire);
+    if (d != 0 && d <= steady_ns())
+      n->deadline_ns.store(0, std::memory_order_release);
+  }
+}
+
+} // namespace ip
+} // namespace wasl
@@ -0,0 +1,166 @@
+#include <wasl/Metrics.h>
+
+#include <cerrno>
+#include <new>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wasl {
+namespace ip {
+
+namespace {
+
+template <std::size_t N>
+void copy_histogram(log2_histogram<N> &dst, const log2_histogram<N> &src) {
+  for (std::size_t i = 0; i < N; ++i)
+    dst.set(i, src.count(i));
+}
+
+template <std::size_t N>
+std::vector<uint64_t> histogram_counts(const log2_histogram<N> &h) {
+  std::vector<uint64_t> counts(N);
+  for (std::size_t i = 0; i < N; ++i)
+    counts[i] = h.count(i);
+  return counts;
+}
+
+reactor_stats *map_stats(int fd, int prot) {
+  void *mem = mmap(nullptr, sizeof(reactor_stats), prot,
+                   fd == -1 ? MAP_PRIVATE | MAP_ANONYMOUS : MAP_SHARED, fd, 0);
+  return mem == MAP_FAILED ? nullptr : static_cast<reactor_stats *>(mem);
+}
+
+} // namespace
+
+void reactor_stats::reset_fd(SOCKET sfd) noexcept {
+  if (auto *s = fd(sfd)) {
+    s->events.set(0);
+    s->bytes_in.set(0);
+    s->bytes_out.set(0);
+    s->throttles.set(0);
+    s->throttled_ns.set(0);
+  }
+}
+
+void reactor_stats::assign(const reactor_stats &other) noexcept {
+  wakeups.set(other.wakeups.get());
+  events.set(other.events.get());
+  dispatched.set(other.dispatched.get());
+  bytes_in.set(other.bytes_in.get());
+  bytes_out.set(other.bytes_out.get());
+  throttles.set(other.throttles.get());
+  throttled_ns.set(other.throttled_ns.get());
+  copy_histogram(batch_sizes, other.batch_sizes);
+  copy_histogram(handler_ns, other.handler_ns);
+  copy_histogram(wire_to_handler_ns, other.wire_to_handler_ns);
+  copy_histogram(end_to_end_ns, other.end_to_end_ns);
+
+  for (int i = 0; i < max_tracked_fds; ++i) {
+    fds[i].events.set(other.fds[i].events.get());
+    fds[i].bytes_in.set(other.fds[i].bytes_in.get());
+    fds[i].bytes_out.set(other.fds[i].bytes_out.get());
+    fds[i].throttles.set(other.fds[i].throttles.get());
+    fds[i].throttled_ns.set(other.fds[i].throttled_ns.get());
+  }
+}
+
+metrics_snapshot snapshot(const reactor_stats &stats) {
+  metrics_snapshot snap;
+  snap.wakeups = stats.wakeups.get();
+  snap.events = stats.events.get();
+  snap.dispatched = stats.dispatched.get();
+  snap.bytes_in = stats.bytes_in.get();
+  snap.bytes_out = stats.bytes_out.get();
+  snap.throttles = stats.throttles.get();
+  snap.throttled_ns = stats.throttled_ns.get();
+  snap.batch_sizes = histogram_counts(stats.batch_sizes);
+  snap.handler_ns = histogram_counts(stats.handler_ns);
+  snap.wire_to_handler_ns = histogram_counts(stats.wire_to_handler_ns);
+  snap.end_to_end_ns = histogram_counts(stats.end_to_end_ns);
+
+  for (int i = 0; i < reactor_stats::max_tracked_fds; ++i) {
+    const auto &f = stats.fds[i];
+    metrics_snapshot::fd_entry entry{i,
+                                     f.events.get(),
+                                     f.bytes_in.get(),
+                                     f.bytes_out.get(),
+                                     f.throttles.get(),
+                                     f.throttled_ns.get()};
+    if (entry.events || entry.bytes_in || entry.bytes_out || entry.throttles)
+      snap.fds.push_back(entry);
+  }
+
+  return snap;
+}
+
+stats_segment::stats_segment()
+    : _stats{map_stats(-1, PROT_READ | PROT_WRITE)}, _writable{true} {
+  if (_stats)
+    new (_stats) reactor_stats;
+}
+
+stats_segment::stats_segment(gsl::czstring<> path) : _writable{true} {
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1)
+    return;
+
+  if (ftruncate(fd, sizeof(reactor_stats)) == 0)
+    _stats = map_stats(fd, PROT_READ | PROT_WRITE);
+
+  // the mapping keeps the file referenced
+  close(fd);
+
+  if (_stats)
+    new (_stats) reactor_stats;
+}
+
+stats_segment stats_segment::attach(gsl::czstring<> path) {
+  stats_segment seg{nullptr, false};
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return seg;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<std::size_t>(st.st_size) >= sizeof(reactor_stats))
+    seg._stats = map_stats(fd, PROT_READ);
+  close(fd);
+
+  if (seg._stats && (seg._stats->magic != reactor_stats::magic_value ||
+                     seg._stats->version != reactor_stats::layout_version)) {
+    munmap(seg._stats, sizeof(reactor_stats));
+    seg._stats = nullptr;
+    errno = EPROTO;
+  }
+
+  return seg;
+}
+
+stats_segment::~stats_segment() {
+  if (_stats)
+    munmap(_stats, sizeof(reactor_stats));
+}
+
+stats_segment::stats_segment(stats_segment &&other) noexcept
+    : _stats{other._stats}, _writable{other._writable} {
+  other._stats = nullptr;
+}
+
+stats_segment &stats_segment::operator=(stats_segment &&other) noexcept {
+  if (this != &other) {
+    if (_stats)
+      munmap(_stats, sizeof(reactor_stats));
+    _stats = other._stats;
+    _writable = other._writable;
+    other._stats = nullptr;
+  }
+  return *this;
+}
+
+} // namespace ip
+} // namespace wasl
@@ -0,0 +1,220 @@
+#include <wasl/Multicast.h>
+#include <wasl/SockStream.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/uio.h>
+
+namespace wasl {
+namespace ip {
+
+namespace {
+
+/// Largest UDP payload over IPv4.
+constexpr std::size_t max_datagram = 65507;
+
+std::string group_path(const std::string &group, in_port_t port) {
+  return group + ":" + std::to_string(port);
+}
+
+} // namespace
+
+uint32_t topic_id(gsl::czstring<> topic) {
+  uint32_t h = 2166136261u;
+  for (auto *p = topic; *p; ++p) {
+    h ^= static_cast<unsigned char>(*p);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+topic_map::topic_map(gsl::czstring<> base, uint32_t groups, in_port_t port)
+    : _base{0}, _groups{groups ? groups : 1}, _port{port} {
+  struct in_addr addr {};
+  if (inet_pton(AF_INET, base, &addr) == 1)
+    _base = ntohl(addr.s_addr);
+}
+
+void topic_map::assign(gsl::czstring<> topic, gsl::czstring<> group) {
+  _assigned[topic_id(topic)] = group;
+}
+
+std::string topic_map::group_for(gsl::czstring<> topic) const {
+  auto id = topic_id(topic);
+  auto it = _assigned.find(id);
+  if (it != _assigned.end())
+    return it->second;
+
+  if (!_base)
+    return {};
+
+  struct in_addr addr {};
+  addr.s_addr = htonl(_base + id % _groups);
+  char buf[INET_ADDRSTRLEN];
+  return inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+}
+
+mcast_publisher::mcast_publisher(topic_map topics, int ttl,
+                                 gsl::czstring<> iface)
+    : _topics{std::move(topics)} {
+  auto builder = socket_dgram_udp::create("0.0.0.0:0");
+  builder->socket()->bind()->multicast_ttl(ttl)->multicast_loop(true);
+  if (iface)
+    builder->multicast_interface(iface);
+
+  _sock.reset(builder->build());
+  if (!*builder)
+    _sock.reset();
+}
+
+ssize_t mcast_publisher::publish(gsl::czstring<> topic,
+                                 gsl::span<const char> payload) {
+  auto group = _topics.group_for(topic);
+  struct sockaddr_in to {};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(_topics.port());
+  if (!_sock || group.empty() ||
+      inet_pton(AF_INET, group.c_str(), &to.sin_addr) != 1) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  mcast_header header;
+  header.topic = topic_id(topic);
+  header.seq = _seq[header.topic] + 1;
+
+  struct iovec iov[2] = {
+      {&header, sizeof(header)},
+      {const_cast<char *>(payload.data()),
+       static_cast<std::size_t>(payload.size())}};
+  struct msghdr msg {};
+  msg.msg_name = &to;
+  msg.msg_namelen = sizeof(to);
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+
+  auto n = sendmsg(sockno(*_sock), &msg, 0);
+  if (n < 0)
+    return -1;
+
+  // a failed send does not consume a sequence number
+  _seq[header.topic] = header.seq;
+  return n - static_cast<ssize_t>(sizeof(header));
+}
+
+uint64_t mcast_publisher::sequence(gsl::czstring<> topic) const {
+  auto it = _seq.find(topic_id(topic));
+  return it == _seq.end() ? 0 : it->second;
+}
+
+mcast_subscriber::mcast_subscriber(topic_map topics, gsl::czstring<> iface)
+    : _topics{std::move(topics)}, _iface{iface ? iface : ""},
+      _buf(max_datagram) {
+  // several subscribers on one host share the port
+  auto builder =
+      socket_dgram_udp::create(group_path("0.0.0.0", _topics.port()).c_str());
+  builder->socket()->option(SOL_SOCKET, SO_REUSEADDR, 1)->bind();
+
+  _sock.reset(builder->build());
+  if (!*builder)
+    _sock.reset();
+}
+
+bool mcast_subscriber::subscribe(gsl::czstring<> topic) {
+  auto id = topic_id(topic);
+  if (!_sock)
+    return false;
+  if (_subscribed.count(id))
+    return true;
+
+  auto group = _topics.group_for(topic);
+  if (_joined[group] == 0 &&
+      multicast_membership(sockno(*_sock), AF_INET, group.c_str(),
+                           _iface.empty() ? nullptr : _iface.c_str(),
+                           true) == -1) {
+    _joined.erase(group);
+    return false;
+  }
+
+  ++_joined[group];
+  _subscribed.emplace(id, std::move(group));
+  return true;
+}
+
+bool mcast_subscriber::unsubscribe(gsl::czstring<> topic) {
+  auto it = _subscribed.find(topic_id(topic));
+  if (!_sock || it == _subscribed.end())
+    return false;
+
+  auto group = std::move(it->second);
+  _subscribed.erase(it);
+  if (--_joined[group] > 0)
+    return true;
+
+  _joined.erase(group);
+  return multicast_membership(sockno(*_sock), AF_INET, group.c_str(),
+                              _iface.empty() ? nullptr : _iface.c_str(),
+                              false) == 0;
+}
+
+std::size_t mcast_subscriber::drain() {
+  if (!_sock)
+    return 0;
+
+  auto before = _stats.received;
+  for (;;) {
+    peer_address from;
+    auto n = basic_sockio<platform_type>::rv_recv_from(
+        sockno(*_sock), _buf.data(), _buf.size(), from, MSG_DONTWAIT);
+    if (n < 0)
+      break;
+    deliver(from, _buf.data(), n);
+  }
+  return _stats.received - before;
+}
+
+void mcast_subscriber::deliver(const peer_address &from, const char *buf,
+                               std::size_t len) {
+  mcast_header header;
+  if (len < sizeof(header)) {
+    ++_stats.malformed;
+    return;
+  }
+  memcpy(&header, buf, sizeof(header));
+  if (header.magic != mcast_header::magic_value || header.seq == 0) {
+    ++_stats.malformed;
+    return;
+  }
+
+  // groups may carry topics this subscriber did not ask for
+  if (!_subscribed.count(header.topic))
+    return;
+
+  auto key = uint64_t{_publishers.intern(from)} << 32 | header.topic;
+  auto &expected = _expected[key];
+  if (expected == 0)
+    expected = header.seq; // first message from this publisher
+
+  if (header.seq < expected) {
+    ++_stats.duplicates;
+    return;
+  }
+
+  if (header.seq > expected) {
+    auto missing = header.seq - expected;
+    ++_stats.gaps;
+    _stats.lost += missing;
+    if (_on_gap)
+      _on_gap(header.topic, expected, missing);
+  }
+
+  expected = header.seq + 1;
+  ++_stats.received;
+  if (_on_message)
+    _on_message(header.topic, header.seq,
+                {buf + sizeof(header), buf + len});
+}
+
+} // namespace ip
+} // namespace wasl
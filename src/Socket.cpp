@@ -1,32 +1,161 @@
 #include <wasl/Socket.h>
 
+#include <net/if.h> // if_nametoindex
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
 namespace wasl {
 namespace ip {
 
-template <typename Node>
-socket_builder<Node>::socket_builder(typename sock_traits::path_type sock_path)
-    : sock{gsl::owner<node_type *>(new node_type)} {
-  sock->_addr.sun_family = sock_traits::domain;
-  if (strlen(sock_path) > sizeof(sock->_addr.sun_path) - 1) {
-    sock_err |= SockError::ERR_PATH_INVAL;
+namespace {
+
+bool init_address(struct sockaddr_un &addr, gsl::czstring<> path) {
+  addr.sun_family = AF_LOCAL;
+  if (strlen(path) > sizeof(addr.sun_path) - 1)
+    return false;
+
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+  return true;
+}
+
+/// Split "host:port" or "[host]:port" at the last colon.
+bool split_host_port(gsl::czstring<> path, std::string &host, in_port_t &port) {
+  const char *colon = strrchr(path, ':');
+  if (!colon)
+    return false;
+
+  const char *begin = path;
+  const char *end = colon;
+  if (*begin == '[' && end > begin && end[-1] == ']') {
+    ++begin;
+    --end;
   }
+  host.assign(begin, end);
 
-  // remove path in case artifacts were left from a previous run
-  unlink(sock_path);
+  char *last;
+  errno = 0;
+  auto value = strtoul(colon + 1, &last, 10);
+  if (errno || *last != '\0' || last == colon + 1 || value > 65535)
+    return false;
 
-  strncpy(sock->_addr.sun_path, sock_path, sizeof(sock->_addr.sun_path) - 1);
+  port = htons(static_cast<in_port_t>(value));
+  return true;
+}
+
+bool init_address(struct sockaddr_in &addr, gsl::czstring<> path) {
+  std::string host;
+  addr.sin_family = AF_INET;
+  return split_host_port(path, host, addr.sin_port) &&
+         inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1;
+}
+
+bool init_address(struct sockaddr_in6 &addr, gsl::czstring<> path) {
+  std::string host;
+  addr.sin6_family = AF_INET6;
+  return split_host_port(path, host, addr.sin6_port) &&
+         inet_pton(AF_INET6, host.c_str(), &addr.sin6_addr) == 1;
+}
+
+/// Option names by family; -1, which setsockopt rejects, where a family has
+/// no multicast.
+struct multicast_options {
+  int level;
+  int ttl;
+  int loop;
+  int iface;
+};
+
+multicast_options multicast_options_for(int domain) {
+  switch (domain) {
+  case AF_INET:
+    return {IPPROTO_IP, IP_MULTICAST_TTL, IP_MULTICAST_LOOP, IP_MULTICAST_IF};
+  case AF_INET6:
+    return {IPPROTO_IPV6, IPV6_MULTICAST_HOPS, IPV6_MULTICAST_LOOP,
+            IPV6_MULTICAST_IF};
+  default:
+    return {-1, -1, -1, -1};
+  }
+}
+
+} // namespace
+
+std::string address_path(const struct sockaddr_in &addr) {
+  char host[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &addr.sin_addr, host, sizeof(host));
+  return std::string(host) + ':' + std::to_string(ntohs(addr.sin_port));
+}
+
+std::string address_path(const struct sockaddr_in6 &addr) {
+  char host[INET6_ADDRSTRLEN];
+  inet_ntop(AF_INET6, &addr.sin6_addr, host, sizeof(host));
+  return '[' + std::string(host) + "]:" + std::to_string(ntohs(addr.sin6_port));
+}
+
+std::string address_path(const struct sockaddr_un &addr) {
+  return std::string(addr.sun_path, strnlen(addr.sun_path, sizeof(addr.sun_path)));
+}
+
+int multicast_membership(SOCKET sd, int domain, gsl::czstring<> group,
+                         gsl::czstring<> iface, bool join) {
+  if (domain == AF_INET) {
+    struct ip_mreq mreq {};
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1 ||
+        (iface && inet_pton(AF_INET, iface, &mreq.imr_interface) != 1)) {
+      errno = EINVAL;
+      return -1;
+    }
+    return setsockopt(sd, IPPROTO_IP,
+                      join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP, &mreq,
+                      sizeof(mreq));
+  }
+
+  if (domain == AF_INET6) {
+    struct ipv6_mreq mreq {};
+    if (inet_pton(AF_INET6, group, &mreq.ipv6mr_multiaddr) != 1 ||
+        (iface && (mreq.ipv6mr_interface = if_nametoindex(iface)) == 0)) {
+      errno = EINVAL;
+      return -1;
+    }
+    return setsockopt(sd, IPPROTO_IPV6,
+                      join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP, &mreq,
+                      sizeof(mreq));
+  }
+
+  errno = EAFNOSUPPORT;
+  return -1;
+}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace>::socket_builder(typename sock_traits::path_type sock_path)
+    : sock{gsl::owner<node_type *>(new node_type)} {
+  if (!init_address(sock->_addr, sock_path)) {
+    sock_err |= SockError::ERR_PATH_INVAL;
+  }
 }
 
-template <typename Node> socket_builder<Node> *socket_builder<Node>::socket() {
+template <typename Node, typename Trace>
+socket_builder<Node, Trace>::socket_builder()
+    : sock{gsl::owner<node_type *>(new node_type)} {}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *socket_builder<Node, Trace>::socket() {
   sock->sd = ::socket(sock_traits::domain, socket_type, 0);
 
   if (sockno(*sock) == -1)
     sock_err |= SockError::ERR_SOCKET;
 
+  Trace::record(trace_kind::sock_open, sockno(*sock),
+                sockno(*sock) == -1 ? GET_SOCKERRNO() : 0);
   return this;
 }
 
-template <typename Node> socket_builder<Node> *socket_builder<Node>::bind() {
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *socket_builder<Node, Trace>::bind() {
+  // a previous run may have left its socket file at the path
+  release_address(sock->_addr);
   if (::bind(sockno(*sock), reinterpret_cast<struct sockaddr *>(&(sock->_addr)),
              sizeof(typename sock_traits::type)) == -1) {
 
@@ -34,20 +163,167 @@ template <typename Node> socket_builder<Node> *socket_builder<Node>::bind() {
     std::cerr << "Bind error: " << strerror(GET_SOCKERRNO()) << '\n';
 #endif
     sock_err |= SockError::ERR_BIND;
+    Trace::record(trace_kind::sock_bind, sockno(*sock), GET_SOCKERRNO());
+  } else {
+    Trace::record(trace_kind::sock_bind, sockno(*sock), 0);
   }
 
   return this;
 }
 
-template <typename Node>
-socket_builder<Node> *socket_builder<Node>::connect(SOCKET target_sd) {
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *
+socket_builder<Node, Trace>::connect(SOCKET target_sd) {
   if (socket_connect(sock, target_sd) == -1) {
     sock_err |= SockError::ERR_CONNECT;
+    Trace::record(trace_kind::sock_connect, sockno(*sock), GET_SOCKERRNO());
+  } else {
+    Trace::record(trace_kind::sock_connect, sockno(*sock), 0);
+  }
+  return this;
+}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *socket_builder<Node, Trace>::connect() {
+  sock->_owns_address = false;
+  if (::connect(sockno(*sock), reinterpret_cast<struct sockaddr *>(&sock->_addr),
+                sizeof(typename sock_traits::type)) == -1) {
+    sock_err |= SockError::ERR_CONNECT;
+    Trace::record(trace_kind::sock_connect, sockno(*sock), GET_SOCKERRNO());
+  } else {
+    Trace::record(trace_kind::sock_connect, sockno(*sock), 0);
+  }
+  return this;
+}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *socket_builder<Node, Trace>::listen(int backlog) {
+  if (::listen(sockno(*sock), backlog) == -1) {
+    sock_err |= SockError::ERR_LISTEN;
+    Trace::record(trace_kind::sock_listen, sockno(*sock), GET_SOCKERRNO());
+  } else {
+    Trace::record(trace_kind::sock_listen, sockno(*sock), 0);
+  }
+  return this;
+}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *
+socket_builder<Node, Trace>::accept(SOCKET listener, int flags) {
+  socklen_t len = sizeof(sock->_addr);
+  sock->sd = ::accept4(listener, reinterpret_cast<struct sockaddr *>(&sock->_addr),
+                       &len, flags);
+  sock->_owns_address = false;
+
+  if (sockno(*sock) == -1)
+    sock_err |= SockError::ERR_ACCEPT;
+  Trace::record(trace_kind::sock_accept, sockno(*sock),
+                sockno(*sock) == -1 ? GET_SOCKERRNO() : 0);
+  return this;
+}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *
+socket_builder<Node, Trace>::option(int level, int name, int value) {
+  if (setsockopt(sockno(*sock), level, name, &value, sizeof(value)) == -1) {
+    sock_err |= SockError::ERR_SOCKOPT;
+    Trace::record(trace_kind::sock_option, sockno(*sock), GET_SOCKERRNO());
+  } else {
+    Trace::record(trace_kind::sock_option, sockno(*sock), 0);
   }
   return this;
 }
 
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *
+socket_builder<Node, Trace>::join_group(gsl::czstring<> group,
+                                        gsl::czstring<> iface) {
+  auto rc = multicast_membership(sockno(*sock), sock_traits::domain, group,
+                                 iface, true);
+  if (rc == -1)
+    sock_err |= SockError::ERR_SOCKOPT;
+  Trace::record(trace_kind::sock_option, sockno(*sock),
+                rc == -1 ? GET_SOCKERRNO() : 0);
+  return this;
+}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *
+socket_builder<Node, Trace>::leave_group(gsl::czstring<> group,
+                                         gsl::czstring<> iface) {
+  auto rc = multicast_membership(sockno(*sock), sock_traits::domain, group,
+                                 iface, false);
+  if (rc == -1)
+    sock_err |= SockError::ERR_SOCKOPT;
+  Trace::record(trace_kind::sock_option, sockno(*sock),
+                rc == -1 ? GET_SOCKERRNO() : 0);
+  return this;
+}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *
+socket_builder<Node, Trace>::multicast_ttl(int hops) {
+  auto opts = multicast_options_for(sock_traits::domain);
+  return option(opts.level, opts.ttl, hops);
+}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *
+socket_builder<Node, Trace>::multicast_loop(bool enable) {
+  auto opts = multicast_options_for(sock_traits::domain);
+  return option(opts.level, opts.loop, enable ? 1 : 0);
+}
+
+template <typename Node, typename Trace>
+socket_builder<Node, Trace> *
+socket_builder<Node, Trace>::multicast_interface(gsl::czstring<> iface) {
+  int rc = -1;
+  if (sock_traits::domain == AF_INET) {
+    struct in_addr addr {};
+    if (inet_pton(AF_INET, iface, &addr) == 1)
+      rc = setsockopt(sockno(*sock), IPPROTO_IP, IP_MULTICAST_IF, &addr,
+                      sizeof(addr));
+    else
+      errno = EINVAL;
+  } else if (sock_traits::domain == AF_INET6) {
+    int index = if_nametoindex(iface);
+    if (index != 0)
+      rc = setsockopt(sockno(*sock), IPPROTO_IPV6, IPV6_MULTICAST_IF, &index,
+                      sizeof(index));
+    else
+      errno = EINVAL;
+  } else {
+    errno = EAFNOSUPPORT;
+  }
+
+  if (rc == -1)
+    sock_err |= SockError::ERR_SOCKOPT;
+  Trace::record(trace_kind::sock_option, sockno(*sock),
+                rc == -1 ? GET_SOCKERRNO() : 0);
+  return this;
+}
+
 template struct socket_builder<socket_node<struct sockaddr_un, SOCK_DGRAM>>;
+template struct socket_builder<socket_node<struct sockaddr_un, SOCK_DGRAM>,
+                               ring_trace>;
+template struct socket_builder<socket_node<struct sockaddr_in, SOCK_DGRAM>>;
+template struct socket_builder<socket_node<struct sockaddr_in, SOCK_DGRAM>,
+                               ring_trace>;
+template struct socket_builder<socket_node<struct sockaddr_in6, SOCK_DGRAM>>;
+template struct socket_builder<socket_node<struct sockaddr_in6, SOCK_DGRAM>,
+                               ring_trace>;
+template struct socket_builder<socket_node<struct sockaddr_un, SOCK_STREAM>>;
+template struct socket_builder<socket_node<struct sockaddr_un, SOCK_STREAM>,
+                               ring_trace>;
+template struct socket_builder<socket_node<struct sockaddr_in, SOCK_STREAM>>;
+template struct socket_builder<socket_node<struct sockaddr_in, SOCK_STREAM>,
+                               ring_trace>;
+template struct socket_builder<socket_node<struct sockaddr_in6, SOCK_STREAM>>;
+template struct socket_builder<socket_node<struct sockaddr_in6, SOCK_STREAM>,
+                               ring_trace>;
+template struct socket_builder<socket_node<struct sockaddr_un, SOCK_SEQPACKET>>;
+template struct socket_builder<socket_node<struct sockaddr_un, SOCK_SEQPACKET>,
+                               ring_trace>;
 
 } // namespace ip
 } // namespace wasl
@@ -0,0 +1,176 @@
+#include <wasl/Trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+namespace wasl {
+namespace ip {
+
+namespace {
+
+struct trace_file_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t reserved;
+  uint64_t count;
+};
+
+constexpr char trace_magic[4] = {'W', 'T', 'R', 'C'};
+constexpr uint32_t trace_version = 1;
+
+struct ring_registry {
+  std::mutex lock;
+  std::vector<std::unique_ptr<trace_ring>> rings;
+};
+
+ring_registry &registry() {
+  static ring_registry reg;
+  return reg;
+}
+
+const char *kind_name(uint16_t kind) {
+  switch (static_cast<trace_kind>(kind)) {
+  case trace_kind::fd_ready:
+    return "fd_ready";
+  case trace_kind::handler_begin:
+  case trace_kind::handler_end:
+    return "handler";
+  case trace_kind::bytes_sent:
+    return "bytes_sent";
+  case trace_kind::bytes_received:
+    return "bytes_received";
+  case trace_kind::sock_open:
+    return "socket";
+  case trace_kind::sock_bind:
+    return "bind";
+  case trace_kind::sock_connect:
+    return "connect";
+  case trace_kind::sock_option:
+    return "setsockopt";
+  case trace_kind::sock_listen:
+    return "listen";
+  case trace_kind::sock_accept:
+    return "accept";
+  }
+  return "unknown";
+}
+
+char phase(uint16_t kind) {
+  switch (static_cast<trace_kind>(kind)) {
+  case trace_kind::handler_begin:
+    return 'B';
+  case trace_kind::handler_end:
+    return 'E';
+  default:
+    return 'i';
+  }
+}
+
+} // namespace
+
+void trace_ring::read(std::vector<trace_record> &out) const {
+  auto head = _head.load(std::memory_order_acquire);
+  auto first = head > capacity ? head - capacity : 0;
+
+  std::vector<trace_record> copy;
+  copy.reserve(head - first);
+  for (auto i = first; i < head; ++i)
+    copy.push_back(_records[i & (capacity - 1)]);
+
+  // drop whatever the producer lapped while we were copying
+  auto after = _head.load(std::memory_order_acquire);
+  auto valid_from = after > capacity ? after - capacity : 0;
+  auto skip = valid_from > first ? std::min<uint64_t>(valid_from - first,
+                                                      copy.size())
+                                 : 0;
+  out.insert(out.end(), copy.begin() + skip, copy.end());
+}
+
+trace_ring *ring_trace::register_thread() {
+  auto &reg = registry();
+  std::lock_guard<std::mutex> guard(reg.lock);
+  reg.rings.push_back(
+      std::make_unique<trace_ring>(static_cast<uint32_t>(reg.rings.size() + 1)));
+  return reg.rings.back().get();
+}
+
+uint64_t ring_trace::now_ns() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::vector<trace_record> ring_trace::collect() {
+  std::vector<trace_record> records;
+  {
+    auto &reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    for (const auto &ring : reg.rings)
+      ring->read(records);
+  }
+
+  std::stable_sort(records.begin(), records.end(),
+                   [](const trace_record &a, const trace_record &b) {
+                     return a.ts_ns < b.ts_ns;
+                   });
+  return records;
+}
+
+bool ring_trace::dump(gsl::czstring<> path) {
+  auto records = collect();
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out)
+    return false;
+
+  trace_file_header header{};
+  memcpy(header.magic, trace_magic, sizeof(header.magic));
+  header.version = trace_version;
+  header.record_size = sizeof(trace_record);
+  header.count = records.size();
+
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(records.data()),
+            records.size() * sizeof(trace_record));
+  return static_cast<bool>(out);
+}
+
+bool trace_to_chrome_json(std::istream &in, std::ostream &out) {
+  trace_file_header header{};
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      memcmp(header.magic, trace_magic, sizeof(header.magic)) != 0 ||
+      header.version != trace_version ||
+      header.record_size != sizeof(trace_record)) {
+    return false;
+  }
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+  trace_record rec;
+  for (uint64_t i = 0; i < header.count; ++i) {
+    if (!in.read(reinterpret_cast<char *>(&rec), sizeof(rec)))
+      return false;
+
+    auto ph = phase(rec.kind);
+    out << (i ? ",\n" : "\n") << "{\"name\":\"" << kind_name(rec.kind)
+        << "\",\"ph\":\"" << ph << "\",\"ts\":" << rec.ts_ns / 1000 << '.'
+        << rec.ts_ns % 1000 / 100 << rec.ts_ns % 100 / 10 << rec.ts_ns % 10
+        << ",\"pid\":0,\"tid\":" << rec.tid;
+    if (ph == 'i')
+      out << ",\"s\":\"t\"";
+    out << ",\"args\":{\"fd\":" << rec.fd << ",\"arg\":" << rec.arg << "}}";
+  }
+
+  out << "\n]}\n";
+  return static_cast<bool>(out);
+}
+
+} // namespace ip
+} // namespace wasl
@@ -0,0 +1,151 @@
+#include <wasl/Acceptor.h>
+#include <wasl/IOMultiplexer.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std::string_literals;
+using namespace wasl::ip;
+
+namespace {
+
+constexpr gsl::czstring<> srv_path{"/tmp/wasl/acceptor"};
+
+using mux_type = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+using acceptor_type = acceptor<socket_seqpacket_local, mux_type>;
+
+std::unique_ptr<socket_seqpacket_local> connect_to(SOCKET listener) {
+  return std::unique_ptr<socket_seqpacket_local>(
+      socket_seqpacket_local::create("")->socket()->connect(listener)->build());
+}
+
+} // namespace
+
+TEST(acceptor, RegistersConnectionsWithTheReactor) {
+  auto listener{make_listener<sockaddr_un, SOCK_SEQPACKET>(srv_path)};
+  ASSERT_TRUE(listener);
+
+  mux_type mux;
+  acceptor_type acc{mux, sockno(*listener)};
+  std::vector<std::string> received;
+  ASSERT_TRUE(acc.start([&](socket_seqpacket_local &conn) {
+    mux.bind_event(sockno(conn), labeled_handler<std::string>{
+                                     "conn"s, [&](SOCKET fd, std::string) {
+                                       char buf[64];
+                                       auto n = recv(fd, buf, sizeof(buf), 0);
+                                       if (n > 0)
+                                         received.emplace_back(buf, n);
+                                       else
+                                         acc.close(fd);
+                                     }});
+  }));
+
+  auto a{connect_to(sockno(*listener))};
+  auto b{connect_to(sockno(*listener))};
+  ASSERT_EQ(send(sockno(*a), "from a", 6, 0), 6);
+  ASSERT_EQ(send(sockno(*b), "from b", 6, 0), 6);
+
+  while (received.size() < 2)
+    mux.listen();
+  ASSERT_EQ(acc.accepted(), 2u);
+  ASSERT_EQ(acc.connections(), 2u);
+  std::sort(received.begin(), received.end());
+  ASSERT_EQ(received, (std::vector<std::string>{"from a", "from b"}));
+
+  // end of stream closes the connection
+  a.reset();
+  while (acc.connections() > 1)
+    mux.listen();
+  ASSERT_EQ(acc.errors(), 0u);
+}
+
+TEST(acceptor, ClosesItsConnectionsWhenDestroyed) {
+  auto listener{make_listener<sockaddr_un, SOCK_SEQPACKET>(srv_path)};
+  mux_type mux;
+  auto client{connect_to(sockno(*listener))};
+  {
+    acceptor_type acc{mux, sockno(*listener)};
+    SOCKET accepted = INVALID_SOCKET;
+    ASSERT_TRUE(acc.start(
+        [&](socket_seqpacket_local &conn) { accepted = sockno(conn); }));
+    while (acc.connections() == 0)
+      mux.listen();
+    ASSERT_NE(acc.find(accepted), nullptr);
+    ASSERT_EQ(acc.find(sockno(*client)), nullptr);
+  }
+
+  // the peer sees the end of stream
+  char c;
+  ASSERT_EQ(recv(sockno(*client), &c, 1, 0), 0);
+}
+
+TEST(acceptor, DrainsTheQueueInBatches) {
+  auto listener{make_listener<sockaddr_un, SOCK_SEQPACKET>(srv_path)};
+  mux_type mux;
+  std::vector<std::unique_ptr<socket_seqpacket_local>> clients;
+  for (int i = 0; i < 10; ++i)
+    clients.push_back(connect_to(sockno(*listener)));
+
+  acceptor_type acc{mux, sockno(*listener), SOCK_NONBLOCK | SOCK_CLOEXEC, 4};
+  ASSERT_TRUE(acc.start([](socket_seqpacket_local &) {}));
+  mux.listen();
+  ASSERT_EQ(acc.wakeups(), 1u);
+  ASSERT_EQ(acc.accepted(), 4u);
+
+  while (acc.accepted() < 10)
+    mux.listen();
+  ASSERT_EQ(acc.wakeups(), 3u);
+  ASSERT_EQ(acc.errors(), 0u);
+
+  // a wakeup takes whatever queued since, up to the batch
+  clients.push_back(connect_to(sockno(*listener)));
+  clients.push_back(connect_to(sockno(*listener)));
+  mux.listen();
+  ASSERT_EQ(acc.wakeups(), 4u);
+  ASSERT_EQ(acc.accepted(), 12u);
+}
+
+TEST(acceptor, StopsTheBatchOnListenerErrors) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_DGRAM, 0, fds), 0);
+  mux_type mux;
+
+  // readable, but accept4() fails on it every time
+  acceptor_type acc{mux, fds[0]};
+  ASSERT_TRUE(acc.start([](socket_seqpacket_local &) {}));
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  mux.listen();
+  ASSERT_EQ(acc.wakeups(), 1u);
+  ASSERT_EQ(acc.errors(), 1u);
+  ASSERT_EQ(acc.accepted(), 0u);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(acceptor, ShardsSpreadConnectionsAcrossReusePortListeners) {
+  using tcp_acceptor = acceptor<socket_stream_tcp, mux_type>;
+  auto listeners{make_reuseport_listeners<sockaddr_in>("127.0.0.1:0", 2)};
+  ASSERT_EQ(listeners.size(), 2u);
+  auto path = address_path(get_address<sockaddr_in>(sockno(*listeners[0])));
+
+  mux_type mux;
+  tcp_acceptor first{mux, sockno(*listeners[0])};
+  tcp_acceptor second{mux, sockno(*listeners[1])};
+  ASSERT_TRUE(first.start([](socket_stream_tcp &) {}));
+  ASSERT_TRUE(second.start([](socket_stream_tcp &) {}));
+
+  // connections hash to a listener by their source port
+  std::vector<std::unique_ptr<socket_stream_tcp>> clients;
+  for (int i = 0; i < 32; ++i) {
+    clients.push_back(make_connection<sockaddr_in, SOCK_STREAM>(path.c_str()));
+    ASSERT_TRUE(clients.back());
+  }
+  while (first.accepted() + second.accepted() < 32)
+    mux.listen();
+  ASSERT_GT(first.accepted(), 0u);
+  ASSERT_GT(second.accepted(), 0u);
+}
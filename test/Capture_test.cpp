@@ -0,0 +1,245 @@
+#include <wasl/Capture.h>
+#include <wasl/Datagram.h>
+#include <wasl/SockStream.h>
+#include <wasl/Socket.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+/// A capture file of the running test's own, so tests can run in parallel.
+std::string capture_path() {
+  return std::string{"/tmp/wasl/capture_"} +
+         ::testing::UnitTest::GetInstance()->current_test_info()->name() +
+         ".wcap";
+}
+
+constexpr gsl::czstring<> target_path{"/tmp/wasl/capture_target"};
+
+struct dgram_pair {
+  dgram_pair() { socketpair(AF_LOCAL, SOCK_DGRAM, 0, fds); }
+  ~dgram_pair() {
+    close(fds[0]);
+    close(fds[1]);
+  }
+  int fds[2];
+};
+
+/// Capture through active_capture() for the lifetime of the guard.
+struct capture_guard {
+  explicit capture_guard(capture_file &file) { active_capture() = &file; }
+  ~capture_guard() { active_capture() = nullptr; }
+};
+
+using tapped_sockio = capture_sockio<basic_sockio<wasl::platform_type>>;
+
+} // namespace
+
+TEST(capture_file, RecordsReadBackInOrder) {
+  {
+    capture_file capture(capture_path().c_str());
+    ASSERT_TRUE(capture);
+    capture.set_topic(7, 42);
+    ASSERT_TRUE(capture.append(7, capture_dir::IN, "hello", 5, 1000));
+    // an empty record would end the capture for readers
+    ASSERT_FALSE(capture.append(7, capture_dir::IN, "", 0, 1500));
+    ASSERT_TRUE(capture.append(8, capture_dir::OUT, "world!", 6, 2000));
+    ASSERT_EQ(capture.records(), 2u);
+  }
+
+  capture_reader reader(capture_path().c_str());
+  ASSERT_TRUE(reader);
+
+  std::vector<std::string> payloads;
+  std::vector<capture_record> records;
+  auto n = reader.for_each(
+      [&](const capture_record &rec, gsl::span<const char> payload) {
+        records.push_back(rec);
+        payloads.emplace_back(payload.data(), payload.size());
+      });
+
+  ASSERT_EQ(n, 2u);
+  ASSERT_EQ(payloads[0], "hello");
+  ASSERT_EQ(payloads[1], "world!");
+  ASSERT_EQ(records[0].fd, 7);
+  ASSERT_EQ(records[0].topic, 42u);
+  ASSERT_EQ(records[0].time_ns, 1000u);
+  ASSERT_EQ(records[0].dir, static_cast<uint8_t>(capture_dir::IN));
+  ASSERT_EQ(records[1].fd, 8);
+  ASSERT_EQ(records[1].topic, 0u);
+  ASSERT_EQ(records[1].dir, static_cast<uint8_t>(capture_dir::OUT));
+}
+
+TEST(capture_reader, OutlivesTheCaptureFile) {
+  std::unique_ptr<capture_file> capture{
+      new capture_file(capture_path().c_str(), 1 << 16)};
+  ASSERT_TRUE(*capture);
+  // ends the first page, so the next header is on a page of its own
+  const std::string msg(4096 - capture_file::header_size -
+                            sizeof(capture_record),
+                        'x');
+  ASSERT_TRUE(capture->append(3, capture_dir::IN, msg.data(), msg.size()));
+
+  capture_reader reader(capture_path().c_str());
+  ASSERT_TRUE(reader);
+  capture.reset();
+  ASSERT_EQ(reader.for_each([](const capture_record &,
+                               gsl::span<const char>) {}),
+            1u);
+}
+
+TEST(capture_file, CountsMessagesPastCapacityAsDropped) {
+  capture_file capture(capture_path().c_str(), 128);
+  ASSERT_TRUE(capture);
+
+  const std::string msg(40, 'x');
+  ASSERT_TRUE(capture.append(3, capture_dir::IN, msg.data(), msg.size()));
+  ASSERT_FALSE(capture.append(3, capture_dir::IN, msg.data(), msg.size()));
+  ASSERT_FALSE(capture.append(3, capture_dir::IN, "y", 1));
+  ASSERT_EQ(capture.records(), 1u);
+  ASSERT_EQ(capture.dropped(), 2u);
+
+  capture_reader reader(capture_path().c_str());
+  ASSERT_EQ(reader.for_each([](const capture_record &,
+                               gsl::span<const char>) {}),
+            1u);
+}
+
+TEST(capture_reader, RejectsOtherFiles) {
+  {
+    std::ofstream out(capture_path(), std::ios::trunc);
+    out << "certainly not a capture file";
+  }
+  capture_reader reader(capture_path().c_str());
+  ASSERT_FALSE(reader);
+  ASSERT_EQ(errno, EPROTO);
+}
+
+TEST(capture_sockio, TapsSocketTraffic) {
+  dgram_pair pair;
+  capture_file capture(capture_path().c_str());
+  capture.set_topic(pair.fds[1], 9);
+
+  char buf[] = "ping";
+  ASSERT_EQ(tapped_sockio::rv_send(pair.fds[0], buf, 4), 4);
+  {
+    capture_guard tap(capture);
+    char in[16];
+    ASSERT_EQ(tapped_sockio::rv_recv_msg(pair.fds[1], in, sizeof(in),
+                                         MSG_PEEK),
+              4);
+    ASSERT_EQ(tapped_sockio::rv_recv_msg(pair.fds[1], in, sizeof(in)), 4);
+
+    char reply[] = "pong";
+    struct iovec iov[2] = {{reply, 2}, {reply + 2, 2}};
+    ASSERT_EQ(tapped_sockio::rv_sendv(pair.fds[1], iov, 2), 4);
+  }
+  ASSERT_EQ(tapped_sockio::rv_send(pair.fds[0], buf, 4), 4);
+
+  // the send before the tap and after it, and the peek, are not captured
+  ASSERT_EQ(capture.records(), 2u);
+
+  capture_reader reader(capture_path().c_str());
+  std::vector<std::string> seen;
+  reader.for_each([&](const capture_record &rec, gsl::span<const char> p) {
+    ASSERT_EQ(rec.fd, pair.fds[1]);
+    ASSERT_EQ(rec.topic, 9u);
+    seen.push_back((rec.dir == static_cast<uint8_t>(capture_dir::IN) ? "in:"
+                                                                     : "out:") +
+                   std::string(p.data(), p.size()));
+  });
+  ASSERT_EQ(seen, (std::vector<std::string>{"in:ping", "out:pong"}));
+}
+
+TEST(replay, ReinjectsIntoASocketNode) {
+  {
+    capture_file capture(capture_path().c_str());
+    capture.append(5, capture_dir::IN, "one", 3, 1000);
+    capture.append(5, capture_dir::OUT, "reply", 5, 1500);
+    capture.append(6, capture_dir::IN, "other fd", 8, 1800);
+    capture.append(5, capture_dir::IN, "two", 3, 2000);
+  }
+
+  auto target{make_socket<sockaddr_un, SOCK_DGRAM>(target_path)};
+  ASSERT_TRUE(target);
+  auto sender{make_socket<sockaddr_un, SOCK_DGRAM>("/tmp/wasl/capture_src")};
+  ASSERT_TRUE(sender);
+
+  peer_address to;
+  auto addr = c_addr(*target);
+  memcpy(&to.addr, &addr, sizeof(addr));
+  to.len = sizeof(addr);
+
+  capture_reader reader(capture_path().c_str());
+  replay_options options;
+  options.speed = 0;
+  options.fd = 5;
+  auto sent = replay(reader, options, [&](const capture_record &,
+                                          gsl::span<const char> p) {
+    return basic_sockio<wasl::platform_type>::rv_send_to(sockno(*sender), p.data(),
+                                                   p.size(), to) > 0;
+  });
+  ASSERT_EQ(sent, 2u);
+
+  char buf[16];
+  auto n = recv(sockno(*target), buf, sizeof(buf), MSG_DONTWAIT);
+  ASSERT_EQ(std::string(buf, n), "one");
+  n = recv(sockno(*target), buf, sizeof(buf), MSG_DONTWAIT);
+  ASSERT_EQ(std::string(buf, n), "two");
+  ASSERT_LT(recv(sockno(*target), buf, sizeof(buf), MSG_DONTWAIT), 0);
+}
+
+TEST(replay, PacesByCaptureTimeOverSpeed) {
+  using namespace std::chrono;
+  {
+    capture_file capture(capture_path().c_str());
+    capture.append(5, capture_dir::IN, "a", 1, 1000000000);
+    capture.append(5, capture_dir::IN, "b", 1, 1040000000); // +40ms
+  }
+  capture_reader reader(capture_path().c_str());
+  auto noop = [](const capture_record &, gsl::span<const char>) {
+    return true;
+  };
+
+  auto timed = [&](double speed) {
+    replay_options options;
+    options.speed = speed;
+    auto start = steady_clock::now();
+    replay(reader, options, noop);
+    return duration_cast<milliseconds>(steady_clock::now() - start).count();
+  };
+
+  ASSERT_GE(timed(1), 40);
+  auto fast = timed(4);
+  ASSERT_GE(fast, 10);
+  ASSERT_LT(fast, 40);
+  ASSERT_LT(timed(0), 10);
+}
+
+TEST(replay, StopsWhenSendFails) {
+  {
+    capture_file capture(capture_path().c_str());
+    for (int i = 0; i < 5; ++i)
+      capture.append(5, capture_dir::IN, "x", 1);
+  }
+  capture_reader reader(capture_path().c_str());
+  replay_options options;
+  options.speed = 0;
+
+  int calls = 0;
+  auto sent = replay(reader, options,
+                     [&](const capture_record &, gsl::span<const char>) {
+                       return ++calls < 3;
+                     });
+  ASSERT_EQ(calls, 3);
+  ASSERT_EQ(sent, 2u);
+}
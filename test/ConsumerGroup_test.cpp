@@ -0,0 +1,162 @@
+#include <wasl/ConsumerGroup.h>
+#include <wasl/IOMultiplexer.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+using mux_type = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+using group_type = consumer_group<mux_type>;
+
+/// Group side and consumer side of n member socketpairs.
+struct members {
+  explicit members(int n) {
+    for (int i = 0; i < n; ++i) {
+      int fds[2];
+      socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+      group_side.push_back(fds[0]);
+      consumer_side.push_back(fds[1]);
+    }
+  }
+  ~members() {
+    for (auto fd : group_side)
+      close(fd);
+    for (auto fd : consumer_side)
+      if (fd != INVALID_SOCKET)
+        close(fd);
+  }
+
+  std::vector<SOCKET> group_side;
+  std::vector<SOCKET> consumer_side;
+};
+
+} // namespace
+
+TEST(consumer_group, RoundRobinSendsEachMessageToOneMember) {
+  mux_type mux;
+  members m(3);
+  group_type group{mux, balance_strategy::ROUND_ROBIN};
+  for (auto fd : m.group_side)
+    ASSERT_TRUE(group.join(fd));
+  ASSERT_FALSE(group.join(m.group_side[0]));
+
+  for (int i = 0; i < 9; ++i)
+    ASSERT_NE(group.publish("x"), INVALID_SOCKET);
+
+  for (std::size_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(group.delivered(m.group_side[i]), 3u);
+    char buf[16];
+    ASSERT_EQ(recv(m.consumer_side[i], buf, sizeof(buf), MSG_DONTWAIT), 3);
+  }
+}
+
+TEST(consumer_group, LeastOutstandingFavorsMembersThatAcknowledge) {
+  mux_type mux;
+  members m(2);
+  group_type group{mux, balance_strategy::LEAST_OUTSTANDING};
+  for (auto fd : m.group_side)
+    group.join(fd);
+
+  group.publish("a");
+  group.publish("b");
+  ASSERT_EQ(group.outstanding(m.group_side[0]), 1u);
+  ASSERT_EQ(group.outstanding(m.group_side[1]), 1u);
+
+  // only the first member keeps up
+  ASSERT_EQ(write(m.consumer_side[0], "k", 1), 1);
+  mux.listen();
+  ASSERT_EQ(group.outstanding(m.group_side[0]), 0u);
+
+  ASSERT_EQ(group.publish("c"), m.group_side[0]);
+  ASSERT_EQ(write(m.consumer_side[0], "k", 1), 1);
+  mux.listen();
+  ASSERT_EQ(group.publish("d"), m.group_side[0]);
+}
+
+TEST(consumer_group, ConsistentHashKeepsKeysOnSurvivingMembers) {
+  mux_type mux;
+  members m(4);
+  group_type group{mux, balance_strategy::CONSISTENT_HASH, 4096};
+  for (auto fd : m.group_side)
+    group.join(fd);
+
+  std::map<uint64_t, SOCKET> owner;
+  for (uint64_t key = 0; key < 200; ++key) {
+    owner[key] = group.publish("k", key);
+    ASSERT_EQ(group.publish("k", key), owner[key]);
+  }
+
+  auto gone = m.group_side[1];
+  ASSERT_TRUE(group.leave(gone));
+  int moved = 0;
+  for (uint64_t key = 0; key < 200; ++key) {
+    auto now = group.publish("k", key);
+    ASSERT_NE(now, gone);
+    if (owner[key] != gone)
+      ASSERT_EQ(now, owner[key]);
+    else
+      ++moved;
+  }
+  ASSERT_GT(moved, 0);
+}
+
+TEST(consumer_group, MemberLeavesWhenItsPeerCloses) {
+  mux_type mux;
+  members m(2);
+  group_type group{mux, balance_strategy::ROUND_ROBIN};
+  for (auto fd : m.group_side)
+    group.join(fd);
+
+  SOCKET left = INVALID_SOCKET;
+  group.on_leave([&left](SOCKET fd) { left = fd; });
+
+  close(m.consumer_side[0]);
+  m.consumer_side[0] = INVALID_SOCKET;
+  mux.listen();
+
+  ASSERT_EQ(left, m.group_side[0]);
+  ASSERT_EQ(group.size(), 1u);
+  for (int i = 0; i < 3; ++i)
+    ASSERT_EQ(group.publish("x"), m.group_side[1]);
+}
+
+TEST(consumer_group, EvictedMessagesAreNotCountedAsDelivered) {
+  mux_type mux;
+  members m(1);
+  int sndbuf = 4096;
+  setsockopt(m.group_side[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+  group_type group{mux, balance_strategy::LEAST_OUTSTANDING, 4,
+                   overflow_policy::CONFLATE};
+  ASSERT_TRUE(group.join(m.group_side[0]));
+
+  const std::size_t size = 1000;
+  for (int i = 0; i < 60; ++i)
+    group.publish(std::string(size, 'x'), i % 8);
+  auto delivered = group.delivered(m.group_side[0]);
+  ASSERT_LT(delivered, 60u);
+  ASSERT_EQ(group.outstanding(m.group_side[0]), delivered);
+
+  std::size_t received = 0;
+  char buf[4096];
+  for (int round = 0; round < 1000 && received < delivered * size; ++round) {
+    ssize_t n;
+    while ((n = recv(m.consumer_side[0], buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+      received += n;
+    mux.post([] {});
+    mux.listen();
+  }
+  ASSERT_EQ(received, delivered * size);
+}
+
+TEST(consumer_group, EmptyGroupRejectsMessages) {
+  mux_type mux;
+  group_type group{mux, balance_strategy::LEAST_OUTSTANDING};
+  ASSERT_EQ(group.publish("x"), INVALID_SOCKET);
+}
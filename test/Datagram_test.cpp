@@ -0,0 +1,133 @@
+#include <wasl/Datagram.h>
+#include <wasl/Message.h>
+#include <wasl/Metrics.h>
+#include <wasl/Socket.h>
+
+#include <string>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+struct dgram_pair {
+  dgram_pair() { socketpair(AF_LOCAL, SOCK_DGRAM, 0, fds); }
+  ~dgram_pair() {
+    close(fds[0]);
+    close(fds[1]);
+  }
+  int fds[2];
+};
+
+} // namespace
+
+TEST(dgram_sockstream, ReceivesDatagramsLargerThanBuflen) {
+  dgram_pair pair;
+  dgram_sockstream rx(pair.fds[1]);
+  const std::string big(64 * 1024, 'x');
+  ASSERT_EQ(send(pair.fds[0], big.data(), big.size(), 0),
+            static_cast<ssize_t>(big.size()));
+
+  std::string got;
+  rx >> got;
+  ASSERT_EQ(got, big);
+  ASSERT_EQ(static_cast<std::size_t>(rx.message().size()), big.size());
+}
+
+TEST(dgram_sockstream, ReadsStopAtDatagramBoundaries) {
+  dgram_pair pair;
+  dgram_sockstream rx(pair.fds[1]);
+  send(pair.fds[0], "1 2", 3, 0);
+  send(pair.fds[0], "3", 1, 0);
+
+  int a = 0, b = 0, c = 0;
+  rx >> a >> b;
+  ASSERT_EQ(a, 1);
+  ASSERT_EQ(b, 2);
+  ASSERT_FALSE(rx >> c);
+
+  ASSERT_TRUE(rx.next());
+  ASSERT_TRUE(rx >> c);
+  ASSERT_EQ(c, 3);
+}
+
+TEST(dgram_sockstream, NextDropsTheUnreadRemainder) {
+  dgram_pair pair;
+  dgram_sockstream rx(pair.fds[1]);
+  send(pair.fds[0], "first datagram", 14, 0);
+  send(pair.fds[0], "second", 6, 0);
+
+  std::string word;
+  rx >> word;
+  ASSERT_EQ(word, "first");
+  rx.next() >> word;
+  ASSERT_EQ(word, "second");
+}
+
+TEST(dgram_sockstream, EachFlushSendsOneDatagram) {
+  dgram_pair pair;
+  dgram_sockstream tx(pair.fds[0]);
+  const std::string big(1000, 'y');
+  tx << big << "!" << std::flush;
+  tx << "small" << std::flush;
+
+  char buf[2048];
+  ASSERT_EQ(recv(pair.fds[1], buf, sizeof(buf), 0), 1001);
+  ASSERT_EQ(recv(pair.fds[1], buf, sizeof(buf), 0), 5);
+}
+
+TEST(dgram_sockstream, MessageViewsAWholeBinaryDatagram) {
+  dgram_pair pair;
+  dgram_sockstream rx(pair.fds[1]);
+  char payload[3000];
+  message_header header;
+  header.length = sizeof(payload) - sizeof(header);
+  memcpy(payload, &header, sizeof(header));
+  send(pair.fds[0], payload, sizeof(payload), 0);
+
+  ASSERT_TRUE(rx.next());
+  auto msg = rx.message();
+  message_view view(msg.data(), msg.size());
+  ASSERT_TRUE(view.valid());
+  ASSERT_EQ(view.payload_size(), sizeof(payload) - sizeof(header));
+}
+
+TEST(dgram_sockstream, ReportsKernelArrivalTimes) {
+  auto builder = socket_dgram_local::create("/tmp/wasl/srv");
+  builder->socket()->bind()->timestamps();
+  std::unique_ptr<socket_dgram_local> srv{builder->build()};
+  auto cl{make_socket<sockaddr_un, SOCK_DGRAM>("/tmp/wasl/cl")};
+  ASSERT_EQ(socket_connect(cl.get(), sockno(*srv)), 0);
+  dgram_sockstream rx(sockno(*srv));
+
+  auto before = realtime_ns();
+  send(sockno(*cl), "t", 1, 0);
+  ASSERT_TRUE(rx.next());
+  ASSERT_GE(rx.arrival_ns(), before);
+  ASSERT_LE(rx.arrival_ns(), realtime_ns());
+}
+
+TEST(seqpacket_sockstream, KeepsMessageBoundariesOverAConnection) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_SEQPACKET, 0, fds), 0);
+  {
+    seqpacket_sockstream tx(fds[0]);
+    seqpacket_sockstream rx(fds[1]);
+    tx << "first " << 1 << std::flush;
+    tx << "second" << std::flush;
+
+    std::string word;
+    int n;
+    rx >> word >> n;
+    ASSERT_EQ(word, "first");
+    ASSERT_EQ(n, 1);
+    ASSERT_FALSE(rx >> word); // end of the message
+
+    rx.next() >> word;
+    ASSERT_EQ(word, "second");
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
@@ -0,0 +1,87 @@
+#include <wasl/Handlers.h>
+#include <wasl/IOMultiplexer.h>
+
+#include <memory>
+#include <string>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace std::string_literals;
+using namespace wasl::ip;
+using wasl::handler_set;
+using wasl::inplace_function;
+
+TEST(inplace_function, InvokesCopiesAndMovesTheCallable) {
+  auto counter = std::make_shared<int>(0);
+  inplace_function<int(int)> f = [counter](int x) { return *counter += x; };
+  ASSERT_TRUE(f);
+
+  auto g = f;
+  ASSERT_EQ(f(1), 1);
+  ASSERT_EQ(g(2), 3);
+  ASSERT_EQ(counter.use_count(), 3);
+
+  auto h = std::move(g);
+  ASSERT_EQ(h(3), 6);
+
+  f = inplace_function<int(int)>{};
+  ASSERT_FALSE(f);
+}
+
+TEST(handler_set, DispatchesByIndex) {
+  std::string seen;
+  handler_set<std::function<void(int)>, std::function<void(int)>> set{
+      [&seen](int) { seen += 'a'; }, [&seen](int) { seen += 'b'; }};
+  int arg = 0;
+  set.dispatch(1, arg);
+  set.dispatch(0, arg);
+  set.dispatch(7, arg); // ignored
+  ASSERT_EQ(seen, "ba");
+}
+
+TEST(static_io_mux, DispatchesToCompileTimeHandlers) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+
+  int quotes = 0, trades = 0;
+  auto on_quote = [&quotes](SOCKET fd, const std::string &) {
+    char c;
+    quotes += read(fd, &c, 1);
+  };
+  auto on_trade = [&trades](SOCKET, const std::string &) { ++trades; };
+  auto muxer{make_static_muxer<SOCKET>(on_quote, on_trade)};
+
+  ASSERT_TRUE(muxer->add(fds[0]));
+  muxer->bind_handler<0>(fds[0], "quotes");
+
+  ASSERT_EQ(write(fds[1], "q", 1), 1);
+  muxer->listen();
+  ASSERT_EQ(quotes, 1);
+  ASSERT_EQ(trades, 0);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(io_mux_base, AcceptsNonAllocatingHandlerType) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+
+  using handler = inplace_function<void(SOCKET, std::string)>;
+  io_mux_base<SOCKET, epoll_muxer<SOCKET>, null_trace, handler> muxer;
+  ASSERT_TRUE(muxer.add(fds[0]));
+
+  std::string msg;
+  muxer.bind_event(fds[0], labeled_handler<std::string, handler>{
+                               "sbo"s, [&msg](SOCKET, std::string m) {
+                                 msg = std::move(m);
+                               }});
+
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  muxer.listen();
+  ASSERT_EQ(msg, "iomux event triggered: sbo");
+
+  close(fds[0]);
+  close(fds[1]);
+}
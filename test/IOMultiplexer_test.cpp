@@ -2,6 +2,8 @@
 #include <wasl/SockStream.h>
 #include <wasl/Socket.h>
 
+#include <algorithm>
+#include <chrono>
 #include <atomic>
 #include <functional>
 #include <iterator>
@@ -74,3 +76,338 @@ TEST(IOMuxEpollingDatagram, CanDispatchEventDelegates) {
   std::thread listener(listen_n, 3);
   thread_guard tl(listener);
 }
+
+TEST(IOMuxLifecycle, BindEventReplacesStaleHandler) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(muxer->add(fds[0]));
+
+  std::string called;
+  ASSERT_FALSE(muxer->rebind(fds[0], labeled_handler<std::string>{
+                                         "b"s, [](SOCKET, std::string) {}}));
+  muxer->bind_event(fds[0], labeled_handler<std::string>{
+                                "a"s, [&](SOCKET, std::string) { called = "a"; }});
+  muxer->bind_event(fds[0], labeled_handler<std::string>{
+                                "b"s, [&](SOCKET, std::string) { called = "b"; }});
+
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  muxer->listen();
+  ASSERT_EQ(called, "b");
+
+  ASSERT_TRUE(muxer->rebind(fds[0], labeled_handler<std::string>{
+                                        "c"s, [&](SOCKET, std::string) { called = "c"; }}));
+  muxer->listen();
+  ASSERT_EQ(called, "c");
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(IOMuxLifecycle, RemovedFdIsNoLongerDispatched) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(muxer->add(fds[0]));
+
+  int calls = 0;
+  muxer->bind_event(fds[0], labeled_handler<std::string>{
+                                "reader"s, [&](SOCKET, std::string) { ++calls; }});
+  ASSERT_TRUE(muxer->remove(fds[0]));
+  ASSERT_FALSE(muxer->remove(fds[0]));
+
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  muxer->post([] {}); // wake listen() without fds[0]
+  muxer->listen();
+  ASSERT_EQ(calls, 0);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(IOMuxLifecycle, HandlerCanRemoveItsOwnFd) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(muxer->add(fds[0]));
+
+  auto *mux = muxer.get();
+  int calls = 0;
+  muxer->bind_event(fds[0], labeled_handler<std::string>{
+                                "once"s, [&calls, mux](SOCKET fd, std::string) {
+                                  ++calls;
+                                  mux->remove(fd);
+                                }});
+
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  muxer->listen();
+  ASSERT_EQ(calls, 1);
+  ASSERT_FALSE(muxer->remove(fds[0]));
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(IOMuxLifecycle, PeerHangupReleasesHandler) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(muxer->add(fds[0]));
+
+  std::string data;
+  SOCKET hung_up = INVALID_SOCKET;
+  muxer->bind_event(fds[0], labeled_handler<std::string>{
+                                "reader"s, [&data](SOCKET fd, std::string) {
+                                  char buf[8];
+                                  auto n = read(fd, buf, sizeof(buf));
+                                  if (n > 0)
+                                    data.append(buf, n);
+                                }});
+  muxer->on_hangup([&hung_up](SOCKET fd) { hung_up = fd; });
+
+  ASSERT_EQ(write(fds[1], "bye", 3), 3);
+  close(fds[1]);
+
+  muxer->listen();
+  ASSERT_EQ(data, "bye");
+  ASSERT_EQ(hung_up, fds[0]);
+  ASSERT_FALSE(muxer->remove(fds[0]));
+
+  close(fds[0]);
+}
+
+TEST(IOMuxScheduling, HighPriorityFdsAreDispatchedFirst) {
+  int bulk[2], control[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, bulk), 0);
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, control), 0);
+  auto muxer{make_muxer<SOCKET>()};
+
+  std::string order;
+  auto reader = [&order](char tag) {
+    return [&order, tag](SOCKET fd, std::string) {
+      char c;
+      if (read(fd, &c, 1) == 1)
+        order += tag;
+    };
+  };
+
+  ASSERT_TRUE(muxer->add(bulk[0]));
+  ASSERT_TRUE(muxer->add(control[0]));
+  muxer->bind_event(bulk[0], labeled_handler<std::string>{"bulk"s, reader('b')});
+  muxer->bind_event(control[0],
+                    labeled_handler<std::string>{"control"s, reader('c')});
+  muxer->set_priority(bulk[0], dispatch_priority::LOW);
+  muxer->set_priority(control[0], dispatch_priority::HIGH);
+
+  ASSERT_EQ(write(bulk[1], "x", 1), 1);
+  ASSERT_EQ(write(control[1], "x", 1), 1);
+  while (order.size() < 2)
+    muxer->listen();
+  ASSERT_EQ(order, "cb");
+
+  for (auto fd : {bulk[0], bulk[1], control[0], control[1]})
+    close(fd);
+}
+
+TEST(IOMuxScheduling, BudgetsRoundRobinFdsWithPendingInput) {
+  int a[2], b[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, a), 0);
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, b), 0);
+  auto muxer{make_muxer<SOCKET>()};
+
+  std::string order;
+  auto one_byte = [&order](SOCKET fd, std::string) {
+    char c;
+    if (read(fd, &c, 1) == 1)
+      order += c;
+  };
+
+  for (auto fd : {a[0], b[0]}) {
+    ASSERT_TRUE(muxer->add(fd));
+    muxer->bind_event(fd, labeled_handler<std::string>{"byte"s, one_byte});
+    muxer->set_budget(fd, dispatch_budget{3, 0});
+  }
+
+  ASSERT_EQ(write(a[1], "aaaaa", 5), 5);
+  ASSERT_EQ(write(b[1], "bbbbb", 5), 5);
+
+  muxer->listen();
+  ASSERT_EQ(order.size(), 6u);
+  ASSERT_EQ(std::count(order.begin(), order.end(), 'a'), 3);
+  // served alternately, not one fd to exhaustion
+  ASSERT_NE(order.substr(0, 3), "aaa");
+  ASSERT_NE(order.substr(0, 3), "bbb");
+
+  while (order.size() < 10)
+    muxer->listen();
+  ASSERT_EQ(std::count(order.begin(), order.end(), 'b'), 5);
+
+  for (auto fd : {a[0], a[1], b[0], b[1]})
+    close(fd);
+}
+
+TEST(IOMuxLifecycle, WritableCallbackRunsUntilUnwatched) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_FALSE(muxer->watch_writable(fds[0], [](SOCKET) {}));
+  ASSERT_TRUE(muxer->add(fds[0]));
+
+  int calls = 0;
+  ASSERT_TRUE(muxer->watch_writable(fds[0], [&](SOCKET fd) {
+    if (++calls == 2)
+      muxer->unwatch_writable(fd);
+  }));
+
+  muxer->listen();
+  muxer->listen();
+  ASSERT_EQ(calls, 2);
+  ASSERT_FALSE(muxer->unwatch_writable(fds[0]));
+
+  muxer->post([] {}); // wake listen() now that nothing is watched
+  muxer->listen();
+  ASSERT_EQ(calls, 2);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(IOMuxLifecycle, PausedInputIsNeitherDispatchedNorHungUp) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_FALSE(muxer->pause_input(fds[0]));
+  ASSERT_TRUE(muxer->add(fds[0]));
+
+  int calls = 0;
+  muxer->bind_event(fds[0], labeled_handler<std::string>{
+                                "in"s, [&](SOCKET fd, std::string) {
+                                  char c;
+                                  if (read(fd, &c, 1) == 1)
+                                    ++calls;
+                                }});
+  bool hung_up = false;
+  muxer->on_hangup([&](SOCKET) { hung_up = true; });
+  ASSERT_TRUE(muxer->pause_input(fds[0]));
+  ASSERT_EQ(write(fds[1], "ab", 2), 2);
+  shutdown(fds[1], SHUT_WR);
+
+  muxer->post([] {});
+  muxer->listen();
+  ASSERT_EQ(calls, 0);
+  ASSERT_FALSE(hung_up);
+
+  // hung up once the input was drained
+  ASSERT_TRUE(muxer->resume_input(fds[0]));
+  while (!hung_up)
+    muxer->listen();
+  ASSERT_EQ(calls, 2);
+  ASSERT_FALSE(muxer->remove(fds[0]));
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(IOMuxLifecycle, PausedFdDoesNotWakeListenOnHangup) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(muxer->add(fds[0]));
+  ASSERT_TRUE(muxer->pause_input(fds[0]));
+  shutdown(fds[1], SHUT_RDWR);
+
+  bool ticked = false;
+  muxer->run_after(std::chrono::milliseconds(10), [&] { ticked = true; });
+  int listens = 0;
+  for (; !ticked; ++listens)
+    muxer->listen();
+  ASSERT_LT(listens, 5);
+
+  // back in the muxer, and hung up, once resumed
+  bool hung_up = false;
+  muxer->on_hangup([&](SOCKET) { hung_up = true; });
+  ASSERT_TRUE(muxer->resume_input(fds[0]));
+  muxer->listen();
+  ASSERT_TRUE(hung_up);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(IOMuxTimers, RunInDeadlineOrderUnlessCancelled) {
+  using namespace std::chrono;
+  auto muxer{make_muxer<SOCKET>()};
+
+  std::vector<int> ran;
+  auto start = steady_clock::now();
+  muxer->run_after(milliseconds(20), [&] { ran.push_back(2); });
+  muxer->run_after(milliseconds(5), [&] { ran.push_back(1); });
+  auto dropped = muxer->run_after(milliseconds(10), [&] { ran.push_back(0); });
+  ASSERT_EQ(muxer->timers(), 3u);
+  ASSERT_TRUE(muxer->cancel_timer(dropped));
+  ASSERT_FALSE(muxer->cancel_timer(dropped));
+
+  while (ran.size() < 2)
+    muxer->listen();
+
+  ASSERT_EQ(ran, (std::vector<int>{1, 2}));
+  ASSERT_GE(steady_clock::now() - start, milliseconds(20));
+  ASSERT_EQ(muxer->timers(), 0u);
+}
+
+TEST(IOMuxTimers, TasksCanScheduleTimers) {
+  auto muxer{make_muxer<SOCKET>()};
+
+  int ticks = 0;
+  std::function<void()> tick = [&] {
+    if (++ticks < 3)
+      muxer->run_after(std::chrono::milliseconds(1), tick);
+  };
+  muxer->run_after(std::chrono::milliseconds(1), tick);
+
+  while (ticks < 3)
+    muxer->listen();
+  ASSERT_EQ(muxer->timers(), 0u);
+}
+
+TEST(BusyPollMuxer, DispatchesLikeEpollAndCountsSpinning) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  auto muxer{make_muxer<SOCKET, busy_poll_muxer<SOCKET>>()};
+  muxer->muxer().configure(busy_poll_config{std::chrono::microseconds{200}});
+  ASSERT_TRUE(muxer->add(fds[0]));
+
+  int calls = 0;
+  muxer->bind_event(fds[0], labeled_handler<std::string>{
+                                "reader"s, [&](SOCKET fd, std::string) {
+                                  char c;
+                                  calls += read(fd, &c, 1);
+                                }});
+
+  // input already queued is found by the first zero-timeout poll
+  ASSERT_EQ(write(fds[1], "x", 1), 1);
+  muxer->listen();
+  ASSERT_EQ(calls, 1);
+
+  const auto &stats = muxer->muxer().stats();
+  ASSERT_EQ(stats.spin_hits.get(), 1u);
+  ASSERT_EQ(stats.blocks.get(), 0u);
+
+  // input arriving after the spin budget is waited for by blocking
+  std::thread writer([&fds] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_EQ(write(fds[1], "y", 1), 1);
+  });
+  muxer->listen();
+  writer.join();
+  ASSERT_EQ(calls, 2);
+  ASSERT_EQ(stats.blocks.get(), 1u);
+  ASSERT_GT(stats.spin_ns.get(), 0u);
+  ASSERT_GT(stats.useful_ns.get(), 0u);
+
+  // a long idle block shrinks the spin budget
+  ASSERT_LT(muxer->muxer().budget(), std::chrono::microseconds{200});
+
+  close(fds[0]);
+  close(fds[1]);
+}
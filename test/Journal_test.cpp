@@ -0,0 +1,332 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Journal.h>
+#include <wasl/Metrics.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+constexpr gsl::czstring<> journal_dir{"/tmp/wasl/journal"};
+
+using mux_type = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+
+void remove_tree(const std::string &path) {
+  if (auto *d = opendir(path.c_str())) {
+    while (auto *entry = readdir(d)) {
+      std::string name = entry->d_name;
+      if (name != "." && name != "..")
+        remove_tree(path + "/" + name);
+    }
+    closedir(d);
+    rmdir(path.c_str());
+  } else {
+    unlink(path.c_str());
+  }
+}
+
+struct journal_test : ::testing::Test {
+  journal_test() { remove_tree(journal_dir); }
+  ~journal_test() override { remove_tree(journal_dir); }
+};
+
+gsl::span<const char> bytes(const std::string &s) {
+  return {s.data(), s.data() + s.size()};
+}
+
+std::string payload_of(gsl::span<const char> rec) {
+  auto *header = reinterpret_cast<const journal_record *>(rec.data());
+  return std::string(rec.data() + sizeof(*header), header->length);
+}
+
+/// Records of a stream received from journal::send().
+struct received {
+  std::vector<uint64_t> offsets;
+  std::vector<std::string> payloads;
+  bool valid{true};
+
+  void parse(const std::string &buf) {
+    std::size_t pos = 0;
+    while (pos + sizeof(journal_record) <= buf.size()) {
+      auto *rec = reinterpret_cast<const journal_record *>(&buf[pos]);
+      valid = valid && journal_verify(*rec);
+      offsets.push_back(rec->offset);
+      payloads.emplace_back(&buf[pos + sizeof(*rec)], rec->length);
+      pos += journal_record_span(rec->length);
+    }
+  }
+};
+
+std::string drain(SOCKET sd) {
+  std::string out;
+  char buf[4096];
+  ssize_t n;
+  while ((n = recv(sd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    out.append(buf, n);
+  return out;
+}
+
+} // namespace
+
+TEST(crc32c, MatchesTheCastagnoliCheckValue) {
+  ASSERT_EQ(crc32c("123456789", 9), 0xe3069283u);
+  ASSERT_EQ(crc32c_portable("123456789", 9), 0xe3069283u);
+  ASSERT_EQ(crc32c("", 0), 0u);
+}
+
+TEST(crc32c, AcceleratedAgreesWithPortableAtAnyAlignment) {
+  std::vector<char> buf(1031);
+  for (std::size_t i = 0; i < buf.size(); ++i)
+    buf[i] = static_cast<char>(i * 131 + 7);
+
+  for (std::size_t off = 0; off < 8; ++off)
+    ASSERT_EQ(crc32c(&buf[off], buf.size() - off),
+              crc32c_portable(&buf[off], buf.size() - off));
+
+  // checksums chain across pieces
+  ASSERT_EQ(crc32c(&buf[100], buf.size() - 100, crc32c(buf.data(), 100)),
+            crc32c(buf.data(), buf.size()));
+}
+
+TEST_F(journal_test, AppendsAndReadsBackRecords) {
+  journal j(journal_dir);
+  ASSERT_TRUE(j);
+  ASSERT_EQ(j.append(bytes("first")), 0);
+  ASSERT_EQ(j.append(bytes("second")), 1);
+  ASSERT_EQ(j.next_offset(), 2u);
+
+  auto rec = j.record(1);
+  ASSERT_EQ(static_cast<std::size_t>(rec.size()), journal_record_span(6));
+  auto *header = reinterpret_cast<const journal_record *>(rec.data());
+  ASSERT_EQ(header->offset, 1u);
+  ASSERT_TRUE(journal_verify(*header));
+  ASSERT_EQ(payload_of(rec), "second");
+  ASSERT_TRUE(j.record(2).empty());
+}
+
+TEST_F(journal_test, RollsSegmentsAndRejectsOversizedRecords) {
+  journal_options options;
+  options.segment_bytes = 4 * journal_record_span(8);
+  journal j(journal_dir, options);
+
+  for (int i = 0; i < 10; ++i)
+    ASSERT_EQ(j.append(bytes("12345678")), i);
+  ASSERT_EQ(j.segments(), 3u);
+  ASSERT_EQ(payload_of(j.record(9)), "12345678");
+
+  std::string big(options.segment_bytes, 'x');
+  ASSERT_EQ(j.append(bytes(big)), -1);
+  ASSERT_EQ(errno, EMSGSIZE);
+}
+
+TEST_F(journal_test, RetainsBySize) {
+  journal_options options;
+  options.segment_bytes = 2 * journal_record_span(8);
+  options.retain_bytes = 4 * journal_record_span(8);
+  journal j(journal_dir, options);
+
+  for (int i = 0; i < 10; ++i)
+    j.append(bytes("12345678"));
+  // checked as segments start, so the newest one may come on top
+  ASSERT_LE(j.size(), options.retain_bytes + options.segment_bytes);
+  ASSERT_EQ(j.first_offset(), 4u);
+  ASSERT_TRUE(j.record(3).empty());
+  ASSERT_EQ(payload_of(j.record(4)), "12345678");
+}
+
+TEST_F(journal_test, RetainsByAge) {
+  journal_options options;
+  options.segment_bytes = 2 * journal_record_span(1);
+  options.retain_ns = 1000000000;
+  journal j(journal_dir, options);
+
+  auto t0 = realtime_ns();
+  for (uint64_t i = 1; i <= 6; ++i)
+    j.append(bytes("x"), t0 + i);
+  ASSERT_EQ(j.segments(), 3u);
+
+  // the newest record of the first segment is at t0 + 2
+  ASSERT_EQ(j.retain(t0 + 2 + options.retain_ns), 0u);
+  ASSERT_EQ(j.retain(t0 + 3 + options.retain_ns), 1u);
+  ASSERT_EQ(j.first_offset(), 2u);
+
+  // the segment appended to stays
+  ASSERT_EQ(j.retain(t0 + 100 * options.retain_ns), 1u);
+  ASSERT_EQ(j.segments(), 1u);
+}
+
+TEST_F(journal_test, RecoversAfterReopening) {
+  {
+    journal_options options;
+    options.segment_bytes = 2 * journal_record_span(3);
+    journal j(journal_dir, options);
+    for (int i = 0; i < 5; ++i)
+      j.append(bytes("abc"));
+  }
+
+  journal j(journal_dir);
+  ASSERT_TRUE(j);
+  ASSERT_EQ(j.first_offset(), 0u);
+  ASSERT_EQ(j.next_offset(), 5u);
+  ASSERT_EQ(payload_of(j.record(4)), "abc");
+  ASSERT_EQ(j.append(bytes("def")), 5);
+  ASSERT_EQ(payload_of(j.record(5)), "def");
+}
+
+TEST_F(journal_test, RecoveryDropsCorruptRecordsAndWhatFollows) {
+  std::string first_segment;
+  {
+    journal j(journal_dir);
+    for (int i = 0; i < 4; ++i)
+      j.append(bytes("payload"));
+    first_segment = j.dir() + "/00000000000000000000.log";
+  }
+
+  // flip a payload byte of the third record
+  int fd = open(first_segment.c_str(), O_RDWR);
+  ASSERT_NE(fd, -1);
+  auto pos = 2 * journal_record_span(7) + sizeof(journal_record);
+  ASSERT_EQ(pwrite(fd, "P", 1, pos), 1);
+  close(fd);
+
+  journal j(journal_dir);
+  ASSERT_EQ(j.next_offset(), 2u);
+  ASSERT_TRUE(j.record(2).empty());
+}
+
+TEST_F(journal_test, SendStreamsRecordsFromAnOffset) {
+  journal_options options;
+  options.segment_bytes = 3 * journal_record_span(5);
+  journal j(journal_dir, options);
+  for (int i = 0; i < 8; ++i)
+    j.append(bytes("msg-" + std::to_string(i)));
+
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+
+  auto cur = j.cursor(2);
+  ASSERT_GT(j.send(fds[0], cur), 0);
+  ASSERT_TRUE(j.caught_up(cur));
+  ASSERT_EQ(j.send(fds[0], cur), 0);
+
+  received r;
+  r.parse(drain(fds[1]));
+  ASSERT_TRUE(r.valid);
+  ASSERT_EQ(r.offsets, (std::vector<uint64_t>{2, 3, 4, 5, 6, 7}));
+  ASSERT_EQ(r.payloads.front(), "msg-2");
+
+  // appends continue from where the cursor is
+  j.append(bytes("msg-8"));
+  ASSERT_FALSE(j.caught_up(cur));
+  ASSERT_EQ(j.send(fds[0], cur),
+            static_cast<ssize_t>(journal_record_span(5)));
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_F(journal_test, SendFailsOnceAPartlySentRecordIsDropped) {
+  journal_options options;
+  options.segment_bytes = 2 * journal_record_span(5);
+  options.retain_bytes = 2 * journal_record_span(5);
+  journal j(journal_dir, options);
+  j.append(bytes("msg-0"));
+  j.append(bytes("msg-1"));
+
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+
+  // one record and a half, then the segment rolls out of retention
+  auto cur = j.cursor(0);
+  auto span = static_cast<ssize_t>(journal_record_span(5));
+  ASSERT_EQ(j.send(fds[0], cur, span), span);
+  ASSERT_FALSE(cur.partial);
+  ASSERT_EQ(j.send(fds[0], cur, 10), 10);
+  ASSERT_TRUE(cur.partial);
+  for (int i = 2; i < 6; ++i)
+    j.append(bytes("msg-" + std::to_string(i)));
+  ASSERT_GT(j.first_offset(), 1u);
+
+  ASSERT_EQ(j.send(fds[0], cur), -1);
+  ASSERT_EQ(errno, ENODATA);
+
+  // a cursor between records jumps instead
+  auto whole = j.cursor(0);
+  ASSERT_EQ(j.send(fds[0], whole, span), span);
+  j.append(bytes("msg-6"));
+  j.append(bytes("msg-7"));
+  ASSERT_GT(j.send(fds[0], whole), 0);
+  ASSERT_TRUE(j.caught_up(whole));
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_F(journal_test, CatchUpDrainsThroughTheReactorThenReportsDone) {
+  journal_options options;
+  options.segment_bytes = 64 * 1024;
+  journal j(journal_dir, options);
+  const std::string msg(1000, 'm');
+  for (int i = 0; i < 400; ++i) // more than the socket buffer holds
+    j.append(bytes(msg));
+
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+  mux_type mux;
+  ASSERT_TRUE(mux.add(fds[0]));
+
+  int done_calls = 0, error = -1;
+  ASSERT_TRUE(j.catch_up(mux, fds[0], 10, [&](SOCKET, int err) {
+    ++done_calls;
+    error = err;
+  }));
+
+  std::string stream;
+  for (int turn = 0; turn < 1000 && !done_calls; ++turn) {
+    mux.listen();
+    stream += drain(fds[1]);
+  }
+  stream += drain(fds[1]);
+
+  ASSERT_EQ(done_calls, 1);
+  ASSERT_EQ(error, 0);
+
+  received r;
+  r.parse(stream);
+  ASSERT_TRUE(r.valid);
+  ASSERT_EQ(r.offsets.size(), 390u);
+  ASSERT_EQ(r.offsets.front(), 10u);
+  ASSERT_EQ(r.offsets.back(), 399u);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_F(journal_test, StoreKeepsAJournalPerTopic) {
+  journal_store store(journal_dir);
+  auto *prices = store.topic("prices");
+  auto *orders = store.topic("orders");
+  ASSERT_NE(prices, nullptr);
+  ASSERT_NE(orders, nullptr);
+  ASSERT_NE(prices, orders);
+  ASSERT_EQ(store.topic("prices"), prices);
+
+  prices->append(bytes("p"));
+  ASSERT_EQ(prices->next_offset(), 1u);
+  ASSERT_EQ(orders->next_offset(), 0u);
+
+  ASSERT_EQ(store.topic("../escape"), nullptr);
+  ASSERT_EQ(errno, EINVAL);
+}
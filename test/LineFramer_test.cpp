@@ -0,0 +1,122 @@
+#include <wasl/LineFramer.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+struct stream_pair {
+  stream_pair() { socketpair(AF_LOCAL, SOCK_STREAM, 0, fds); }
+  ~stream_pair() {
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  void send(const std::string &s) {
+    ASSERT_EQ(write(fds[0], s.data(), s.size()),
+              static_cast<ssize_t>(s.size()));
+  }
+
+  int fds[2];
+};
+
+std::string str(gsl::cstring_span<> s) {
+  return std::string(s.data(), s.size());
+}
+
+} // namespace
+
+TEST(find_delimiter, AgreesWithPortableAtAnyLengthAndAlignment) {
+  std::string buf(300, 'x');
+  for (std::size_t pos : {0, 1, 15, 16, 31, 32, 33, 63, 64, 200, 299}) {
+    buf[pos] = '\n';
+    for (std::size_t off = 0; off < 8 && off <= pos; ++off) {
+      auto *first = buf.data() + off;
+      for (auto *last : {buf.data() + pos, buf.data() + pos + 1,
+                         buf.data() + buf.size()})
+        ASSERT_EQ(find_delimiter(first, last, '\n'),
+                  find_delimiter_portable(first, last, '\n'));
+    }
+    ASSERT_EQ(find_delimiter(buf.data(), buf.data() + buf.size(), '\n'),
+              buf.data() + pos);
+    buf[pos] = 'x';
+  }
+  ASSERT_STRNE(find_delimiter_isa(), "");
+}
+
+TEST(line_framer, ReadsLinesWrittenWithEndl) {
+  stream_pair p;
+  sockstream out(p.fds[0]);
+  out << "first line" << std::endl << std::endl << "third" << std::endl;
+
+  line_framer<> in(p.fds[1]);
+  gsl::cstring_span<> line;
+  ASSERT_TRUE(in.read(line));
+  ASSERT_EQ(str(line), "first line");
+  ASSERT_TRUE(in.read(line));
+  ASSERT_EQ(str(line), "");
+  ASSERT_TRUE(in.read(line));
+  ASSERT_EQ(str(line), "third");
+  ASSERT_FALSE(in.next(line));
+}
+
+TEST(line_framer, RecordsSpanReceives) {
+  stream_pair p;
+  line_framer<> in(p.fds[1], ';', 16);
+  gsl::cstring_span<> rec;
+
+  p.send("abc;de");
+  ASSERT_EQ(in.fill(), 6);
+  ASSERT_TRUE(in.next(rec));
+  ASSERT_EQ(str(rec), "abc");
+  ASSERT_FALSE(in.next(rec));
+  ASSERT_EQ(str(in.remainder()), "de");
+
+  // the partial record moves to the front, so it may use the whole buffer
+  p.send("fghijklmnopq;r;");
+  std::vector<std::string> records;
+  while (in.fill(MSG_DONTWAIT) > 0)
+    while (in.next(rec))
+      records.push_back(str(rec));
+  ASSERT_EQ(records, (std::vector<std::string>{"defghijklmnopq", "r"}));
+}
+
+TEST(line_framer, DrainPassesEveryBufferedRecord) {
+  stream_pair p;
+  line_framer<> in(p.fds[1]);
+  p.send("a\nbb\nccc\ndd");
+  ASSERT_GT(in.fill(), 0);
+
+  std::vector<std::string> records;
+  ASSERT_EQ(in.drain([&](gsl::cstring_span<> r) { records.push_back(str(r)); }),
+            3u);
+  ASSERT_EQ(records, (std::vector<std::string>{"a", "bb", "ccc"}));
+  ASSERT_EQ(str(in.remainder()), "dd");
+}
+
+TEST(line_framer, ReportsRecordsLongerThanTheBuffer) {
+  stream_pair p;
+  line_framer<> in(p.fds[1], '\n', 8);
+  p.send("0123456789\n");
+  gsl::cstring_span<> rec;
+  ASSERT_FALSE(in.read(rec));
+  ASSERT_EQ(errno, EMSGSIZE);
+}
+
+TEST(line_framer, LeavesATrailingPartialRecordAtTheEnd) {
+  stream_pair p;
+  line_framer<> in(p.fds[1]);
+  p.send("done\npartial");
+  shutdown(p.fds[0], SHUT_WR);
+
+  gsl::cstring_span<> rec;
+  ASSERT_TRUE(in.read(rec));
+  ASSERT_EQ(str(rec), "done");
+  ASSERT_FALSE(in.read(rec));
+  ASSERT_EQ(errno, 0);
+  ASSERT_EQ(str(in.remainder()), "partial");
+}
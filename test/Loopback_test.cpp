@@ -0,0 +1,263 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Loopback.h>
+#include <wasl/Rpc.h>
+#include <wasl/SockStream.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+using mux_type = io_mux_base<SOCKET, loopback_muxer<SOCKET>>;
+
+/// A loopback pair closed at the end of the scope.
+struct pair {
+  explicit pair(int type, std::size_t capacity = loopback_default_capacity) {
+    ok = loopback_pair(type, sd, capacity) == 0;
+  }
+  ~pair() {
+    loopback_close(sd[0]);
+    loopback_close(sd[1]);
+  }
+
+  bool ok;
+  SOCKET sd[2];
+};
+
+ssize_t send_str(SOCKET sd, const std::string &s, int flags = 0) {
+  return loopback_sockio::rv_send(sd, const_cast<char *>(s.data()),
+                                  s.size(), flags);
+}
+
+std::string recv_str(SOCKET sd, std::size_t len, int flags = 0) {
+  std::string buf(len, '\0');
+  auto n = loopback_recv(sd, &buf[0], len, flags);
+  return n < 0 ? "error" : buf.substr(0, std::min<std::size_t>(n, len));
+}
+
+} // namespace
+
+TEST(loopback, StreamPairsCarryBytesBothWays) {
+  pair p{SOCK_STREAM};
+  ASSERT_TRUE(p.ok);
+  ASSERT_NE(p.sd[0], p.sd[1]);
+
+  ASSERT_EQ(send_str(p.sd[0], "hello "), 6);
+  ASSERT_EQ(send_str(p.sd[0], "world"), 5);
+  ASSERT_EQ(loopback_pending(p.sd[1]), 11);
+  ASSERT_EQ(recv_str(p.sd[1], 3, MSG_PEEK), "hel");
+  ASSERT_EQ(recv_str(p.sd[1], 64), "hello world");
+
+  struct iovec iov[2] = {{const_cast<char *>("ab"), 2},
+                         {const_cast<char *>("cd"), 2}};
+  ASSERT_EQ(loopback_sendv(p.sd[1], iov, 2), 4);
+  ASSERT_EQ(recv_str(p.sd[0], 64), "abcd");
+}
+
+TEST(loopback, SeqpacketPairsKeepMessageBoundaries) {
+  pair p{SOCK_SEQPACKET};
+  ASSERT_EQ(send_str(p.sd[0], "ab"), 2);
+  ASSERT_EQ(send_str(p.sd[0], "cde"), 3);
+  ASSERT_EQ(send_str(p.sd[0], ""), 0);
+  ASSERT_EQ(send_str(p.sd[0], "fgh"), 3);
+
+  ASSERT_EQ(loopback_sockio::rv_next_size(p.sd[1]), 2);
+  ASSERT_EQ(recv_str(p.sd[1], 64), "ab");
+  // a short buffer truncates the message, MSG_TRUNC tells its length
+  char c;
+  ASSERT_EQ(loopback_recv(p.sd[1], &c, 1, MSG_TRUNC), 3);
+  ASSERT_EQ(c, 'c');
+  ASSERT_EQ(recv_str(p.sd[1], 64), "");
+  ASSERT_EQ(recv_str(p.sd[1], 64), "fgh");
+}
+
+TEST(loopback, StampsMessagesOnRequest) {
+  pair p{SOCK_SEQPACKET};
+  ASSERT_EQ(loopback_set_timestamps(p.sd[1], true), 0);
+  auto before = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                    .count();
+  send_str(p.sd[0], "x");
+  send_str(p.sd[1], "y");
+
+  char buf[8];
+  uint64_t arrival = 0;
+  ASSERT_EQ(loopback_recv_stamped(p.sd[1], buf, sizeof(buf), arrival), 1);
+  ASSERT_GE(arrival, static_cast<uint64_t>(before));
+  ASSERT_EQ(loopback_recv_stamped(p.sd[0], buf, sizeof(buf), arrival), 1);
+  ASSERT_EQ(arrival, 0u);
+
+  pair s{SOCK_STREAM};
+  ASSERT_EQ(loopback_set_timestamps(s.sd[0], true), -1);
+  ASSERT_EQ(errno, EOPNOTSUPP);
+}
+
+TEST(loopback, NonBlockingEndpointsFailWhenEmptyOrFull) {
+  pair p{SOCK_STREAM | SOCK_NONBLOCK, 64};
+  ASSERT_EQ(recv_str(p.sd[1], 8), "error");
+  ASSERT_EQ(errno, EAGAIN);
+
+  // a stream takes what fits
+  std::string big(100, 'b');
+  ASSERT_EQ(send_str(p.sd[0], big), 64);
+  ASSERT_EQ(send_str(p.sd[0], big), -1);
+  ASSERT_EQ(errno, EAGAIN);
+  ASSERT_EQ(recv_str(p.sd[1], 128), std::string(64, 'b'));
+
+  // a message goes whole or not at all
+  pair m{SOCK_SEQPACKET, 64};
+  ASSERT_EQ(send_str(m.sd[0], big, MSG_DONTWAIT), -1);
+  ASSERT_EQ(errno, EMSGSIZE);
+  ASSERT_EQ(send_str(m.sd[0], std::string(40, 'm'), MSG_DONTWAIT), 40);
+  ASSERT_EQ(send_str(m.sd[0], std::string(40, 'm'), MSG_DONTWAIT), -1);
+  ASSERT_EQ(errno, EAGAIN);
+}
+
+TEST(loopback, ClosingEndsThePeersInput) {
+  SOCKET sd[2];
+  ASSERT_EQ(loopback_pair(SOCK_STREAM, sd), 0);
+  send_str(sd[0], "last words");
+  ASSERT_EQ(loopback_close(sd[0]), 0);
+  ASSERT_EQ(loopback_close(sd[0]), -1);
+  ASSERT_EQ(errno, EBADF);
+
+  // queued input is still read, then the end of it
+  ASSERT_EQ(recv_str(sd[1], 64), "last words");
+  char c;
+  ASSERT_EQ(loopback_recv(sd[1], &c, 1), 0);
+  ASSERT_EQ(send_str(sd[1], "anyone?"), -1);
+  ASSERT_EQ(errno, EPIPE);
+  loopback_close(sd[1]);
+
+  // descriptors are reused lowest first
+  SOCKET again[2];
+  ASSERT_EQ(loopback_pair(SOCK_STREAM, again), 0);
+  ASSERT_EQ(std::min(again[0], again[1]), std::min(sd[0], sd[1]));
+  loopback_close(again[0]);
+  loopback_close(again[1]);
+}
+
+TEST(loopback, BlockingCallsWaitForThePeerThread) {
+  pair p{SOCK_STREAM, 4096};
+  constexpr std::size_t total = 1 << 20;
+
+  std::thread writer([&] {
+    std::vector<char> chunk(1000);
+    std::size_t sent = 0;
+    while (sent < total) {
+      for (std::size_t i = 0; i < chunk.size(); ++i)
+        chunk[i] = static_cast<char>((sent + i) & 0x7f);
+      auto n = loopback_sockio::rv_send(
+          p.sd[0], chunk.data(),
+          static_cast<socklen_t>(std::min(chunk.size(), total - sent)));
+      ASSERT_GT(n, 0);
+      sent += n;
+    }
+    loopback_shutdown(p.sd[0], SHUT_WR);
+  });
+
+  char buf[1500];
+  std::size_t received = 0;
+  bool in_order = true;
+  ssize_t n;
+  while ((n = loopback_recv(p.sd[1], buf, sizeof(buf))) > 0) {
+    for (ssize_t i = 0; i < n; ++i)
+      in_order = in_order && buf[i] == static_cast<char>((received + i) & 0x7f);
+    received += n;
+  }
+  writer.join();
+  ASSERT_EQ(n, 0);
+  ASSERT_EQ(received, total);
+  ASSERT_TRUE(in_order);
+}
+
+TEST(loopback, ReactorServesLoopbackDescriptors) {
+  mux_type mux;
+  pair p{SOCK_SEQPACKET | SOCK_NONBLOCK};
+  std::vector<std::string> received;
+  ASSERT_TRUE(mux.add(p.sd[1]));
+  mux.bind_event(p.sd[1], labeled_handler<std::string>{
+                              "in", [&](SOCKET sd, std::string) {
+                                received.push_back(recv_str(sd, 64));
+                              }});
+
+  send_str(p.sd[0], "one");
+  send_str(p.sd[0], "two");
+  while (received.size() < 2)
+    mux.listen();
+  ASSERT_EQ(received, (std::vector<std::string>{"one", "two"}));
+
+  // writable while there is room
+  int writable = 0;
+  ASSERT_TRUE(mux.watch_writable(p.sd[1], [&](SOCKET sd) {
+    ++writable;
+    mux.unwatch_writable(sd);
+  }));
+  mux.listen();
+  ASSERT_EQ(writable, 1);
+
+  // timers, and tasks posted from other threads
+  bool fired = false;
+  mux.run_after(std::chrono::milliseconds(5), [&] { fired = true; });
+  while (!fired)
+    mux.listen();
+  bool posted = false;
+  std::thread([&] { mux.post([&] { posted = true; }); }).join();
+  while (!posted)
+    mux.listen();
+
+  // the peer closing hangs up
+  SOCKET hung_up = INVALID_SOCKET;
+  mux.on_hangup([&](SOCKET sd) { hung_up = sd; });
+  loopback_shutdown(p.sd[0], SHUT_WR);
+  while (hung_up == INVALID_SOCKET)
+    mux.listen();
+  ASSERT_EQ(hung_up, p.sd[1]);
+}
+
+TEST(loopback, RpcRunsOverLoopbackPairs) {
+  using client_type = rpc_client<mux_type, loopback_sockio>;
+  using server_type = rpc_server<mux_type, loopback_sockio>;
+
+  mux_type mux;
+  pair p{SOCK_STREAM | SOCK_NONBLOCK};
+  server_type server{mux};
+  server.handle(1, [](const message_view &req, server_type::responder r) {
+    r.reply({req.payload(), req.payload() + req.payload_size()});
+  });
+  ASSERT_TRUE(server.serve(p.sd[1]));
+  client_type client{mux, p.sd[0]};
+
+  int done = 0;
+  for (int i = 0; i < 50; ++i) {
+    auto body = std::to_string(i);
+    client.call(1, {body.data(), body.data() + body.size()},
+                std::chrono::seconds(5),
+                [&, i](rpc_status s, const message_view &m) {
+                  ASSERT_EQ(s, rpc_status::OK);
+                  ASSERT_EQ(std::string(m.payload(), m.payload_size()),
+                            std::to_string(i));
+                  ++done;
+                });
+  }
+  for (int turns = 0; done < 50 && turns < 1000; ++turns)
+    mux.listen();
+  ASSERT_EQ(done, 50);
+}
+
+TEST(loopback, SockstreamsRunOverLoopbackPairs) {
+  pair p{SOCK_STREAM};
+  basic_sockstream<sockbuf<loopback_sockio>> out{p.sd[0]}, in{p.sd[1]};
+  out << "line " << 42 << std::endl;
+  std::string word;
+  int n = 0;
+  in >> word >> n;
+  ASSERT_EQ(word, "line");
+  ASSERT_EQ(n, 42);
+}
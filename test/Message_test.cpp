@@ -0,0 +1,119 @@
+#include <wasl/Message.h>
+#include <wasl/SockStream.h>
+#include <wasl/Socket.h>
+
+#include <sstream>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+struct quote_v1 {
+  uint64_t id;
+  double bid;
+};
+
+struct quote_v2 {
+  uint64_t id;
+  double bid;
+  double ask; // appended in version 2
+};
+
+struct heartbeat {
+  uint32_t seq;
+};
+
+WASL_MESSAGE_SCHEMA(quote_v1, 1, 1)
+WASL_MESSAGE_SCHEMA(quote_v2, 1, 2)
+WASL_MESSAGE_SCHEMA(heartbeat, 2, 1)
+
+constexpr gsl::czstring<> srv_path{"/tmp/wasl/message_srv"};
+constexpr gsl::czstring<> client_path{"/tmp/wasl/message_cl"};
+
+TEST(message_view, ReadsPayloadInPlace) {
+  alignas(8) char buf[encoded_size<quote_v2>()];
+  quote_v2 q{7, 1.5, 1.75};
+  ASSERT_EQ(encode(q, buf), sizeof(buf));
+
+  message_view view(buf, sizeof(buf));
+  ASSERT_TRUE(view.valid());
+  ASSERT_TRUE(view.is<quote_v2>());
+  ASSERT_FALSE(view.is<heartbeat>());
+
+  const auto *in_place = view.get<quote_v2>();
+  ASSERT_EQ(static_cast<const void *>(in_place), buf + sizeof(message_header));
+  ASSERT_EQ(in_place->id, 7u);
+  ASSERT_EQ(in_place->ask, 1.75);
+}
+
+TEST(message_view, SendTimeTravelsInTheHeaderExtension) {
+  alignas(8) char buf[stamped_size<quote_v2>()];
+  ASSERT_EQ(encode(quote_v2{7, 1.5, 1.75}, buf, 123456789), sizeof(buf));
+
+  message_view view(buf, sizeof(buf));
+  ASSERT_TRUE(view.valid());
+  ASSERT_EQ(view.send_time(), 123456789u);
+  ASSERT_NE(view.get<quote_v2>(), nullptr);
+  ASSERT_EQ(view.get<quote_v2>()->ask, 1.75);
+
+  alignas(8) char plain[encoded_size<quote_v2>()];
+  encode(quote_v2{7, 1.5, 1.75}, plain);
+  ASSERT_EQ(message_view(plain, sizeof(plain)).send_time(), 0u);
+}
+
+TEST(message_view, OlderPayloadIsZeroFilledAndNewerIsTruncated) {
+  alignas(8) char old_buf[encoded_size<quote_v1>()];
+  encode(quote_v1{3, 2.5}, old_buf);
+  message_view old_msg(old_buf, sizeof(old_buf));
+
+  ASSERT_EQ(old_msg.get<quote_v2>(), nullptr);
+  quote_v2 upgraded{9, 9, 9};
+  ASSERT_TRUE(old_msg.read(upgraded));
+  ASSERT_EQ(upgraded.id, 3u);
+  ASSERT_EQ(upgraded.bid, 2.5);
+  ASSERT_EQ(upgraded.ask, 0.0);
+
+  alignas(8) char new_buf[encoded_size<quote_v2>()];
+  encode(quote_v2{4, 1, 2}, new_buf);
+  quote_v1 downgraded;
+  ASSERT_TRUE(message_view(new_buf, sizeof(new_buf)).read(downgraded));
+  ASSERT_EQ(downgraded.id, 4u);
+}
+
+TEST(wire, StreamInsertionAndExtractionRoundTrip) {
+  std::stringstream ss;
+  quote_v2 out{11, 1.25, 1.5};
+  heartbeat hb{5};
+  ss << wire(out) << wire(hb);
+
+  quote_v2 in;
+  heartbeat hb_in;
+  ss >> wire(in) >> wire(hb_in);
+  ASSERT_TRUE(ss);
+  ASSERT_EQ(in.id, 11u);
+  ASSERT_EQ(in.ask, 1.5);
+  ASSERT_EQ(hb_in.seq, 5u);
+
+  ss << wire(hb);
+  ss >> wire(in);
+  ASSERT_TRUE(ss.fail());
+}
+
+TEST(wire, BinaryMessagesCrossASockstream) {
+  auto srv{make_socket<sockaddr_un, SOCK_DGRAM>(srv_path)};
+  auto cl{make_socket<sockaddr_un, SOCK_DGRAM>(client_path)};
+  ASSERT_EQ(socket_connect(cl.get(), sockno(*srv)), 0);
+
+  sockstream ss_cl(sockno(*cl));
+  sockstream ss_srv(sockno(*srv));
+
+  quote_v2 out{42, 99.5, 100.25};
+  ss_cl << wire(out) << std::flush;
+
+  quote_v2 in;
+  ss_srv >> wire(in);
+  ASSERT_TRUE(ss_srv);
+  ASSERT_EQ(in.id, 42u);
+  ASSERT_EQ(in.ask, 100.25);
+}
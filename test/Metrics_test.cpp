@@ -0,0 +1,153 @@
+#include <wasl/Datagram.h>
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Metrics.h>
+#include <wasl/SockStream.h>
+#include <wasl/Socket.h>
+
+#include <string>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace std::string_literals;
+using namespace wasl::ip;
+
+constexpr gsl::czstring<> srv_path{"/tmp/wasl/metrics_srv"};
+constexpr gsl::czstring<> client_path{"/tmp/wasl/metrics_cl"};
+constexpr gsl::czstring<> stats_path{"/tmp/wasl/metrics.stats"};
+
+using metered_sockstream =
+    basic_sockstream<sockbuf<metered_sockio<basic_sockio<wasl::platform_type>>>>;
+using metered_dgram_sockstream = basic_dgram_sockstream<
+    dgram_sockbuf<metered_sockio<basic_sockio<wasl::platform_type>>>>;
+
+TEST(log2_histogram, BucketsByPowerOfTwo) {
+  using hist = log2_histogram<8>;
+  ASSERT_EQ(hist::bucket_of(0), 0u);
+  ASSERT_EQ(hist::bucket_of(1), 1u);
+  ASSERT_EQ(hist::bucket_of(3), 2u);
+  ASSERT_EQ(hist::bucket_of(4), 3u);
+  ASSERT_EQ(hist::bucket_of(1u << 20), 7u);
+}
+
+TEST(reactor_stats, CountsEventsAndBytesPerFd) {
+  auto srv{make_socket<sockaddr_un, SOCK_DGRAM>(srv_path)};
+  auto cl{make_socket<sockaddr_un, SOCK_DGRAM>(client_path)};
+  auto srv_fd = sockno(*srv);
+  ASSERT_EQ(socket_connect(cl.get(), srv_fd), 0);
+
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(muxer->add(srv_fd));
+
+  std::string received;
+  metered_sockstream ss_srv(srv_fd);
+  muxer->bind_event(srv_fd, labeled_handler<std::string>{
+                                "reader"s, [&](SOCKET, std::string) {
+                                  ss_srv >> received;
+                                }});
+
+  sockstream ss_cl(sockno(*cl));
+  ss_cl << "hello" << std::endl;
+
+  ASSERT_EQ(muxer->listen(), 1);
+  ASSERT_EQ(received, "hello");
+
+  auto snap = muxer->metrics();
+  ASSERT_EQ(snap.wakeups, 1u);
+  ASSERT_EQ(snap.dispatched, 1u);
+  ASSERT_EQ(snap.bytes_in, 6u);
+  ASSERT_EQ(snap.batch_sizes[1], 1u);
+  ASSERT_EQ(snap.fds.size(), 1u);
+  ASSERT_EQ(snap.fds[0].fd, srv_fd);
+  ASSERT_EQ(snap.fds[0].events, 1u);
+}
+
+TEST(reactor_stats, CountsDatagramsOfADatagramStreamOnce) {
+  auto srv{make_socket<sockaddr_un, SOCK_DGRAM>(srv_path)};
+  auto cl{make_socket<sockaddr_un, SOCK_DGRAM>(client_path)};
+  auto srv_fd = sockno(*srv);
+  ASSERT_EQ(socket_connect(cl.get(), srv_fd), 0);
+
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(muxer->add(srv_fd));
+
+  std::string received;
+  metered_dgram_sockstream ss_srv(srv_fd);
+  muxer->bind_event(srv_fd, labeled_handler<std::string>{
+                                "reader"s, [&](SOCKET, std::string) {
+                                  ss_srv.next() >> received;
+                                }});
+
+  ASSERT_EQ(send(sockno(*cl), "hello", 5, 0), 5);
+  ASSERT_EQ(muxer->listen(), 1);
+  ASSERT_EQ(received, "hello");
+  ASSERT_EQ(muxer->metrics().bytes_in, 5u);
+}
+
+TEST(reactor_stats, AreOnlyCurrentWhileListening) {
+  auto muxer{make_muxer<SOCKET>()};
+  reactor_stats *during = nullptr;
+  muxer->post([&] { during = this_thread_stats(); });
+  muxer->listen();
+  ASSERT_EQ(during, &muxer->stats());
+  ASSERT_EQ(this_thread_stats(), nullptr);
+}
+
+TEST(stats_segment, ExportedStatsAreReadableByAttach) {
+  auto srv{make_socket<sockaddr_un, SOCK_DGRAM>(srv_path)};
+  auto cl{make_socket<sockaddr_un, SOCK_DGRAM>(client_path)};
+  auto srv_fd = sockno(*srv);
+  ASSERT_EQ(socket_connect(cl.get(), srv_fd), 0);
+
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(muxer->add(srv_fd));
+  ASSERT_TRUE(muxer->export_stats(stats_path));
+
+  auto reader = stats_segment::attach(stats_path);
+  ASSERT_TRUE(reader);
+  ASSERT_EQ(reader.stats().wakeups.get(), 0u);
+
+  sockstream ss_cl(sockno(*cl));
+  ss_cl << "ping" << std::endl;
+  muxer->listen();
+
+  ASSERT_EQ(reader.stats().wakeups.get(), 1u);
+  ASSERT_EQ(reader.stats().fds[srv_fd].events.get(), 1u);
+}
+
+TEST(reactor_stats, RecordsLatencyOfTimestampedDatagrams) {
+  auto builder = socket_dgram_local::create(srv_path);
+  builder->socket()->bind()->timestamps();
+  ASSERT_TRUE(*builder);
+  std::unique_ptr<socket_dgram_local> srv{builder->build()};
+  auto cl{make_socket<sockaddr_un, SOCK_DGRAM>(client_path)};
+  ASSERT_EQ(socket_connect(cl.get(), sockno(*srv)), 0);
+
+  auto sent = realtime_ns();
+  ASSERT_EQ(send(sockno(*cl), "x", 1, 0), 1);
+
+  auto muxer{make_muxer<SOCKET>()};
+  muxer->add(sockno(*srv));
+  uint64_t arrival = 0;
+  muxer->bind_event(sockno(*srv),
+                    labeled_handler<std::string>{
+                        "stamped"s, [&](SOCKET fd, std::string) {
+                          char c;
+                          basic_sockio<wasl::platform_type>::rv_recv_stamped(
+                              fd, &c, 1, arrival);
+                          record_latency(arrival, sent);
+                        }});
+  muxer->listen();
+
+  ASSERT_GE(arrival, sent);
+  ASSERT_LE(arrival, realtime_ns());
+  auto snap = muxer->metrics();
+  auto total = [](const std::vector<uint64_t> &h) {
+    uint64_t n = 0;
+    for (auto c : h)
+      n += c;
+    return n;
+  };
+  ASSERT_EQ(total(snap.wire_to_handler_ns), 1u);
+  ASSERT_EQ(total(snap.end_to_end_ns), 1u);
+}
@@ -0,0 +1,121 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Multicast.h>
+
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+constexpr in_port_t test_port = 45931;
+constexpr const char *loopback = "127.0.0.1";
+
+topic_map test_topics() { return topic_map{"239.255.42.0", 4, test_port}; }
+
+/// Send a hand-made message, bypassing the publisher's sequence numbers.
+void send_raw(const mcast_publisher &pub, const std::string &group,
+              const char *topic, uint64_t seq) {
+  mcast_header header;
+  header.topic = topic_id(topic);
+  header.seq = seq;
+  struct sockaddr_in to {};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(test_port);
+  inet_pton(AF_INET, group.c_str(), &to.sin_addr);
+  sendto(sockno(pub), &header, sizeof(header), 0,
+         reinterpret_cast<struct sockaddr *>(&to), sizeof(to));
+}
+
+/// Publish over loopback, skipping the test if this host cannot route it.
+#define PUBLISH_OR_SKIP(pub, topic, payload)                                   \
+  if ((pub).publish(topic, payload) == -1)                                     \
+  GTEST_SKIP() << "multicast over loopback unavailable: " << strerror(errno)
+
+} // namespace
+
+TEST(topic_map, HashesTopicsIntoTheBlockUnlessAssigned) {
+  auto topics = test_topics();
+  for (auto *topic : {"quotes", "trades", "news", "orders"}) {
+    auto group = topics.group_for(topic);
+    ASSERT_EQ(group.rfind("239.255.42.", 0), 0u) << group;
+    ASSERT_LT(std::stoi(group.substr(11)), 4);
+    ASSERT_EQ(topics.group_for(topic), group);
+  }
+
+  topics.assign("quotes", "239.1.1.1");
+  ASSERT_EQ(topics.group_for("quotes"), "239.1.1.1");
+}
+
+TEST(mcast, DeliversSubscribedTopicsThroughTheReactor) {
+  mcast_publisher pub{test_topics(), 1, loopback};
+  mcast_subscriber sub{test_topics(), loopback};
+  ASSERT_TRUE(pub);
+  ASSERT_TRUE(sub);
+  ASSERT_TRUE(sub.subscribe("quotes"));
+
+  std::vector<std::string> got;
+  sub.on_message([&](uint32_t topic, uint64_t, gsl::span<const char> p) {
+    ASSERT_EQ(topic, topic_id("quotes"));
+    got.emplace_back(p.data(), p.size());
+  });
+
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(sub.attach(*muxer));
+
+  std::string a = "a", b = "b", other = "x";
+  PUBLISH_OR_SKIP(pub, "quotes", a);
+  pub.publish("unrelated", other);
+  pub.publish("quotes", b);
+  ASSERT_EQ(pub.sequence("quotes"), 2u);
+
+  while (got.size() < 2)
+    muxer->listen();
+  ASSERT_EQ(got, (std::vector<std::string>{"a", "b"}));
+  ASSERT_EQ(sub.stats().gaps, 0u);
+}
+
+TEST(mcast, DetectsGapsAndDuplicates) {
+  mcast_publisher pub{test_topics(), 1, loopback};
+  mcast_subscriber sub{test_topics(), loopback};
+  ASSERT_TRUE(sub.subscribe("trades"));
+  auto group = test_topics().group_for("trades");
+
+  uint64_t first_missing = 0, missing = 0;
+  sub.on_gap([&](uint32_t, uint64_t first, uint64_t count) {
+    first_missing = first;
+    missing = count;
+  });
+
+  std::string payload = "t";
+  PUBLISH_OR_SKIP(pub, "trades", payload);
+  for (uint64_t seq : {2, 5, 3, 6})
+    send_raw(pub, group, "trades", seq);
+
+  std::size_t delivered = 0;
+  while (delivered < 4)
+    delivered += sub.drain();
+
+  ASSERT_EQ(first_missing, 3u);
+  ASSERT_EQ(missing, 2u);
+  ASSERT_EQ(sub.stats().gaps, 1u);
+  ASSERT_EQ(sub.stats().lost, 2u);
+  ASSERT_EQ(sub.stats().duplicates, 1u);
+  ASSERT_EQ(sub.stats().received, 4u);
+}
+
+TEST(mcast, StopsReceivingAfterUnsubscribe) {
+  mcast_publisher pub{test_topics(), 1, loopback};
+  mcast_subscriber sub{test_topics(), loopback};
+  ASSERT_TRUE(sub.subscribe("news"));
+  ASSERT_TRUE(sub.unsubscribe("news"));
+  ASSERT_FALSE(sub.unsubscribe("news"));
+
+  std::string payload = "n";
+  PUBLISH_OR_SKIP(pub, "news", payload);
+  usleep(10000);
+  ASSERT_EQ(sub.drain(), 0u);
+}
@@ -0,0 +1,88 @@
+#include <wasl/Datagram.h>
+#include <wasl/Peer.h>
+#include <wasl/Socket.h>
+
+#include <string>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+peer_address local_peer(const char *path) {
+  peer_address peer;
+  auto *un = reinterpret_cast<struct sockaddr_un *>(&peer.addr);
+  un->sun_family = AF_LOCAL;
+  strncpy(un->sun_path, path, sizeof(un->sun_path) - 1);
+  peer.len = offsetof(struct sockaddr_un, sun_path) + strlen(path) + 1;
+  return peer;
+}
+
+} // namespace
+
+TEST(peer_table, InternsEachAddressOnce) {
+  peer_table peers;
+  auto a = peers.intern(local_peer("/tmp/wasl/a"));
+  auto b = peers.intern(local_peer("/tmp/wasl/b"));
+
+  ASSERT_NE(a, b);
+  ASSERT_EQ(peers.intern(local_peer("/tmp/wasl/a")), a);
+  ASSERT_EQ(peers.size(), 2u);
+  ASSERT_EQ(*peers.find(b), local_peer("/tmp/wasl/b"));
+}
+
+TEST(peer_table, ReusesIdsOfForgottenPeers) {
+  peer_table peers;
+  auto a = peers.intern(local_peer("/tmp/wasl/a"));
+  peers.intern(local_peer("/tmp/wasl/b"));
+
+  ASSERT_TRUE(peers.forget(a));
+  ASSERT_FALSE(peers.forget(a));
+  ASSERT_EQ(peers.find(a), nullptr);
+  ASSERT_EQ(peers.intern(local_peer("/tmp/wasl/c")), a);
+  ASSERT_EQ(peers.size(), 2u);
+}
+
+TEST(dgram_endpoint, RepliesToManyPeersFromOneSocket) {
+  auto srv{make_socket<sockaddr_un, SOCK_DGRAM>("/tmp/wasl/srv")};
+  auto cl1{make_socket<sockaddr_un, SOCK_DGRAM>("/tmp/wasl/cl1")};
+  auto cl2{make_socket<sockaddr_un, SOCK_DGRAM>("/tmp/wasl/cl2")};
+  dgram_endpoint<> endpoint(sockno(*srv));
+
+  auto to_srv = local_peer("/tmp/wasl/srv");
+  ASSERT_EQ(sendto(sockno(*cl1), "one", 3, 0, to_srv.get(), to_srv.len), 3);
+  ASSERT_EQ(sendto(sockno(*cl2), "two", 3, 0, to_srv.get(), to_srv.len), 3);
+
+  char buf[16];
+  peer_id from1, from2;
+  ASSERT_EQ(endpoint.recv(buf, sizeof(buf), from1), 3);
+  ASSERT_EQ(endpoint.recv(buf, sizeof(buf), from2), 3);
+  ASSERT_NE(from1, from2);
+
+  std::string reply = "re:two";
+  ASSERT_EQ(endpoint.send_to(from2, reply), 6);
+  ASSERT_EQ(recv(sockno(*cl2), buf, sizeof(buf), MSG_DONTWAIT), 6);
+  ASSERT_EQ(recv(sockno(*cl1), buf, sizeof(buf), MSG_DONTWAIT), -1);
+}
+
+TEST(dgram_endpoint, RejectsUnknownPeers) {
+  auto srv{make_socket<sockaddr_un, SOCK_DGRAM>("/tmp/wasl/srv")};
+  dgram_endpoint<> endpoint(sockno(*srv));
+  std::string msg = "x";
+  ASSERT_EQ(endpoint.send_to(7, msg), -1);
+  ASSERT_EQ(errno, EINVAL);
+}
+
+TEST(dgram_sockstream, CarriesTheSourceAddress) {
+  auto srv{make_socket<sockaddr_un, SOCK_DGRAM>("/tmp/wasl/srv")};
+  auto cl{make_socket<sockaddr_un, SOCK_DGRAM>("/tmp/wasl/cl1")};
+  dgram_sockstream rx(sockno(*srv));
+
+  auto to_srv = local_peer("/tmp/wasl/srv");
+  sendto(sockno(*cl), "hi", 2, 0, to_srv.get(), to_srv.len);
+
+  ASSERT_TRUE(rx.next());
+  ASSERT_EQ(rx.peer(), local_peer("/tmp/wasl/cl1"));
+}
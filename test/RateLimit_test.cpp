@@ -0,0 +1,190 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/RateLimit.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace std::string_literals;
+using namespace wasl::ip;
+
+namespace {
+
+using mux_type = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+
+constexpr uint64_t ms = 1000000;
+
+/// A socketpair whose end [0] is added to mux with a handler reading chunk
+/// bytes per dispatch.
+struct source {
+  source(mux_type &mux, std::size_t chunk) {
+    socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    mux.add(fds[0]);
+    mux.bind_event(fds[0], labeled_handler<std::string>{
+                               "src"s, [this, chunk](SOCKET fd, std::string) {
+                                 char buf[4096];
+                                 auto n = read(fd, buf, chunk);
+                                 if (n > 0) {
+                                   ++messages;
+                                   bytes += n;
+                                 }
+                               }});
+  }
+  ~source() {
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  void send(std::size_t n) {
+    std::string data(n, 'x');
+    ASSERT_EQ(write(fds[1], data.data(), n), static_cast<ssize_t>(n));
+  }
+
+  int fds[2];
+  std::size_t messages{0};
+  std::size_t bytes{0};
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+} // namespace
+
+TEST(token_bucket, StartsFullAndRefillsAtTheRate) {
+  rate_limit limit;
+  limit.messages_per_sec = 1000;
+  limit.burst_messages = 3;
+  token_bucket bucket(limit, 0);
+
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(bucket.ready(0));
+    bucket.take(1, 100, 0);
+  }
+  ASSERT_FALSE(bucket.ready(0));
+  ASSERT_EQ(bucket.wait_ns(0), 1 * ms);
+  ASSERT_TRUE(bucket.ready(1 * ms));
+
+  // refills no further than the burst
+  bucket.take(1, 0, 1 * ms);
+  ASSERT_TRUE(bucket.ready(100 * ms));
+  for (int i = 0; i < 3; ++i)
+    bucket.take(1, 0, 100 * ms);
+  ASSERT_FALSE(bucket.ready(100 * ms));
+}
+
+TEST(token_bucket, BytesGoIntoDebt) {
+  rate_limit limit;
+  limit.bytes_per_sec = 1000;
+  token_bucket bucket(limit, 0); // burst of a second's worth
+  ASSERT_FALSE(bucket.limits_messages());
+
+  bucket.take(1, 3000, 0);
+  ASSERT_FALSE(bucket.ready(0));
+  // 2000 bytes of debt and one more token take 2.001 s
+  ASSERT_EQ(bucket.wait_ns(0), 2001 * ms);
+  ASSERT_FALSE(bucket.ready(2000 * ms));
+  ASSERT_TRUE(bucket.ready(2001 * ms));
+}
+
+TEST(IOMuxRateLimit, ThrottlesMessagesUntilTokensRefill) {
+  mux_type mux;
+  source src(mux, 1);
+  rate_limit limit;
+  limit.messages_per_sec = 1000;
+  limit.burst_messages = 5;
+  mux.set_rate_limit(src.fds[0], limit);
+  mux.set_budget(src.fds[0], dispatch_budget{100, 0});
+
+  src.send(25);
+  auto start = std::chrono::steady_clock::now();
+  mux.listen();
+  ASSERT_EQ(src.messages, 5u);
+  ASSERT_TRUE(mux.throttled(src.fds[0]));
+
+  while (src.messages < 25)
+    mux.listen();
+  ASSERT_GE(elapsed_ms(start), 19.0);
+
+  // held out of epoll rather than woken and rejected
+  auto snap = mux.metrics();
+  ASSERT_LT(snap.wakeups, 3 * 25u);
+  ASSERT_GT(snap.throttles, 0u);
+  ASSERT_GT(snap.throttled_ns, 0u);
+  ASSERT_EQ(snap.fds.size(), 1u);
+  ASSERT_EQ(snap.fds[0].throttles, snap.throttles);
+  ASSERT_EQ(snap.fds[0].throttled_ns, snap.throttled_ns);
+}
+
+TEST(IOMuxRateLimit, ThrottledFdDoesNotSpinOnHangup) {
+  mux_type mux;
+  source src(mux, 1);
+  rate_limit limit;
+  limit.messages_per_sec = 50;
+  limit.burst_messages = 1;
+  mux.set_rate_limit(src.fds[0], limit);
+  bool hung_up = false;
+  mux.on_hangup([&](SOCKET) { hung_up = true; });
+
+  src.send(2);
+  shutdown(src.fds[1], SHUT_RDWR);
+  mux.listen();
+  ASSERT_EQ(src.messages, 1u);
+  ASSERT_TRUE(mux.throttled(src.fds[0]));
+
+  // the hangup waits for the rest of the input, without waking listen()
+  int listens = 0;
+  while (!hung_up) {
+    mux.listen();
+    ++listens;
+  }
+  ASSERT_EQ(src.messages, 2u);
+  ASSERT_LT(listens, 10);
+}
+
+TEST(IOMuxRateLimit, ThrottlesBytes) {
+  mux_type mux;
+  source src(mux, 500);
+  rate_limit limit;
+  limit.bytes_per_sec = 100000;
+  limit.burst_bytes = 1000;
+  mux.set_rate_limit(src.fds[0], limit);
+
+  src.send(3000);
+  auto start = std::chrono::steady_clock::now();
+  while (src.bytes < 3000)
+    mux.listen();
+  // the last read goes on credit: 1500 bytes over the burst at 100 per ms
+  ASSERT_GE(elapsed_ms(start), 14.0);
+}
+
+TEST(IOMuxRateLimit, PublishersShareABucket) {
+  mux_type mux;
+  source a(mux, 1), b(mux, 1);
+  rate_limit limit;
+  limit.messages_per_sec = 1000;
+  limit.burst_messages = 4;
+  auto bucket = std::make_shared<token_bucket>(limit);
+  mux.set_rate_limit(a.fds[0], bucket);
+  mux.set_rate_limit(b.fds[0], bucket);
+
+  a.send(10);
+  b.send(10);
+  mux.listen();
+  mux.listen();
+  ASSERT_EQ(a.messages + b.messages, 4u);
+  ASSERT_TRUE(mux.throttled(a.fds[0]) || mux.throttled(b.fds[0]));
+
+  // lifting the limit resumes at once
+  mux.set_rate_limit(a.fds[0], nullptr);
+  mux.set_rate_limit(b.fds[0], nullptr);
+  ASSERT_FALSE(mux.throttled(a.fds[0]));
+  ASSERT_FALSE(mux.throttled(b.fds[0]));
+  while (a.messages + b.messages < 20)
+    mux.listen();
+  ASSERT_EQ(mux.timers(), 0u);
+}
@@ -0,0 +1,211 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Relay.h>
+
+#include <chrono>
+#include <csignal>
+#include <string>
+
+#include <fcntl.h>
+
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+using mux_type = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+using relay_type = splice_relay<mux_type>;
+
+/// A socketpair whose relay end [1] is non-blocking and added to mux.
+struct leg {
+  explicit leg(mux_type &mux) {
+    socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    mux.add(fds[1]);
+  }
+  ~leg() {
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  SOCKET peer() const { return fds[0]; }
+  SOCKET relay_end() const { return fds[1]; }
+
+  void send(const std::string &s) {
+    ASSERT_EQ(write(fds[0], s.data(), s.size()),
+              static_cast<ssize_t>(s.size()));
+  }
+
+  std::string drain() {
+    std::string out;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fds[0], buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+      out.append(buf, n);
+    return out;
+  }
+
+  int fds[2];
+};
+
+struct relay_test : ::testing::Test {
+  relay_test() { signal(SIGPIPE, SIG_IGN); }
+
+  mux_type mux;
+};
+
+} // namespace
+
+TEST_F(relay_test, ForwardsAndHalfClosesAtTheEnd) {
+  leg in{mux}, out{mux};
+  relay_type relay{mux, in.relay_end(), out.relay_end()};
+  ASSERT_TRUE(relay);
+
+  int done = 0, error = -1;
+  ASSERT_TRUE(relay.start([&](int err) {
+    ++done;
+    error = err;
+  }));
+
+  in.send("hello ");
+  in.send("world");
+  shutdown(in.peer(), SHUT_WR);
+  while (!done)
+    mux.listen();
+
+  ASSERT_EQ(error, 0);
+  ASSERT_FALSE(relay.running());
+  ASSERT_EQ(out.drain(), "hello world");
+  char c;
+  ASSERT_EQ(recv(out.peer(), &c, 1, MSG_DONTWAIT), 0); // end of stream
+
+  // the other direction stays open
+  out.send("reply");
+  char buf[8];
+  ASSERT_EQ(recv(out.relay_end(), buf, sizeof(buf), 0), 5);
+
+  ASSERT_EQ(relay.stats().bytes_in, 11u);
+  ASSERT_EQ(relay.stats().bytes_out, 11u);
+
+  // the source is out of the muxer, so its hangup wakes nothing
+  shutdown(in.peer(), SHUT_RDWR);
+  bool ticked = false;
+  mux.run_after(std::chrono::milliseconds(10), [&] { ticked = true; });
+  int listens = 0;
+  for (; !ticked; ++listens)
+    mux.listen();
+  ASSERT_LT(listens, 5);
+}
+
+TEST_F(relay_test, PausesTheSourceWhileTheDestinationIsFull) {
+  leg in{mux}, out{mux};
+  relay_type relay{mux, in.relay_end(), out.relay_end(), INVALID_SOCKET,
+                   4096};
+  ASSERT_TRUE(relay.start());
+  fcntl(in.peer(), F_SETFL, O_NONBLOCK);
+
+  // send until the pipe is full and the source paused
+  std::string sent;
+  for (int i = 0; relay.stats().stalls == 0; ++i) {
+    std::string piece(1024, static_cast<char>('a' + i % 26));
+    auto n = write(in.peer(), piece.data(), piece.size());
+    if (n > 0)
+      sent.append(piece, 0, n);
+    mux.post([] {});
+    mux.listen();
+  }
+  ASSERT_GT(relay.stats().stalls, 0u);
+  ASSERT_GT(relay.buffered(), 0u);
+
+  std::string received;
+  while (received.size() < sent.size()) {
+    received += out.drain();
+    mux.post([] {});
+    mux.listen();
+  }
+  ASSERT_TRUE(received == sent);
+}
+
+TEST_F(relay_test, RelaysBothDirectionsOfAConnection) {
+  leg a{mux}, b{mux};
+  relay_type forward{mux, a.relay_end(), b.relay_end()};
+  relay_type backward{mux, b.relay_end(), a.relay_end(), INVALID_SOCKET,
+                      4096};
+  int forward_done = 0, backward_done = 0;
+  ASSERT_TRUE(forward.start([&](int err) {
+    ASSERT_EQ(err, 0);
+    ++forward_done;
+  }));
+  ASSERT_TRUE(backward.start([&](int err) {
+    ASSERT_EQ(err, 0);
+    ++backward_done;
+  }));
+  fcntl(b.peer(), F_SETFL, O_NONBLOCK);
+
+  // back up the reverse direction until it waits for a to take output
+  std::string sent;
+  for (int i = 0; backward.stats().stalls == 0; ++i) {
+    std::string piece(1024, static_cast<char>('a' + i % 26));
+    auto n = write(b.peer(), piece.data(), piece.size());
+    if (n > 0)
+      sent.append(piece, 0, n);
+    mux.post([] {});
+    mux.listen();
+  }
+  shutdown(b.peer(), SHUT_WR);
+
+  // the forward relay ends first, on a socket the reverse one writes to
+  shutdown(a.peer(), SHUT_WR);
+  while (!forward_done) {
+    mux.post([] {});
+    mux.listen();
+  }
+
+  std::string received;
+  for (int round = 0; round < 10000 && !backward_done; ++round) {
+    received += a.drain();
+    mux.post([] {});
+    mux.listen();
+  }
+  received += a.drain();
+  ASSERT_EQ(backward_done, 1);
+  ASSERT_TRUE(received == sent);
+}
+
+TEST_F(relay_test, MirrorsToASecondDestination) {
+  leg in{mux}, out{mux}, copy{mux};
+  relay_type relay{mux, in.relay_end(), out.relay_end(), copy.relay_end()};
+  int done = 0;
+  ASSERT_TRUE(relay.start([&](int err) {
+    ASSERT_EQ(err, 0);
+    ++done;
+  }));
+
+  std::string sent;
+  for (int i = 0; i < 100; ++i) {
+    auto msg = "message " + std::to_string(i) + "\n";
+    in.send(msg);
+    sent += msg;
+    mux.listen();
+  }
+  shutdown(in.peer(), SHUT_WR);
+  while (!done)
+    mux.listen();
+
+  ASSERT_EQ(out.drain(), sent);
+  ASSERT_EQ(copy.drain(), sent);
+  ASSERT_EQ(relay.stats().bytes_mirrored, sent.size());
+}
+
+TEST_F(relay_test, FailsWhenTheDestinationCloses) {
+  leg in{mux}, out{mux};
+  relay_type relay{mux, in.relay_end(), out.relay_end()};
+  int error = 0;
+  ASSERT_TRUE(relay.start([&](int err) { error = err; }));
+
+  shutdown(out.peer(), SHUT_RDWR);
+  in.send("lost");
+  while (!error)
+    mux.listen();
+  ASSERT_EQ(error, EPIPE);
+}
@@ -0,0 +1,215 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/Rpc.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+struct add_request {
+  int32_t a;
+  int32_t b;
+};
+
+struct add_result {
+  int32_t sum;
+};
+
+} // namespace
+
+WASL_MESSAGE_SCHEMA(add_request, 40, 1)
+WASL_MESSAGE_SCHEMA(add_result, 41, 1)
+
+namespace {
+
+using mux_type = io_mux_base<SOCKET, epoll_muxer<SOCKET>>;
+using client_type = rpc_client<mux_type>;
+using server_type = rpc_server<mux_type>;
+
+constexpr uint16_t echo_method = 1;
+constexpr uint16_t deferred_method = 2;
+constexpr uint16_t silent_method = 3;
+
+const auto timeout = std::chrono::seconds(5);
+
+struct rpc_pair {
+  rpc_pair() {
+    socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    client.reset(new client_type{mux, fds[0]});
+    server.serve(fds[1]);
+    server.handle(echo_method, [](const message_view &req,
+                                  server_type::responder r) {
+      r.reply({req.payload(), req.payload() + req.payload_size()});
+    });
+  }
+  ~rpc_pair() {
+    client.reset();
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  /// Run the reactor until pred holds, at most turns times.
+  template <typename Pred> bool run_until(Pred pred, int turns = 100) {
+    while (!pred() && turns-- > 0)
+      mux.listen();
+    return pred();
+  }
+
+  int fds[2];
+  mux_type mux;
+  server_type server{mux};
+  std::unique_ptr<client_type> client;
+};
+
+gsl::span<const char> bytes(const std::string &s) {
+  return {s.data(), s.data() + s.size()};
+}
+
+std::string payload_of(const message_view &msg) {
+  return std::string(msg.payload(), msg.payload_size());
+}
+
+} // namespace
+
+TEST(rpc, PipelinedCallsCompleteWithTheirReplies) {
+  rpc_pair p;
+  std::vector<std::string> replies(20);
+  int done = 0;
+  for (int i = 0; i < 20; ++i) {
+    auto id = p.client->call(echo_method, bytes("call " + std::to_string(i)),
+                             timeout,
+                             [&, i](rpc_status status, const message_view &m) {
+                               ASSERT_EQ(status, rpc_status::OK);
+                               replies[i] = payload_of(m);
+                               ++done;
+                             });
+    ASSERT_NE(id, 0u);
+  }
+  ASSERT_EQ(p.client->outstanding(), 20u);
+
+  ASSERT_TRUE(p.run_until([&] { return done == 20; }));
+  for (int i = 0; i < 20; ++i)
+    ASSERT_EQ(replies[i], "call " + std::to_string(i));
+  ASSERT_EQ(p.client->outstanding(), 0u);
+
+  // all calls of one turn went out in one send
+  ASSERT_EQ(p.client->stats().writes, 1u);
+}
+
+TEST(rpc, RepliesMayCompleteOutOfOrder) {
+  rpc_pair p;
+  std::vector<server_type::responder> held;
+  p.server.handle(deferred_method,
+                  [&](const message_view &, server_type::responder r) {
+                    held.push_back(r);
+                  });
+
+  std::vector<int> order;
+  for (int i = 0; i < 3; ++i)
+    p.client->call(deferred_method, {}, timeout,
+                   [&, i](rpc_status status, const message_view &) {
+                     ASSERT_EQ(status, rpc_status::OK);
+                     order.push_back(i);
+                   });
+
+  ASSERT_TRUE(p.run_until([&] { return held.size() == 3; }));
+  for (auto it = held.rbegin(); it != held.rend(); ++it)
+    ASSERT_TRUE(it->reply(gsl::span<const char>{}));
+  ASSERT_FALSE(held[0].reply(gsl::span<const char>{})); // once only
+
+  ASSERT_TRUE(p.run_until([&] { return order.size() == 3; }));
+  ASSERT_EQ(order, (std::vector<int>{2, 1, 0}));
+}
+
+TEST(rpc, TypedCallsUseTheMessageSchema) {
+  rpc_pair p;
+  p.server.handle<add_request>([](const message_view &req,
+                                  server_type::responder r) {
+    add_request in;
+    ASSERT_TRUE(req.read(in));
+    r.reply(add_result{in.a + in.b});
+  });
+
+  int32_t sum = 0;
+  p.client->call(add_request{2, 40}, timeout,
+                 [&](rpc_status status, const message_view &m) {
+                   ASSERT_EQ(status, rpc_status::OK);
+                   add_result out;
+                   ASSERT_TRUE(m.read(out));
+                   sum = out.sum;
+                 });
+  ASSERT_TRUE(p.run_until([&] { return sum != 0; }));
+  ASSERT_EQ(sum, 42);
+}
+
+TEST(rpc, UnknownMethodsFail) {
+  rpc_pair p;
+  rpc_status status = rpc_status::OK;
+  std::string reason;
+  p.client->call(99, {}, timeout,
+                 [&](rpc_status s, const message_view &m) {
+                   status = s;
+                   reason = payload_of(m);
+                 });
+  ASSERT_TRUE(p.run_until([&] { return !reason.empty(); }));
+  ASSERT_EQ(status, rpc_status::ERROR);
+  ASSERT_EQ(reason, "unknown method");
+}
+
+TEST(rpc, DeadlinesExpireCallsAndDropLateReplies) {
+  using namespace std::chrono;
+  rpc_pair p;
+  std::vector<server_type::responder> held;
+  p.server.handle(silent_method,
+                  [&](const message_view &, server_type::responder r) {
+                    held.push_back(r);
+                  });
+
+  auto start = steady_clock::now();
+  rpc_status status = rpc_status::OK;
+  int calls = 0;
+  p.client->call(silent_method, {}, milliseconds(20),
+                 [&](rpc_status s, const message_view &m) {
+                   ASSERT_FALSE(m.valid());
+                   status = s;
+                   ++calls;
+                 });
+  ASSERT_TRUE(p.run_until([&] { return calls == 1; }));
+  ASSERT_EQ(status, rpc_status::TIMEOUT);
+  ASSERT_GE(steady_clock::now() - start, milliseconds(20));
+
+  ASSERT_EQ(held.size(), 1u);
+  held[0].reply(gsl::span<const char>{});
+  ASSERT_TRUE(p.run_until([&] { return p.client->stats().late == 1; }));
+  ASSERT_EQ(calls, 1);
+  ASSERT_EQ(p.client->stats().timeouts, 1u);
+}
+
+TEST(rpc, OutstandingCallsFailWhenTheConnectionCloses) {
+  rpc_pair p;
+  p.server.handle(silent_method,
+                  [&](const message_view &, server_type::responder) {});
+
+  int disconnected = 0;
+  for (int i = 0; i < 3; ++i)
+    p.client->call(silent_method, {}, timeout,
+                   [&](rpc_status s, const message_view &) {
+                     if (s == rpc_status::DISCONNECTED)
+                       ++disconnected;
+                   });
+  ASSERT_TRUE(p.run_until([&] { return p.server.connections() == 1; }));
+  p.mux.listen();
+
+  shutdown(p.fds[1], SHUT_RDWR);
+  ASSERT_TRUE(p.run_until([&] { return disconnected == 3; }));
+  ASSERT_FALSE(*p.client);
+  ASSERT_EQ(p.client->call(echo_method, {}, timeout,
+                           [](rpc_status, const message_view &) {}),
+            0u);
+  ASSERT_EQ(p.mux.timers(), 0u);
+}
@@ -34,3 +34,68 @@ TEST(sockstream, IsMoveAssignable) {
 	ASSERT_TRUE(ss2);
 	ASSERT_EQ(sockno(ss2), ss1_fd);
 }
+
+TEST(sockstream, CorkedFlushesLeaveAsOneDatagram) {
+	int fds[2];
+	ASSERT_EQ(socketpair(AF_LOCAL, SOCK_DGRAM, 0, fds), 0);
+	sockstream ss(fds[0]);
+
+	ss.cork();
+	ss << "head" << std::flush;
+	ss << "body" << std::flush;
+	ASSERT_TRUE(ss.rdbuf()->corked());
+
+	char buf[64];
+	ASSERT_EQ(recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT), -1);
+
+	ss << "tail";
+	ASSERT_TRUE(ss.uncork());
+	auto n = recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT);
+	ASSERT_EQ(std::string(buf, n), "headbodytail");
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+TEST(sockstream, WriteRefSendsInPlaceAfterBufferedOutput) {
+	int fds[2];
+	ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+	sockstream ss(fds[0]);
+	const std::string payload(1000, 'p');
+
+	{
+		cork_guard<sockstream> guard{ss};
+		ss << "len=1000;";
+		ASSERT_EQ(ss.rdbuf()->write_ref(payload.data(), payload.size()), 0);
+		ss << ";end";
+	}
+
+	std::string got(9 + payload.size() + 4, '\0');
+	std::size_t off = 0;
+	while (off < got.size()) {
+		auto n = recv(fds[1], &got[off], got.size() - off, 0);
+		ASSERT_GT(n, 0);
+		off += n;
+	}
+	ASSERT_EQ(got, "len=1000;" + payload + ";end");
+
+	close(fds[0]);
+	close(fds[1]);
+}
+
+TEST(sockstream, WriteRefUncorkedFollowsBufferedOutput) {
+	int fds[2];
+	ASSERT_EQ(socketpair(AF_LOCAL, SOCK_STREAM, 0, fds), 0);
+	sockstream ss(fds[0]);
+
+	ss << "head;";
+	ASSERT_EQ(ss.rdbuf()->write_ref("body", 4), 0);
+	ASSERT_FALSE(ss.rdbuf()->corked());
+
+	char buf[64];
+	auto n = recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT);
+	ASSERT_EQ(std::string(buf, n > 0 ? n : 0), "head;body");
+
+	close(fds[0]);
+	close(fds[1]);
+}
@@ -4,6 +4,8 @@
 
 #include <type_traits>
 
+#include <fcntl.h>
+
 #include "test_helpers.h"
 #include <gtest/gtest.h>
 
@@ -63,3 +65,71 @@ TEST(datagram_sockets, CanReadAndWrite) {
 		ss_cl << msg << std::endl;
 	});
 }
+
+TEST(socket_builder, ListensAndAcceptsSeqpacketConnections) {
+	auto listener { make_listener<sockaddr_un, SOCK_SEQPACKET>(srv_path, 4) };
+	ASSERT_TRUE(listener);
+	ASSERT_TRUE(is_open(*listener));
+
+	std::unique_ptr<socket_seqpacket_local> client { socket_seqpacket_local
+		::create("")->socket()->connect(sockno(*listener))->build() };
+	ASSERT_TRUE(is_open(*client));
+
+	auto conn { accept_socket<socket_seqpacket_local>(sockno(*listener)) };
+	ASSERT_TRUE(conn);
+
+	// messages keep their boundaries
+	ASSERT_EQ(send(sockno(*client), "ab", 2, 0), 2);
+	ASSERT_EQ(send(sockno(*client), "cde", 3, 0), 3);
+	char buf[8];
+	ASSERT_EQ(recv(sockno(*conn), buf, sizeof(buf), 0), 2);
+	ASSERT_EQ(recv(sockno(*conn), buf, sizeof(buf), 0), 3);
+
+	// closing an accepted connection leaves the listener's path
+	conn.reset();
+	ASSERT_EQ(access(srv_path, F_OK), 0);
+
+	fcntl(sockno(*listener), F_SETFL, O_NONBLOCK);
+	auto none { accept_socket<socket_seqpacket_local>(sockno(*listener)) };
+	ASSERT_FALSE(none);
+	ASSERT_EQ(errno, EAGAIN);
+}
+
+TEST(socket_builder, ConnectsToAListeningAddress) {
+	auto listener { make_listener<sockaddr_in, SOCK_STREAM>("127.0.0.1:0") };
+	ASSERT_TRUE(listener);
+	auto path { address_path(get_address<sockaddr_in>(sockno(*listener))) };
+	ASSERT_EQ(path.rfind("127.0.0.1:", 0), 0u);
+	ASSERT_NE(path, "127.0.0.1:0");
+
+	auto client { make_connection<sockaddr_in, SOCK_STREAM>(path.c_str()) };
+	ASSERT_TRUE(client);
+	auto conn { accept_socket<socket_stream_tcp>(sockno(*listener)) };
+	ASSERT_TRUE(conn);
+	ASSERT_EQ(send(sockno(*client), "ping", 4, MSG_NOSIGNAL), 4);
+	char buf[8];
+	ASSERT_EQ(recv(sockno(*conn), buf, sizeof(buf), 0), 4);
+
+	// the port is taken, unless every listener shares it
+	ASSERT_FALSE((make_listener<sockaddr_in, SOCK_STREAM>(path.c_str())));
+	ASSERT_EQ(errno, EADDRINUSE);
+	ASSERT_FALSE((make_connection<sockaddr_in, SOCK_STREAM>("127.0.0.1:1")));
+	ASSERT_EQ(errno, ECONNREFUSED);
+}
+
+TEST(socket_builder, ReusePortListenersShareOnePort) {
+	auto listeners { make_reuseport_listeners<sockaddr_in>("127.0.0.1:0", 3) };
+	ASSERT_EQ(listeners.size(), 3u);
+	auto port { get_address<sockaddr_in>(sockno(*listeners[0])).sin_port };
+	ASSERT_NE(port, 0);
+	for (auto &l : listeners)
+		ASSERT_EQ(get_address<sockaddr_in>(sockno(*l)).sin_port, port);
+}
+
+TEST(socket_builder, ConnectingLeavesThePeersPath) {
+	auto listener { make_listener<sockaddr_un, SOCK_STREAM>(srv_path) };
+	ASSERT_TRUE(listener);
+	ASSERT_TRUE((make_connection<sockaddr_un, SOCK_STREAM>(srv_path)));
+	ASSERT_EQ(access(srv_path, F_OK), 0);
+	ASSERT_EQ(address_path(c_addr(*listener)), srv_path);
+}
@@ -0,0 +1,224 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/SubscriberQueue.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+using queue_type = bounded_queue<std::string>;
+using result = queue_type::push_result;
+
+std::string drain_front(queue_type &q) {
+  auto v = q.front();
+  q.pop();
+  return v;
+}
+
+/// Stream socketpair whose writer side fills up after a few KiB.
+struct stream_pair {
+  stream_pair() {
+    socketpair(AF_LOCAL, SOCK_STREAM, 0, fds);
+    int small = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+  }
+  ~stream_pair() {
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  std::size_t read_all() {
+    char buf[4096];
+    std::size_t total = 0;
+    ssize_t n;
+    while ((n = recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+      total += n;
+    return total;
+  }
+
+  int fds[2];
+};
+
+} // namespace
+
+TEST(bounded_queue, DropOldestEvictsTheHead) {
+  queue_type q{2, overflow_policy::DROP_OLDEST};
+  q.push("a");
+  q.push("b");
+  ASSERT_EQ(q.push("c"), result::DROPPED_OLDEST);
+  ASSERT_EQ(drain_front(q), "b");
+  ASSERT_EQ(drain_front(q), "c");
+  ASSERT_EQ(q.stats().dropped_oldest.get(), 1u);
+  ASSERT_EQ(q.stats().dequeued.get(), 2u);
+}
+
+TEST(bounded_queue, DropNewestKeepsTheQueue) {
+  queue_type q{2, overflow_policy::DROP_NEWEST};
+  q.push("a");
+  q.push("b");
+  ASSERT_EQ(q.push("c"), result::DROPPED);
+  ASSERT_EQ(drain_front(q), "a");
+  ASSERT_EQ(q.stats().dropped_newest.get(), 1u);
+}
+
+TEST(bounded_queue, BlockRefusesWithoutConsumingTheValue) {
+  queue_type q{1, overflow_policy::BLOCK};
+  q.push("a");
+  std::string b = "b";
+  ASSERT_EQ(q.push(std::move(b), 0), result::FULL);
+  ASSERT_EQ(b, "b");
+  ASSERT_EQ(q.stats().blocked.get(), 1u);
+}
+
+TEST(bounded_queue, ConflateKeepsTheLatestValuePerKeyInPlace) {
+  queue_type q{3, overflow_policy::CONFLATE};
+  q.push("ibm=1", 1);
+  q.push("aapl=1", 2);
+  ASSERT_EQ(q.push("ibm=2", 1), result::CONFLATED);
+  ASSERT_EQ(q.size(), 2u);
+  ASSERT_EQ(drain_front(q), "ibm=2");
+
+  // a popped key starts a new entry
+  ASSERT_EQ(q.push("ibm=3", 1), result::QUEUED);
+  q.push("msft=1", 3);
+  ASSERT_EQ(q.push("goog=1", 4), result::DROPPED_OLDEST);
+  ASSERT_EQ(drain_front(q), "ibm=3");
+  ASSERT_EQ(q.push("goog=2", 4), result::CONFLATED);
+  ASSERT_EQ(drain_front(q), "msft=1");
+  ASSERT_EQ(drain_front(q), "goog=2");
+  ASSERT_EQ(q.stats().conflated.get(), 2u);
+  ASSERT_EQ(q.stats().high_water.get(), 3u);
+}
+
+TEST(bounded_queue, HeldHeadIsNeitherEvictedNorReplaced) {
+  queue_type q{2, overflow_policy::CONFLATE};
+  q.push("ibm=1", 1);
+  q.push("aapl=1", 2);
+  q.hold_front();
+
+  // the entry behind the head goes instead
+  ASSERT_EQ(q.push("msft=1", 3), result::DROPPED_OLDEST);
+  // the head's key queues anew, evicting behind the head again
+  ASSERT_EQ(q.push("ibm=2", 1), result::DROPPED_OLDEST);
+  ASSERT_EQ(q.push("ibm=3", 1), result::CONFLATED);
+  ASSERT_EQ(drain_front(q), "ibm=1");
+  ASSERT_EQ(drain_front(q), "ibm=3");
+
+  queue_type one{1, overflow_policy::DROP_OLDEST};
+  one.push("a");
+  one.hold_front();
+  ASSERT_EQ(one.push("b"), result::DROPPED);
+  ASSERT_EQ(drain_front(one), "a");
+}
+
+TEST(subscriber_queue, PartlySentMessagesKeepTheirFraming) {
+  stream_pair pair;
+  subscriber_queue<> q{pair.fds[0], 2, overflow_policy::CONFLATE};
+  const std::size_t size = 20000; // larger than the socket buffers
+
+  // fill the socket until a message stays queued, partly sent
+  char last = 'a';
+  while (q.pending() == 0) {
+    ++last;
+    q.publish(std::string(size, last), last);
+  }
+  // overflow the queue, and conflate the key of its head
+  for (int i = 0; i < 20; ++i) {
+    q.publish(std::string(size, last), last);
+    q.publish(std::string(size, 'A' + i), 'A' + i);
+  }
+  ASSERT_GT(q.stats().dropped_oldest.get(), 0u);
+
+  std::string received;
+  char buf[4096];
+  for (;;) {
+    ssize_t n;
+    while ((n = recv(pair.fds[1], buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+      received.append(buf, n);
+    if (!q.pending())
+      break;
+    q.flush();
+  }
+
+  // whole messages only: runs of size bytes of one letter
+  ASSERT_EQ(received.size() % size, 0u);
+  for (std::size_t at = 0; at < received.size(); at += size)
+    ASSERT_EQ(received.substr(at, size), std::string(size, received[at]));
+}
+
+TEST(subscriber_queue, SlowSubscriberStaysBoundedWithoutStallingOthers) {
+  stream_pair slow, fast;
+  subscriber_queue<> slow_q{slow.fds[0], 8, overflow_policy::DROP_OLDEST};
+  subscriber_queue<> fast_q{fast.fds[0], 8, overflow_policy::DROP_OLDEST};
+  const std::string msg(512, 'm');
+
+  std::size_t fast_bytes = 0;
+  for (int i = 0; i < 1000; ++i) {
+    slow_q.publish(msg);
+    fast_q.publish(msg);
+    fast_bytes += fast.read_all();
+  }
+  fast_bytes += fast.read_all();
+
+  ASSERT_EQ(fast_bytes, 1000 * msg.size());
+  ASSERT_EQ(fast_q.stats().dropped_oldest.get(), 0u);
+  ASSERT_LE(slow_q.pending(), 8u);
+  ASSERT_GT(slow_q.stats().dropped_oldest.get(), 0u);
+}
+
+TEST(subscriber_queue, DrainsFromTheReactorWhenWritable) {
+  stream_pair pair;
+  subscriber_queue<> q{pair.fds[0], 64, overflow_policy::DROP_NEWEST};
+  auto muxer{make_muxer<SOCKET>()};
+  ASSERT_TRUE(muxer->add(pair.fds[0]));
+  q.attach(*muxer);
+
+  const std::string msg(512, 'm');
+  for (int i = 0; i < 32; ++i)
+    ASSERT_TRUE(q.publish(msg));
+  ASSERT_GT(q.pending(), 0u);
+
+  std::size_t received = 0;
+  while (received < 32 * msg.size()) {
+    received += pair.read_all();
+    if (q.pending())
+      muxer->listen();
+  }
+  ASSERT_EQ(q.pending(), 0u);
+  ASSERT_EQ(q.stats().dequeued.get(), 32u);
+}
+
+TEST(subscriber_queue, BlockWaitsForTheSubscriber) {
+  stream_pair pair;
+  subscriber_queue<> q{pair.fds[0], 2, overflow_policy::BLOCK};
+  const std::string msg(2048, 'm');
+
+  std::thread reader([&pair] {
+    // let the publisher fill the socket and the queue first
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::size_t total = 0;
+    char buf[4096];
+    while (total < 64 * 2048) {
+      auto n = recv(pair.fds[1], buf, sizeof(buf), 0);
+      if (n <= 0)
+        break;
+      total += n;
+    }
+  });
+
+  for (int i = 0; i < 64; ++i)
+    ASSERT_TRUE(q.publish(msg));
+  while (q.pending())
+    q.flush();
+  reader.join();
+
+  ASSERT_EQ(q.stats().dequeued.get(), 64u);
+  ASSERT_GT(q.stats().blocked.get(), 0u);
+}
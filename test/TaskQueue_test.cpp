@@ -0,0 +1,82 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/TaskQueue.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+using wasl::mpsc_queue;
+
+TEST(mpsc_queue, PopsInPushOrderForOneProducer) {
+  mpsc_queue<int> q;
+  int out;
+  ASSERT_FALSE(q.pop(out));
+  ASSERT_TRUE(q.idle());
+
+  q.push(1);
+  q.push(2);
+  ASSERT_TRUE(q.pop(out));
+  ASSERT_EQ(out, 1);
+  ASSERT_TRUE(q.pop(out));
+  ASSERT_EQ(out, 2);
+  ASSERT_FALSE(q.pop(out));
+}
+
+TEST(mpsc_queue, DeliversEveryValueFromManyProducers) {
+  constexpr int producers = 4;
+  constexpr int per_producer = 10000;
+  mpsc_queue<int> q;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p)
+    threads.emplace_back([&q] {
+      for (int i = 1; i <= per_producer; ++i)
+        q.push(i);
+    });
+
+  long long sum = 0;
+  int received = 0;
+  while (received < producers * per_producer) {
+    int v;
+    if (q.pop(v)) {
+      sum += v;
+      ++received;
+    }
+  }
+
+  for (auto &t : threads)
+    t.join();
+
+  ASSERT_EQ(sum, producers * (per_producer * (per_producer + 1LL) / 2));
+}
+
+TEST(io_mux_post, CoalescesABurstIntoOneWakeup) {
+  auto muxer{make_muxer<SOCKET>()};
+  int ran = 0;
+  for (int i = 0; i < 3; ++i)
+    muxer->post([&ran] { ++ran; });
+
+  ASSERT_EQ(muxer->listen(), 1);
+  ASSERT_EQ(ran, 3);
+}
+
+TEST(io_mux_post, RunsTasksPostedFromOtherThreads) {
+  auto muxer{make_muxer<SOCKET>()};
+  constexpr int posts = 1000;
+  int ran = 0; // only touched on the reactor thread
+
+  std::thread poster([&muxer, &ran] {
+    for (int i = 0; i < posts; ++i)
+      muxer->post([&ran] { ++ran; });
+  });
+
+  while (ran < posts)
+    muxer->listen();
+  poster.join();
+
+  ASSERT_EQ(ran, posts);
+}
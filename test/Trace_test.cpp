@@ -0,0 +1,67 @@
+#include <wasl/IOMultiplexer.h>
+#include <wasl/SockStream.h>
+#include <wasl/Socket.h>
+#include <wasl/Trace.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace std::string_literals;
+using namespace wasl::ip;
+
+constexpr gsl::czstring<> srv_path{"/tmp/wasl/trace_srv"};
+constexpr gsl::czstring<> client_path{"/tmp/wasl/trace_cl"};
+constexpr gsl::czstring<> trace_path{"/tmp/wasl/wasl.trace"};
+
+TEST(null_trace, IsAnEmptyPolicy) {
+  ASSERT_TRUE(std::is_empty<null_trace>::value);
+  ASSERT_FALSE(null_trace::enabled);
+}
+
+TEST(ring_trace, RecordsDispatchPathAndConvertsToChromeJson) {
+  auto srv{make_socket<sockaddr_un, SOCK_DGRAM, ring_trace>(srv_path)};
+  auto cl{make_socket<sockaddr_un, SOCK_DGRAM>(client_path)};
+  auto srv_fd = sockno(*srv);
+  ASSERT_EQ(socket_connect(cl.get(), srv_fd), 0);
+
+  auto muxer{make_muxer<SOCKET, epoll_muxer<SOCKET>, ring_trace>()};
+  ASSERT_TRUE(muxer->add(srv_fd));
+
+  basic_sockstream<sockbuf<basic_sockio<wasl::platform_type>, ring_trace>>
+      ss_srv(srv_fd);
+  std::string received;
+  muxer->bind_event(srv_fd, labeled_handler<std::string>{
+                                "reader"s, [&](SOCKET, std::string) {
+                                  ss_srv >> received;
+                                }});
+
+  sockstream ss_cl(sockno(*cl));
+  ss_cl << "traced" << std::endl;
+  ASSERT_EQ(muxer->listen(), 1);
+
+  auto records = ring_trace::collect();
+  auto has = [&](trace_kind kind) {
+    return std::any_of(records.begin(), records.end(),
+                       [&](const trace_record &r) {
+                         return r.kind == static_cast<uint16_t>(kind) &&
+                                r.fd == srv_fd;
+                       });
+  };
+  ASSERT_TRUE(has(trace_kind::sock_bind));
+  ASSERT_TRUE(has(trace_kind::fd_ready));
+  ASSERT_TRUE(has(trace_kind::handler_begin));
+  ASSERT_TRUE(has(trace_kind::bytes_received));
+  ASSERT_TRUE(has(trace_kind::handler_end));
+
+  ASSERT_TRUE(ring_trace::dump(trace_path));
+  std::ifstream in(trace_path, std::ios::binary);
+  std::ostringstream json;
+  ASSERT_TRUE(trace_to_chrome_json(in, json));
+  ASSERT_NE(json.str().find("\"ph\":\"B\""), std::string::npos);
+  ASSERT_NE(json.str().find("\"name\":\"bytes_received\""), std::string::npos);
+}
@@ -0,0 +1,110 @@
+#include <wasl/Socket.h>
+#include <wasl/Udp.h>
+
+#include <string>
+#include <vector>
+
+#include "test_helpers.h"
+#include <gtest/gtest.h>
+
+using namespace wasl::ip;
+using wasl::local::toUType;
+
+namespace {
+
+template <typename Node> std::string loopback_path(const Node &node) {
+  auto addr = get_address<typename Node::addr_type>(sockno(node));
+  return "127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+}
+
+} // namespace
+
+TEST(socket_builder, CanBuildUdpSockets) {
+  std::unique_ptr<socket_dgram_udp> v4{
+      socket_dgram_udp::create("127.0.0.1:0")->socket()->bind()->build()};
+  ASSERT_TRUE(is_open(*v4));
+  ASSERT_NE(get_address<sockaddr_in>(sockno(*v4)).sin_port, 0);
+
+  auto builder = socket_dgram_udp6::create("[::1]:0");
+  builder->socket()->bind();
+  std::unique_ptr<socket_dgram_udp6> v6{builder->build()};
+  ASSERT_TRUE(is_open(*v6));
+}
+
+TEST(socket_builder, RejectsMalformedHostPort) {
+  for (auto *path : {"127.0.0.1", "127.0.0.1:", "127.0.0.1:70000",
+                     "localhost:9000", "::1:9000"}) {
+    auto builder = socket_dgram_udp::create(path);
+    ASSERT_NE(toUType(builder->sock_err & SockError::ERR_PATH_INVAL), 0u)
+        << path;
+    delete builder->build();
+  }
+}
+
+TEST(socket_builder, FlagsFailedSocketOptions) {
+  auto builder = socket_dgram_local::create("/tmp/wasl/srv");
+  builder->socket()->bind()->udp_gro();
+  std::unique_ptr<socket_dgram_local> node{builder->build()};
+  ASSERT_NE(toUType(builder->sock_err & SockError::ERR_SOCKOPT), 0u);
+}
+
+TEST(udp, SegmentedSendCrossesLoopbackAsOneSuperPacket) {
+  auto rx_builder = socket_dgram_udp::create("127.0.0.1:0");
+  rx_builder->socket()->bind()->udp_gro();
+  if (!*rx_builder) {
+    delete rx_builder->build();
+    GTEST_SKIP() << "UDP_GRO unavailable";
+  }
+  std::unique_ptr<socket_dgram_udp> rx{rx_builder->build()};
+  std::unique_ptr<socket_dgram_udp> tx{
+      socket_dgram_udp::create("127.0.0.1:0")->socket()->bind()->build()};
+  ASSERT_EQ(socket_connect(tx.get(), sockno(*rx)), 0);
+
+  constexpr uint16_t segment = 100;
+  std::string payload;
+  for (char c = 'a'; c < 'a' + 10; ++c)
+    payload.append(segment, c);
+  payload.append(40, 'z');
+
+  auto sent = udp_send_segmented(sockno(*tx), payload, segment);
+  if (sent == -1 && errno == EIO)
+    GTEST_SKIP() << "UDP GSO unavailable";
+  ASSERT_EQ(sent, static_cast<ssize_t>(payload.size()));
+
+  std::vector<std::string> datagrams;
+  std::vector<char> buf(64 * 1024);
+  int syscalls = 0;
+  while (datagrams.size() < 11) {
+    int seg = 0;
+    auto n = udp_recv_gro(sockno(*rx), buf, seg, nullptr, MSG_DONTWAIT);
+    ASSERT_GT(n, 0);
+    ++syscalls;
+    for_each_segment(buf.data(), n, seg, [&](const char *p, std::size_t len) {
+      datagrams.emplace_back(p, len);
+    });
+  }
+
+  ASSERT_EQ(datagrams.size(), 11u);
+  ASSERT_EQ(datagrams[3], std::string(segment, 'd'));
+  ASSERT_EQ(datagrams[10], std::string(40, 'z'));
+  // loopback keeps GSO super-packets intact for GRO-enabled sockets
+  ASSERT_EQ(syscalls, 1);
+}
+
+TEST(udp, PlainDatagramsReportTheirOwnSize) {
+  std::unique_ptr<socket_dgram_udp> rx{
+      socket_dgram_udp::create("127.0.0.1:0")->socket()->bind()->build()};
+  std::unique_ptr<socket_dgram_udp> tx{
+      socket_dgram_udp::create("127.0.0.1:0")->socket()->bind()->build()};
+  ASSERT_EQ(socket_connect(tx.get(), sockno(*rx)), 0);
+  ASSERT_EQ(send(sockno(*tx), "hello", 5, 0), 5);
+
+  char buf[64];
+  int seg = 0;
+  peer_address from;
+  ASSERT_EQ(udp_recv_gro(sockno(*rx), buf, seg, &from), 5);
+  ASSERT_EQ(seg, 5);
+  ASSERT_EQ(loopback_path(*tx),
+            "127.0.0.1:" + std::to_string(ntohs(
+                reinterpret_cast<sockaddr_in *>(&from.addr)->sin_port)));
+}
@@ -0,0 +1,141 @@
+#include <wasl/Capture.h>
+#include <wasl/SockStream.h>
+#include <wasl/Socket.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <unistd.h>
+
+using namespace wasl::ip;
+
+namespace {
+
+using sockio = basic_sockio<wasl::platform_type>;
+
+void usage(const char *argv0) {
+  std::cerr << "usage: " << argv0
+            << " <capture file> <target> [--speed N|max] [--out]"
+               " [--fd N] [--topic N]\n"
+               "  target: unix datagram socket path, or host:port for UDP\n"
+               "  --speed: 1 replays in real time (default), N N times"
+               " faster, max without pauses\n"
+               "  --out: replay what was sent instead of what was received\n";
+}
+
+/// Address of target: "host:port" for IPv4 UDP, else a unix socket path.
+bool target_address(const char *target, peer_address &to, bool &udp) {
+  const char *colon = strrchr(target, ':');
+  udp = colon && !strchr(target, '/');
+  if (udp) {
+    auto *in = reinterpret_cast<struct sockaddr_in *>(&to.addr);
+    in->sin_family = AF_INET;
+    in->sin_port = htons(static_cast<in_port_t>(atoi(colon + 1)));
+    std::string host(target, colon);
+    to.len = sizeof(*in);
+    return inet_pton(AF_INET, host.c_str(), &in->sin_addr) == 1;
+  }
+
+  auto *un = reinterpret_cast<struct sockaddr_un *>(&to.addr);
+  if (strlen(target) >= sizeof(un->sun_path))
+    return false;
+  un->sun_family = AF_LOCAL;
+  strncpy(un->sun_path, target, sizeof(un->sun_path) - 1);
+  to.len = sizeof(*un);
+  return true;
+}
+
+/// Replay through a socket_node of the target's family.
+template <typename Node>
+int run(const capture_reader &capture, const replay_options &options,
+        const peer_address &to, gsl::czstring<> local) {
+  std::unique_ptr<Node> sock{Node::create(local)->socket()->bind()->build()};
+  if (!sock || !is_open(*sock)) {
+    std::cerr << local << ": " << strerror(errno) << '\n';
+    return 1;
+  }
+
+  uint64_t bytes = 0;
+  std::size_t failed = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto sent = replay(capture, options, [&](const capture_record &,
+                                           gsl::span<const char> payload) {
+    if (sockio::rv_send_to(sockno(*sock), payload.data(), payload.size(),
+                           to) < 0)
+      ++failed;
+    else
+      bytes += payload.size();
+    return true;
+  });
+  auto secs = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            start)
+                  .count();
+
+  std::cerr << "replayed " << sent - failed << " messages, " << bytes
+            << " bytes in " << secs << "s";
+  if (failed)
+    std::cerr << " (" << failed << " failed: " << strerror(errno) << ')';
+  std::cerr << '\n';
+  return failed ? 1 : 0;
+}
+
+} // namespace
+
+/// Re-inject the messages of a wasl capture file (see capture_file) into a
+/// datagram socket, paced as captured.
+///
+/// usage: wasl-replay <capture file> <target> [--speed N|max] [--out]
+///                    [--fd N] [--topic N]
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  replay_options options;
+  for (int i = 3; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--out") {
+      options.dir = capture_dir::OUT;
+    } else if (i + 1 < argc && arg == "--speed") {
+      std::string value = argv[++i];
+      options.speed = value == "max" ? 0 : atof(value.c_str());
+      if (value != "max" && options.speed <= 0) {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (i + 1 < argc && arg == "--fd") {
+      options.fd = atoi(argv[++i]);
+    } else if (i + 1 < argc && arg == "--topic") {
+      options.topic = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  capture_reader capture(argv[1]);
+  if (!capture) {
+    std::cerr << argv[1] << ": "
+              << (errno == EPROTO ? "not a wasl capture file" : strerror(errno))
+              << '\n';
+    return 1;
+  }
+
+  peer_address to;
+  bool udp;
+  if (!target_address(argv[2], to, udp)) {
+    std::cerr << argv[2] << ": invalid target\n";
+    return 1;
+  }
+
+  if (udp)
+    return run<socket_dgram_udp>(capture, options, to, "0.0.0.0:0");
+
+  auto local = "/tmp/wasl-replay." + std::to_string(getpid());
+  return run<socket_dgram_local>(capture, options, to, local.c_str());
+}
@@ -0,0 +1,38 @@
+#include <wasl/Trace.h>
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+/// Convert a wasl binary trace (see ring_trace::dump) to Chrome trace-event
+/// JSON.
+///
+/// usage: wasl-trace2json <trace file> [json file]
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <trace file> [json file]\n";
+    return 2;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    std::cerr << argv[1] << ": " << strerror(errno) << '\n';
+    return 1;
+  }
+
+  std::ofstream file_out;
+  if (argc > 2) {
+    file_out.open(argv[2], std::ios::trunc);
+    if (!file_out) {
+      std::cerr << argv[2] << ": " << strerror(errno) << '\n';
+      return 1;
+    }
+  }
+
+  if (!wasl::ip::trace_to_chrome_json(in, argc > 2 ? file_out : std::cout)) {
+    std::cerr << argv[1] << ": not a wasl trace file\n";
+    return 1;
+  }
+
+  return 0;
+}